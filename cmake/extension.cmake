@@ -15,6 +15,9 @@ set_target_properties(extension PROPERTIES
     DEBUG_POSTFIX ""
     PREFIX "")
 target_compile_definitions(extension PRIVATE TESTING=1 ZEND_ENABLE_STATIC_TSRMLS_CACHE=1)
+if(DD_APPSEC_ENABLE_USDT)
+    target_compile_definitions(extension PRIVATE DD_APPSEC_USDT=1)
+endif()
 target_link_libraries(extension PRIVATE mpack zai_zend_abstract_interface)
 
 macro(target_linker_flag_conditional target) # flags as argv
@@ -98,6 +101,7 @@ endif()
 patch_away_libc(extension)
 
 include(cmake/run_tests.cmake)
+add_subdirectory(tests/bench_ip_extraction EXCLUDE_FROM_ALL)
 include(cmake/extension_api.cmake)
 
 # Installation
@@ -14,6 +14,12 @@ set_target_properties(helper_objects PROPERTIES
     POSITION_INDEPENDENT_CODE 1)
 target_include_directories(helper_objects PUBLIC ${HELPER_INCLUDE_DIR})
 target_compile_definitions(helper_objects PUBLIC SPDLOG_ACTIVE_LEVEL=SPDLOG_LEVEL_TRACE)
+if(DD_APPSEC_ENABLE_USDT)
+    target_compile_definitions(helper_objects PUBLIC DD_APPSEC_USDT=1)
+endif()
+if(DD_APPSEC_ENABLE_ALLOC_TRACKING)
+    target_compile_definitions(helper_objects PUBLIC DD_APPSEC_ALLOC_TRACKING=1)
+endif()
 target_link_libraries(helper_objects PUBLIC libddwaf_objects pthread spdlog cpp-base64 msgpack_c lib_rapidjson Boost::system zlibstatic)
 
 add_executable(ddappsec-helper src/helper/main.cpp
@@ -48,6 +54,7 @@ endif()
 # Testing and examples
 add_subdirectory(tests/helper EXCLUDE_FROM_ALL)
 add_subdirectory(tests/bench_helper EXCLUDE_FROM_ALL)
+add_subdirectory(tests/helper_microbench EXCLUDE_FROM_ALL)
 add_subdirectory(tests/fuzzer EXCLUDE_FROM_ALL)
 #IF(EXISTS "${CMAKE_CURRENT_SOURCE_DIR}/examples/")
     #add_subdirectory(examples)
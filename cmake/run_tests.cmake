@@ -42,6 +42,18 @@ endif()
 
 add_subdirectory(tests/mock_helper EXCLUDE_FROM_ALL)
 
+# Overhead of the extension on the request lifecycle, against the mock helper
+string(REGEX REPLACE "/php(.?.?.?)$" "/php-cgi\\1" PHP_CGI_BINARY
+    "${PHP_BINARY}")
+add_custom_target(xbench
+    COMMAND "${PHP_BINARY}" -n -d "extension=$<TARGET_FILE:extension>"
+        ${CMAKE_SOURCE_DIR}/tests/bench_extension/bench_extension.php
+        "--php-cgi=${PHP_CGI_BINARY}"
+        "--extension=$<TARGET_FILE:extension>"
+        "--mock-helper=$<TARGET_FILE:mock_helper>"
+    WORKING_DIRECTORY ${CMAKE_SOURCE_DIR})
+add_dependencies(xbench extension mock_helper)
+
 # Examples
 if(DD_APPSEC_BUILD_HELPER)
     get_filename_component(PHP_BIN_DIR ${PHP_BINARY} DIRECTORY)
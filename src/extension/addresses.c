@@ -0,0 +1,57 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "addresses.h"
+#include "msgpack_helpers.h"
+#include "php_helpers.h"
+
+static const char *const _address_names[DD_ADDR_MAX] = {
+    [DD_ADDR_REQUEST_QUERY] = "server.request.query",
+    [DD_ADDR_REQUEST_METHOD] = "server.request.method",
+    [DD_ADDR_REQUEST_COOKIES] = "server.request.cookies",
+    [DD_ADDR_REQUEST_URI_RAW] = "server.request.uri.raw",
+    [DD_ADDR_REQUEST_HEADERS_NO_COOKIES] = "server.request.headers.no_cookies",
+    [DD_ADDR_REQUEST_BODY] = "server.request.body",
+    [DD_ADDR_REQUEST_BODY_FILENAMES] = "server.request.body.filenames",
+    [DD_ADDR_REQUEST_BODY_FILES_FIELD_NAMES] =
+        "server.request.body.files_field_names",
+    [DD_ADDR_REQUEST_PATH_PARAMS] = "server.request.path_params",
+    [DD_ADDR_HTTP_CLIENT_IP] = "http.client_ip",
+    [DD_ADDR_REQUEST_BODY_RAW] = "server.request.body.raw",
+    [DD_ADDR_RESPONSE_STATUS] = "server.response.status",
+    [DD_ADDR_RESPONSE_HEADERS_NO_COOKIES] =
+        "server.response.headers.no_cookies",
+};
+
+// the names, encoded on startup
+static dd_mpack_fragment _address_frags[DD_ADDR_MAX];
+
+static THREAD_LOCAL_ON_ZTS bool _ids_enabled;
+
+void dd_addresses_startup(void)
+{
+    for (unsigned i = 0; i < DD_ADDR_MAX; i++) {
+        dd_mpack_fragment_init_str(
+            &_address_frags[i], _address_names[i], strlen(_address_names[i]));
+    }
+}
+
+void dd_addresses_shutdown(void)
+{
+    for (unsigned i = 0; i < DD_ADDR_MAX; i++) {
+        dd_mpack_fragment_destroy(&_address_frags[i]);
+    }
+}
+
+void dd_addresses_set_ids_enabled(bool enabled) { _ids_enabled = enabled; }
+
+void dd_mpack_write_address(mpack_writer_t *nonnull w, dd_address_id id)
+{
+    if (_ids_enabled) {
+        mpack_write_uint(w, (uint64_t)id);
+    } else {
+        dd_mpack_write_fragment(w, &_address_frags[id]);
+    }
+}
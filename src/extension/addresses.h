@@ -0,0 +1,42 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include "attributes.h"
+#include <mpack.h>
+#include <stdbool.h>
+
+#define DD_CAPABILITY_ADDRESS_IDS "address_ids"
+
+// The values are part of the helper protocol and must match the helper's
+// known_addresses (network/addresses.hpp). Add new addresses at the end.
+typedef enum _dd_address_id {
+    DD_ADDR_REQUEST_QUERY = 0,
+    DD_ADDR_REQUEST_METHOD,
+    DD_ADDR_REQUEST_COOKIES,
+    DD_ADDR_REQUEST_URI_RAW,
+    DD_ADDR_REQUEST_HEADERS_NO_COOKIES,
+    DD_ADDR_REQUEST_BODY,
+    DD_ADDR_REQUEST_BODY_FILENAMES,
+    DD_ADDR_REQUEST_BODY_FILES_FIELD_NAMES,
+    DD_ADDR_REQUEST_PATH_PARAMS,
+    DD_ADDR_HTTP_CLIENT_IP,
+    DD_ADDR_REQUEST_BODY_RAW,
+    DD_ADDR_RESPONSE_STATUS,
+    DD_ADDR_RESPONSE_HEADERS_NO_COOKIES,
+    DD_ADDR_MAX
+} dd_address_id;
+
+void dd_addresses_startup(void);
+void dd_addresses_shutdown(void);
+
+// Whether the helper on the current connection accepted address ids. Set after
+// each client_init
+void dd_addresses_set_ids_enabled(bool enabled);
+
+// Writes the address as an integer if the helper accepts address ids, or as a
+// string otherwise
+void dd_mpack_write_address(mpack_writer_t *nonnull w, dd_address_id id);
@@ -7,6 +7,7 @@
 #include <ext/standard/url.h>
 #include <php.h>
 
+#include "../addresses.h"
 #include "../commands_helpers.h"
 #include "../configuration.h"
 #include "../ddappsec.h"
@@ -25,11 +26,17 @@ static dd_result _pack_command(mpack_writer_t *nonnull w, void *nullable ctx);
 static dd_result _process_response(mpack_node_t root, void *nullable ctx);
 static void _process_meta_and_metrics(mpack_node_t root);
 static void _pack_agent_details(mpack_writer_t *nonnull w);
+static void _pack_engine_settings(mpack_writer_t *nonnull w);
+static void _process_capabilities(mpack_node_t root);
+
+// only depends on global configuration, so it's encoded on MINIT and again
+// once the global config is final, after the first RINIT
+static dd_mpack_fragment _engine_settings_frag;
 
 static const dd_command_spec _spec = {
     .name = "client_init",
     .name_len = sizeof("client_init") - 1,
-    .num_args = 7,
+    .num_args = 8,
     .outgoing_cb = _pack_command,
     .incoming_cb = _process_response,
     .config_features_cb = dd_command_process_config_features_unexpected,
@@ -78,8 +85,27 @@ static void _pack_agent_details(mpack_writer_t *nonnull w)
     }
 }
 
+void dd_client_init_startup(void)
+{
+    dd_mpack_fragment_init(&_engine_settings_frag, _pack_engine_settings);
+}
+
+void dd_client_init_rinit_once(void)
+{
+    // env vars set through the SAPI are only seen on the first RINIT
+    dd_mpack_fragment_destroy(&_engine_settings_frag);
+    dd_mpack_fragment_init(&_engine_settings_frag, _pack_engine_settings);
+}
+
+void dd_client_init_shutdown(void)
+{
+    dd_mpack_fragment_destroy(&_engine_settings_frag);
+}
+
 dd_result dd_client_init(dd_conn *nonnull conn)
 {
+    // until the helper says otherwise
+    dd_addresses_set_ids_enabled(false);
     return dd_command_exec_cred(conn, &_spec, NULL);
 }
 
@@ -132,8 +158,38 @@ static dd_result _pack_command(
     mpack_finish_map(w);
 
     // Engine settings
+    if (EXPECTED(_engine_settings_frag.data)) {
+        dd_mpack_write_fragment(w, &_engine_settings_frag);
+    } else {
+        _pack_engine_settings(w);
+    }
+
+    // Remote config settings
     // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-    mpack_start_map(w, 6);
+    mpack_start_map(w, 4);
+
+    dd_mpack_write_lstr(w, "enabled");
+    mpack_write_bool(w, get_DD_REMOTE_CONFIG_ENABLED());
+
+    _pack_agent_details(w);
+
+    dd_mpack_write_lstr(w, "poll_interval");
+    mpack_write_u32(w, get_DD_REMOTE_CONFIG_POLL_INTERVAL());
+
+    mpack_finish_map(w);
+
+    // Capabilities; the helper replies with those it supports
+    mpack_start_array(w, 1);
+    dd_mpack_write_lstr(w, DD_CAPABILITY_ADDRESS_IDS);
+    mpack_finish_array(w);
+
+    return dd_success;
+}
+
+static void _pack_engine_settings(mpack_writer_t *nonnull w)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    mpack_start_map(w, 11);
     {
         dd_mpack_write_lstr(w, "rules_file");
         const char *rules_file = ZSTR_VAL(get_global_DD_APPSEC_RULES());
@@ -149,6 +205,21 @@ static dd_result _pack_command(
     dd_mpack_write_lstr(w, "waf_timeout_us");
     mpack_write(w, get_global_DD_APPSEC_WAF_TIMEOUT());
 
+    dd_mpack_write_lstr(w, "waf_request_budget_us");
+    mpack_write(w, get_global_DD_APPSEC_WAF_REQUEST_BUDGET());
+
+    dd_mpack_write_lstr(w, "verdict_cache_size");
+    mpack_write(w, get_global_DD_APPSEC_WAF_VERDICT_CACHE_SIZE());
+
+    dd_mpack_write_lstr(w, "verdict_cache_ttl_s");
+    mpack_write(w, get_global_DD_APPSEC_WAF_VERDICT_CACHE_TTL());
+
+    dd_mpack_write_lstr(w, "parallel_subscribers_min_size");
+    mpack_write(w, get_global_DD_APPSEC_PARALLEL_SUBSCRIBERS_MIN_SIZE());
+
+    dd_mpack_write_lstr(w, "waf_route_scoping");
+    mpack_write_bool(w, get_global_DD_APPSEC_WAF_ROUTE_SCOPING());
+
     dd_mpack_write_lstr(w, "trace_rate_limit");
     mpack_write(w, get_global_DD_APPSEC_TRACE_RATE_LIMIT());
 
@@ -172,22 +243,6 @@ static dd_result _pack_command(
     mpack_finish_map(w);
 
     mpack_finish_map(w);
-
-    // Remote config settings
-    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-    mpack_start_map(w, 4);
-
-    dd_mpack_write_lstr(w, "enabled");
-    mpack_write_bool(w, get_DD_REMOTE_CONFIG_ENABLED());
-
-    _pack_agent_details(w);
-
-    dd_mpack_write_lstr(w, "poll_interval");
-    mpack_write_u32(w, get_DD_REMOTE_CONFIG_POLL_INTERVAL());
-
-    mpack_finish_map(w);
-
-    return dd_success;
 }
 
 static dd_result _check_helper_version(mpack_node_t root);
@@ -203,7 +258,11 @@ static dd_result _process_response(
     if (is_ok) {
         mlog(dd_log_debug, "Response to client_init is ok");
 
-        return _check_helper_version(root);
+        dd_result res = _check_helper_version(root);
+        if (res == dd_success) {
+            _process_capabilities(root);
+        }
+        return res;
     }
 
     // not ok, in which case expect at least one error message
@@ -246,6 +305,26 @@ static void _process_meta_and_metrics(mpack_node_t root)
     dd_command_process_metrics(metrics);
 }
 
+static void _process_capabilities(mpack_node_t root)
+{
+    // older helpers do not send the capabilities
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    if (mpack_node_array_length(root) <= 5) {
+        return;
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    mpack_node_t capabilities = mpack_node_array_at(root, 5);
+    size_t count = mpack_node_array_length(capabilities);
+    for (size_t i = 0; i < count; i++) {
+        mpack_node_t cap = mpack_node_array_at(capabilities, i);
+        if (dd_mpack_node_lstr_eq(cap, DD_CAPABILITY_ADDRESS_IDS)) {
+            mlog(dd_log_debug, "Helper accepts address ids");
+            dd_addresses_set_ids_enabled(true);
+        }
+    }
+}
+
 static dd_result _check_helper_version(mpack_node_t root)
 {
     mpack_node_t version_node = mpack_node_array_at(root, 1);
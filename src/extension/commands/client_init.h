@@ -7,4 +7,7 @@
 
 #include "../network.h"
 
+void dd_client_init_startup(void);
+void dd_client_init_rinit_once(void);
+void dd_client_init_shutdown(void);
 dd_result dd_client_init(dd_conn *nonnull conn);
@@ -8,6 +8,7 @@
 #include "../commands_helpers.h"
 #include "../logging.h"
 #include "../msgpack_helpers.h"
+#include "../php_helpers.h"
 #include <php.h>
 #include <zend_hash.h>
 #include <zend_types.h>
@@ -24,6 +25,14 @@ static const dd_command_spec _spec = {
     .config_features_cb = dd_command_process_config_features_unexpected,
 };
 
+// Maps of addresses pushed during the request and not sent yet, as a list.
+// They are sent along with the next request_exec, or on their own once this
+// many of them are pending, so that blocking on them isn't delayed for long.
+#define MAX_PENDING_MAPS 16
+static THREAD_LOCAL_ON_ZTS zval _pending;
+
+static void _add_pending(zval *nonnull data);
+
 dd_result dd_request_exec(dd_conn *nonnull conn, zval *nonnull data)
 {
     if (Z_TYPE_P(data) != IS_ARRAY) {
@@ -32,7 +41,64 @@ dd_result dd_request_exec(dd_conn *nonnull conn, zval *nonnull data)
         return dd_error;
     }
 
-    return dd_command_exec(conn, &_spec, (void *)data);
+    if (Z_TYPE(_pending) == IS_UNDEF) {
+        return dd_command_exec(conn, &_spec, (void *)data);
+    }
+
+    // The data goes after the pending maps, which were pushed before it
+    _add_pending(data);
+    return dd_request_exec_flush(conn);
+}
+
+dd_result dd_request_exec_push(dd_conn *nonnull conn, zval *nonnull data)
+{
+    if (Z_TYPE_P(data) != IS_ARRAY) {
+        mlog(dd_log_debug, "Invalid data pushed for command request_exec, "
+                           "expected hash table.");
+        return dd_error;
+    }
+
+    _add_pending(data);
+    if (zend_hash_num_elements(Z_ARRVAL(_pending)) < MAX_PENDING_MAPS) {
+        return dd_success;
+    }
+
+    return dd_request_exec_flush(conn);
+}
+
+dd_result dd_request_exec_flush(dd_conn *nonnull conn)
+{
+    if (Z_TYPE(_pending) == IS_UNDEF) {
+        return dd_success;
+    }
+
+    // Taken out first, so that nothing is sent twice whatever the result
+    zval batch;
+    ZVAL_COPY_VALUE(&batch, &_pending);
+    ZVAL_UNDEF(&_pending);
+
+    mlog(dd_log_debug, "Sending %" PRIu32 " pending maps of addresses",
+        zend_hash_num_elements(Z_ARRVAL(batch)));
+    dd_result res = dd_command_exec(conn, &_spec, (void *)&batch);
+    zval_ptr_dtor(&batch);
+
+    return res;
+}
+
+void dd_request_exec_rshutdown(void)
+{
+    zval_ptr_dtor(&_pending);
+    ZVAL_UNDEF(&_pending);
+}
+
+static void _add_pending(zval *nonnull data)
+{
+    if (Z_TYPE(_pending) == IS_UNDEF) {
+        array_init(&_pending);
+    }
+
+    Z_TRY_ADDREF_P(data);
+    zend_hash_next_index_insert(Z_ARRVAL(_pending), data);
 }
 
 static dd_result _pack_command(
@@ -9,4 +9,11 @@
 #include <SAPI.h>
 #include <php.h>
 
+// Sends the data along with the maps of addresses pushed so far, if any
 dd_result dd_request_exec(dd_conn *nonnull conn, zval *nonnull data);
+// Keeps the map of addresses until the next request_exec, unless too many
+// are pending already, in which case they are all sent right away
+dd_result dd_request_exec_push(dd_conn *nonnull conn, zval *nonnull data);
+// Sends the maps of addresses pushed so far, if any
+dd_result dd_request_exec_flush(dd_conn *nonnull conn);
+void dd_request_exec_rshutdown(void);
@@ -7,6 +7,7 @@
 #include <ext/standard/url.h>
 #include <php.h>
 
+#include "../addresses.h"
 #include "../commands_helpers.h"
 #include "../configuration.h"
 #include "../ddappsec.h"
@@ -16,6 +17,7 @@
 #include "../msgpack_helpers.h"
 #include "../php_compat.h"
 #include "../request_body.h"
+#include "../request_headers.h"
 #include "../string_helpers.h"
 #include "request_init.h"
 #include <mpack.h>
@@ -62,19 +64,19 @@ static dd_result _request_pack(
     sapi_request_info *request_info = &SG(request_info);
 
     // 1.
-    dd_mpack_write_lstr(w, "server.request.query");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_QUERY);
     dd_mpack_write_zval(
         w, dd_php_get_autoglobal(TRACK_VARS_GET, ZEND_STRL("_GET")));
 
     // 2.
-    dd_mpack_write_lstr(w, "server.request.method");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_METHOD);
     mpack_write(w, request_info->request_method);
 
     // Pack data from server global
     _init_autoglobals();
 
     // 3.
-    dd_mpack_write_lstr(w, "server.request.cookies");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_COOKIES);
     dd_mpack_write_zval(
         w, dd_php_get_autoglobal(TRACK_VARS_COOKIE, ZEND_STRL("_COOKIE")));
 
@@ -83,37 +85,37 @@ static dd_result _request_pack(
         dd_php_get_autoglobal(TRACK_VARS_SERVER, ZEND_STRL("_SERVER"));
     const zend_string *nullable request_uri =
         dd_php_get_string_elem_cstr(server_ag, ZEND_STRL("REQUEST_URI"));
-    dd_mpack_write_lstr(w, "server.request.uri.raw");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_URI_RAW);
     dd_mpack_write_nullable_zstr(w, request_uri);
 
     // 5.
-    dd_mpack_write_lstr(w, "server.request.headers.no_cookies");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_HEADERS_NO_COOKIES);
     _pack_headers(w);
 
     // 6.
-    dd_mpack_write_lstr(w, "server.request.body");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_BODY);
     dd_mpack_write_zval(
         w, dd_php_get_autoglobal(TRACK_VARS_POST, ZEND_STRL("_POST")));
 
     // 7.
-    dd_mpack_write_lstr(w, "server.request.body.filenames");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_BODY_FILENAMES);
     _pack_filenames(w);
 
     // 8.
-    dd_mpack_write_lstr(w, "server.request.body.files_field_names");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_BODY_FILES_FIELD_NAMES);
     _pack_files_field_names(w);
 
     // 9.
-    dd_mpack_write_lstr(w, "server.request.path_params");
+    dd_mpack_write_address(w, DD_ADDR_REQUEST_PATH_PARAMS);
     _pack_path_params(w, request_uri);
 
     // 10.
-    dd_mpack_write_lstr(w, "http.client_ip");
+    dd_mpack_write_address(w, DD_ADDR_HTTP_CLIENT_IP);
     dd_mpack_write_nullable_zstr(w, dd_ip_extraction_get_ip());
 
     // 11.
     if (send_raw_body) {
-        dd_mpack_write_lstr(w, "server.request.body.raw");
+        dd_mpack_write_address(w, DD_ADDR_REQUEST_BODY_RAW);
         zend_string *nonnull req_body =
             dd_request_body_buffered(DD_MAX_REQ_BODY_TO_BUFFER);
         dd_mpack_write_zstr(w, req_body);
@@ -133,54 +135,28 @@ static void _init_autoglobals()
     zend_is_auto_global_str(ZEND_STRL("_POST"));
 }
 
-static const char http_prefix[] = "HTTP_";
-static const size_t http_prefix_len = sizeof("HTTP_") - 1;
-static inline bool _is_relevant_header(const zend_string *key)
-{
-    return ZSTR_LEN(key) > http_prefix_len &&
-           memcmp(ZSTR_VAL(key), http_prefix, http_prefix_len) == 0 &&
-           !zend_string_equals_literal(key, "HTTP_COOKIE");
-}
-static zend_string *_transform_header_name(const zend_string *orig)
-{
-    size_t header_len = ZSTR_LEN(orig) - http_prefix_len;
-    zend_string *ret = zend_string_alloc(header_len, 0);
-    char *wp = ZSTR_VAL(ret);
-    const char *rp = ZSTR_VAL(orig) + http_prefix_len;
-    dd_string_normalize_header2(rp, wp, header_len);
-    return ret;
-}
 static void _pack_headers(mpack_writer_t *nonnull w)
 {
-    zval *server =
-        dd_php_get_autoglobal(TRACK_VARS_SERVER, ZEND_STRL("_SERVER"));
-    if (server == NULL) {
-        mpack_start_map(w, 0);
-        mpack_finish_map(w);
-        return;
-    }
-
-    mpack_build_map(w);
+    size_t count;
+    dd_request_header *headers = dd_request_headers_get(&count);
 
-    // Pack headers
-    zend_string *key;
-    zval *val;
-    ZEND_HASH_FOREACH_STR_KEY_VAL(Z_ARRVAL_P(server), key, val)
-    {
-        if (!key) {
-            continue;
+    uint32_t num_entries = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!(headers[i].flags & DD_HEADER_COOKIE)) {
+            num_entries++;
         }
+    }
 
-        if (_is_relevant_header(key)) {
-            zend_string *transf_header_name = _transform_header_name(key);
-            dd_mpack_write_zstr(w, transf_header_name);
-            zend_string_efree(transf_header_name);
-            dd_mpack_write_zval(w, val);
+    mpack_start_map(w, num_entries);
+    for (size_t i = 0; i < count; i++) {
+        dd_request_header *h = &headers[i];
+        if (h->flags & DD_HEADER_COOKIE) {
+            continue;
         }
+        dd_mpack_write_zstr(w, h->name);
+        dd_mpack_write_zval(w, &h->value);
     }
-    ZEND_HASH_FOREACH_END();
-
-    mpack_complete_map(w);
+    mpack_finish_map(w);
 }
 
 static void _pack_filenames(mpack_writer_t *nonnull w)
@@ -4,6 +4,7 @@
 // This product includes software developed at Datadog
 // (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
 #include "request_shutdown.h"
+#include "../addresses.h"
 #include "../commands_helpers.h"
 #include "../ddappsec.h"
 #include "../msgpack_helpers.h"
@@ -39,7 +40,7 @@ static dd_result _request_pack(
     // 1.
     {
         _Static_assert(sizeof(int) == 4, "expected 32-bit int");
-        dd_mpack_write_lstr(w, "server.response.status");
+        dd_mpack_write_address(w, DD_ADDR_RESPONSE_STATUS);
         int response_code = SG(sapi_headers).http_response_code;
         char buf[sizeof("-2147483648")];
         int size = sprintf(buf, "%d", response_code);
@@ -47,7 +48,7 @@ static dd_result _request_pack(
     }
 
     // 2.
-    dd_mpack_write_lstr(w, "server.response.headers.no_cookies");
+    dd_mpack_write_address(w, DD_ADDR_RESPONSE_HEADERS_NO_COOKIES);
     _pack_headers_no_cookies(w);
 
     mpack_finish_map(w);
@@ -10,6 +10,7 @@
 #include "msgpack_helpers.h"
 #include "request_abort.h"
 #include "tags.h"
+#include "tracepoints.h"
 #include <ext/standard/base64.h>
 
 typedef struct _dd_omsg {
@@ -187,16 +188,26 @@ static dd_result _dd_command_exec(dd_conn *nonnull conn, bool check_cred,
     return res;
 }
 
+static dd_result _dd_command_exec_traced(dd_conn *nonnull conn,
+    bool check_cred, const dd_command_spec *nonnull spec,
+    void *unspecnull ctx)
+{
+    DD_TRACEPOINT(command_exec_begin, spec->name, spec->name_len);
+    dd_result res = _dd_command_exec(conn, check_cred, spec, ctx);
+    DD_TRACEPOINT(command_exec_end, spec->name, spec->name_len, (int)res);
+    return res;
+}
+
 dd_result ATTR_WARN_UNUSED dd_command_exec(dd_conn *nonnull conn,
     const dd_command_spec *nonnull spec, void *unspecnull ctx)
 {
-    return _dd_command_exec(conn, false, spec, ctx);
+    return _dd_command_exec_traced(conn, false, spec, ctx);
 }
 
 dd_result ATTR_WARN_UNUSED dd_command_exec_cred(dd_conn *nonnull conn,
     const dd_command_spec *nonnull spec, void *unspecnull ctx)
 {
-    return _dd_command_exec(conn, true, spec, ctx);
+    return _dd_command_exec_traced(conn, true, spec, ctx);
 }
 
 // outgoing
@@ -476,8 +487,7 @@ static void _add_appsec_span_data_frag(mpack_node_t node)
         return;
     }
 
-    zend_string *data_zstr = zend_string_init(data, len, 0);
-    dd_tags_add_appsec_json_frag(data_zstr);
+    dd_tags_add_appsec_json_frag(data, len);
 }
 
 static void _set_appsec_span_data(mpack_node_t node)
@@ -34,6 +34,11 @@ extern bool runtime_config_first_init;
     CONFIG(BOOL, DD_APPSEC_ENABLED, "false")                                                                                          \
     SYSCFG(STRING, DD_APPSEC_RULES, "")                                                                                               \
     SYSCFG(CUSTOM(uint64_t), DD_APPSEC_WAF_TIMEOUT, "10000", .parser = _parse_uint64)                                                 \
+    SYSCFG(CUSTOM(uint64_t), DD_APPSEC_WAF_REQUEST_BUDGET, "0", .parser = _parse_uint64)                                              \
+    SYSCFG(CUSTOM(uint32_t), DD_APPSEC_WAF_VERDICT_CACHE_SIZE, "0", .parser = _parse_uint32)                                          \
+    SYSCFG(CUSTOM(uint32_t), DD_APPSEC_WAF_VERDICT_CACHE_TTL, "60", .parser = _parse_uint32)                                          \
+    SYSCFG(CUSTOM(uint32_t), DD_APPSEC_PARALLEL_SUBSCRIBERS_MIN_SIZE, "0", .parser = _parse_uint32)                                   \
+    SYSCFG(BOOL, DD_APPSEC_WAF_ROUTE_SCOPING, "false")                                                                                \
     SYSCFG(CUSTOM(uint32_t), DD_APPSEC_TRACE_RATE_LIMIT, "100", .parser = _parse_uint32)                                              \
     SYSCFG(SET_LOWERCASE, DD_APPSEC_EXTRA_HEADERS, "")                                                                                \
     SYSCFG(STRING, DD_APPSEC_OBFUSCATION_PARAMETER_KEY_REGEXP, DEFAULT_OBFUSCATOR_KEY_REGEX)                                          \
@@ -53,6 +58,7 @@ extern bool runtime_config_first_init;
     CONFIG(STRING, DD_ENV, "")                                                                                                        \
     CONFIG(STRING, DD_VERSION, "")                                                                                                    \
     CONFIG(CUSTOM(STRING), DD_TRACE_CLIENT_IP_HEADER, "", .parser = dd_parse_client_ip_header_config)                                 \
+    SYSCFG(CUSTOM(SET), DD_APPSEC_TRUSTED_PROXIES, "", .parser = _parse_list)                                                         \
     CONFIG(BOOL, DD_REMOTE_CONFIG_ENABLED, "true")                                                                                    \
     CONFIG(CUSTOM(uint32_t), DD_REMOTE_CONFIG_POLL_INTERVAL, "1000", .parser = _parse_uint32)                                         \
     CONFIG(STRING, DD_AGENT_HOST, "")                                                                                                 \
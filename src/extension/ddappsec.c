@@ -18,6 +18,7 @@
 #include <pthread.h>
 #include <stdatomic.h>
 
+#include "addresses.h"
 #include "commands/client_init.h"
 #include "commands/config_sync.h"
 #include "commands/request_exec.h"
@@ -35,6 +36,7 @@
 #include "php_helpers.h"
 #include "php_objects.h"
 #include "request_abort.h"
+#include "request_headers.h"
 #include "string_helpers.h"
 #include "tags.h"
 #include "user_tracking.h"
@@ -207,7 +209,10 @@ static PHP_MINIT_FUNCTION(ddappsec)
     dd_user_tracking_startup();
     dd_request_abort_startup();
     dd_tags_startup();
+    dd_request_headers_startup();
     dd_ip_extraction_startup();
+    dd_addresses_startup();
+    dd_client_init_startup();
 
     return SUCCESS;
 }
@@ -221,7 +226,10 @@ static PHP_MSHUTDOWN_FUNCTION(ddappsec)
     // no other thread is running now. reset config to global config only.
     runtime_config_first_init = false;
 
-    dd_tags_shutdown();
+    dd_addresses_shutdown();
+    dd_client_init_shutdown();
+    dd_request_headers_shutdown();
+    dd_ip_extraction_shutdown();
     dd_user_tracking_shutdown();
     dd_trace_shutdown();
     dd_helper_shutdown();
@@ -237,6 +245,8 @@ static void _rinit_once()
 {
     dd_config_first_rinit();
     dd_request_abort_rinit_once();
+    dd_ip_extraction_rinit_once();
+    dd_client_init_rinit_once();
 }
 
 static PHP_RINIT_FUNCTION(ddappsec)
@@ -351,6 +361,8 @@ static PHP_RSHUTDOWN_FUNCTION(ddappsec)
 
 exit:
     dd_ip_extraction_rshutdown();
+    dd_request_headers_rshutdown();
+    dd_request_exec_rshutdown();
     DDAPPSEC_G(during_request_shutdown) = false;
     return result;
 }
@@ -360,7 +372,16 @@ int dd_appsec_rshutdown(bool ignore_verdict)
     int verdict = dd_success;
     dd_conn *conn = dd_helper_mgr_cur_conn();
     if (conn && DDAPPSEC_G(enabled) == ENABLED) {
-        int res = dd_request_shutdown(conn);
+        // The addresses still pending are evaluated before the request ends,
+        // a verdict on them stands unless the connection is lost
+        int res = dd_request_exec_flush(conn);
+        if (res != dd_network) {
+            int shutdown_res = dd_request_shutdown(conn);
+            if (shutdown_res == dd_network ||
+                (res != dd_should_block && res != dd_should_redirect)) {
+                res = shutdown_res;
+            }
+        }
         if (res == dd_network) {
             mlog_g(dd_log_info,
                 "request_shutdown failed with dd_network; closing "
@@ -465,6 +486,44 @@ static PHP_FUNCTION(datadog_appsec_is_enabled)
     RETURN_BOOL(DDAPPSEC_G(enabled) == ENABLED);
 }
 
+static PHP_FUNCTION(datadog_appsec_push_address)
+{
+    zend_string *key = NULL;
+    zval *value = NULL;
+    if (zend_parse_parameters(ZEND_NUM_ARGS(), "Sz", &key, &value) ==
+        FAILURE) {
+        RETURN_FALSE;
+    }
+
+    if (DDAPPSEC_G(enabled) != ENABLED) {
+        RETURN_FALSE;
+    }
+
+    dd_conn *conn = dd_helper_mgr_cur_conn();
+    if (conn == NULL) {
+        mlog_g(dd_log_debug, "No connection; skipping address %s",
+            ZSTR_VAL(key));
+        RETURN_FALSE;
+    }
+
+    zval data;
+    array_init_size(&data, 1);
+    Z_TRY_ADDREF_P(value);
+    zend_hash_add_new(Z_ARRVAL(data), key, value);
+
+    // Only sent with the next request_exec, unless too many are pending
+    dd_result res = dd_request_exec_push(conn, &data);
+    zval_ptr_dtor(&data);
+
+    if (res == dd_should_block) {
+        dd_request_abort_static_page();
+    } else if (res == dd_should_redirect) {
+        dd_request_abort_redirect();
+    }
+
+    RETURN_BOOL(res == dd_success);
+}
+
 static PHP_FUNCTION(datadog_appsec_testing_rinit)
 {
     if (zend_parse_parameters_none() == FAILURE) {
@@ -488,6 +547,10 @@ static PHP_FUNCTION(datadog_appsec_testing_rshutdown)
     DDAPPSEC_G(during_request_shutdown) = true;
     mlog(dd_log_debug, "Running rshutdown actions");
     int res = dd_appsec_rshutdown(false);
+    // as the real RSHUTDOWN, so the next rinit starts from a clean state
+    dd_ip_extraction_rshutdown();
+    dd_request_headers_rshutdown();
+    dd_request_exec_rshutdown();
     DDAPPSEC_G(during_request_shutdown) = false;
     if (res == 0) {
         RETURN_TRUE;
@@ -552,9 +615,15 @@ ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(request_exec_arginfo, 0, 1, _IS_BOOL, 0)
 ZEND_ARG_INFO(0, "data")
 ZEND_END_ARG_INFO()
 
+ZEND_BEGIN_ARG_WITH_RETURN_TYPE_INFO_EX(push_address_arginfo, 0, 2, _IS_BOOL, 0)
+ZEND_ARG_TYPE_INFO(0, key, IS_STRING, 0)
+ZEND_ARG_INFO(0, value)
+ZEND_END_ARG_INFO()
+
 // clang-format off
 static const zend_function_entry functions[] = {
     ZEND_RAW_FENTRY(DD_APPSEC_NS "is_enabled", PHP_FN(datadog_appsec_is_enabled), void_ret_bool_arginfo, 0)
+    ZEND_RAW_FENTRY(DD_APPSEC_NS "push_address", PHP_FN(datadog_appsec_push_address), push_address_arginfo, 0)
     PHP_FE_END
 };
 static const zend_function_entry testing_functions[] = {
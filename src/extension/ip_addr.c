@@ -0,0 +1,439 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+#include "ip_addr.h"
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#    include <emmintrin.h>
+#endif
+
+#define IPV4_LEN 4
+#define IPV6_LEN 16
+#define IPV4_BITS 32
+#define IPV6_BITS 128
+
+static bool _parse_v4(const char *nonnull s, const char *nonnull end,
+    uint8_t out[static IPV4_LEN]);
+static bool _parse_v6(const char *nonnull s, const char *nonnull end,
+    uint8_t out[static IPV6_LEN]);
+
+bool dd_ip_parse(const char *nonnull s, size_t len, dd_ipaddr *nonnull out)
+{
+    if (len == 0) {
+        return false;
+    }
+
+    const char *end = s + len;
+    uint8_t v4[IPV4_LEN];
+    if (_parse_v4(s, end, v4)) {
+        out->af = AF_INET;
+        memcpy(&out->v4.s_addr, v4, sizeof(v4));
+        return true;
+    }
+
+    if (!_parse_v6(s, end, out->v6.s6_addr)) {
+        return false;
+    }
+
+    static const uint8_t ip4_mapped_prefix[12] = {[10 ... 11] = 0xFF};
+    const uint8_t *s6addr = out->v6.s6_addr;
+    if (memcmp(s6addr, ip4_mapped_prefix, sizeof(ip4_mapped_prefix)) == 0) {
+        memcpy(v4, s6addr + sizeof(ip4_mapped_prefix), sizeof(v4));
+        memcpy(&out->v4.s_addr, v4, sizeof(v4));
+        out->af = AF_INET;
+    } else {
+        out->af = AF_INET6;
+    }
+    return true;
+}
+
+bool dd_ip_parse_maybe_port(
+    const char *nonnull s, size_t len, dd_ipaddr *nonnull out)
+{
+    if (len == 0) {
+        return false;
+    }
+    if (s[0] == '[') { // ipv6
+        const char *pos_close = memchr(s + 1, ']', len - 1);
+        if (!pos_close) {
+            return false;
+        }
+        return dd_ip_parse(s + 1, pos_close - (s + 1), out);
+    }
+    const char *colon = memchr(s, ':', len);
+    if (colon && memchr(colon + 1, ':', len - (colon + 1 - s)) == NULL) {
+        return dd_ip_parse(s, colon - s, out);
+    }
+
+    return dd_ip_parse(s, len, out);
+}
+
+// dotted decimal, exactly 4 parts and no leading zeros, as inet_pton
+static bool _parse_v4(const char *nonnull s, const char *nonnull end,
+    uint8_t out[static IPV4_LEN])
+{
+    unsigned parts = 0;
+    while (true) {
+        const char *start = s;
+        unsigned val = 0;
+        for (; s < end && *s >= '0' && *s <= '9'; s++) {
+            // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            val = val * 10 + (unsigned)(*s - '0');
+            // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            if (val > 255) {
+                return false;
+            }
+        }
+        if (s == start || (s - start > 1 && *start == '0')) {
+            return false;
+        }
+        out[parts++] = (uint8_t)val;
+        if (parts == IPV4_LEN) {
+            return s == end;
+        }
+        if (s == end || *s != '.') {
+            return false;
+        }
+        s++;
+    }
+}
+
+static inline int _hex_val(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c = (char)(c | 0x20); // NOLINT(hicpp-signed-bitwise)
+    if (c >= 'a' && c <= 'f') {
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// RFC 4291, section 2.2, as inet_pton
+static bool _parse_v6(const char *nonnull s, const char *nonnull end,
+    uint8_t out[static IPV6_LEN])
+{
+    uint8_t tmp[IPV6_LEN] = {0};
+    unsigned tp = 0;
+    int colonp = -1;
+
+    // a leading : must be part of a ::
+    if (s < end && *s == ':') {
+        if (s + 1 == end || s[1] != ':') {
+            return false;
+        }
+        s++;
+    }
+
+    const char *curtok = s;
+    bool saw_xdigit = false;
+    unsigned ndigits = 0;
+    unsigned val = 0;
+    while (s < end) {
+        char ch = *s++;
+        int digit = _hex_val(ch);
+        if (digit >= 0) {
+            if (ndigits == 4) {
+                return false;
+            }
+            val = (val << 4) | (unsigned)digit; // NOLINT(hicpp-signed-bitwise)
+            ndigits++;
+            saw_xdigit = true;
+            continue;
+        }
+        if (ch == ':') {
+            curtok = s;
+            if (!saw_xdigit) {
+                if (colonp >= 0) {
+                    return false;
+                }
+                colonp = (int)tp;
+                continue;
+            }
+            if (s == end || tp + 2 > IPV6_LEN) {
+                return false;
+            }
+            tmp[tp++] = (uint8_t)(val >> 8); // NOLINT
+            tmp[tp++] = (uint8_t)val;
+            saw_xdigit = false;
+            ndigits = 0;
+            val = 0;
+            continue;
+        }
+        if (ch == '.' && tp + IPV4_LEN <= IPV6_LEN &&
+            _parse_v4(curtok, end, &tmp[tp])) {
+            tp += IPV4_LEN;
+            saw_xdigit = false;
+            break;
+        }
+        return false;
+    }
+
+    if (saw_xdigit) {
+        if (tp + 2 > IPV6_LEN) {
+            return false;
+        }
+        tmp[tp++] = (uint8_t)(val >> 8); // NOLINT
+        tmp[tp++] = (uint8_t)val;
+    }
+
+    if (colonp >= 0) {
+        // :: must stand for at least one group
+        if (tp == IPV6_LEN) {
+            return false;
+        }
+        unsigned n = tp - (unsigned)colonp;
+        memmove(&tmp[IPV6_LEN - n], &tmp[colonp], n);
+        memset(&tmp[colonp], 0, IPV6_LEN - n - (unsigned)colonp);
+        tp = IPV6_LEN;
+    }
+
+    if (tp != IPV6_LEN) {
+        return false;
+    }
+    memcpy(out, tmp, IPV6_LEN);
+    return true;
+}
+
+static const char *nonnull _find_comma(
+    const char *nonnull p, const char *nonnull end)
+{
+#ifdef __SSE2__
+    // X-Forwarded-For values routinely have several hops
+    const __m128i comma = _mm_set1_epi8(',');
+    while (end - p >= (ptrdiff_t)sizeof(__m128i)) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        unsigned mask =
+            (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, comma));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += sizeof(__m128i);
+    }
+#endif
+    for (; p < end; p++) {
+        if (*p == ',') {
+            return p;
+        }
+    }
+    return end;
+}
+
+static inline bool _is_ws(char c) { return c == ' ' || c == '\t'; }
+
+bool dd_list_iter_next(dd_list_iter *nonnull it,
+    const char *nonnull *nonnull elem, size_t *nonnull elem_len)
+{
+    while (it->cur < it->end) {
+        const char *start = it->cur;
+        const char *comma = _find_comma(start, it->end);
+        it->cur = comma < it->end ? comma + 1 : it->end;
+
+        const char *stop = comma;
+        while (start < stop && _is_ws(*start)) { start++; }
+        while (stop > start && _is_ws(stop[-1])) { stop--; }
+        if (start != stop) {
+            *elem = start;
+            *elem_len = stop - start;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct _dd_cidr_node {
+    uint8_t key[IPV6_LEN]; // only the first bits bits can be set
+    uint8_t bits;
+    bool terminal; // whether the node is a network in the set
+    dd_cidr_node *nullable child[2];
+};
+
+static inline unsigned _bit(const uint8_t *nonnull key, unsigned i)
+{
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    return (key[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+static unsigned _common_bits(
+    const uint8_t *nonnull a, const uint8_t *nonnull b, unsigned max)
+{
+    unsigned i = 0;
+    for (; i < max; i += 8) { // NOLINT
+        unsigned diff = a[i >> 3] ^ b[i >> 3];
+        if (diff) {
+            // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            i += (unsigned)__builtin_clz(diff) - 24;
+            break;
+        }
+    }
+    return i < max ? i : max;
+}
+
+static inline bool _prefix_matches(
+    const dd_cidr_node *nonnull node, const uint8_t *nonnull key)
+{
+    unsigned full = node->bits / 8; // NOLINT
+    for (unsigned i = 0; i < full; i++) {
+        if (node->key[i] != key[i]) {
+            return false;
+        }
+    }
+    unsigned rem = node->bits % 8; // NOLINT
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    return rem == 0 || ((node->key[full] ^ key[full]) >> (8 - rem)) == 0;
+}
+
+static dd_cidr_node *nullable _node_new(
+    const uint8_t *nonnull key, unsigned bits, bool terminal)
+{
+    dd_cidr_node *node = calloc(1, sizeof(*node));
+    if (!node) {
+        return NULL;
+    }
+    unsigned full = bits / 8;
+    memcpy(node->key, key, full);
+    if (bits % 8) {
+        // NOLINTNEXTLINE(hicpp-signed-bitwise)
+        node->key[full] = key[full] & (uint8_t)(0xFF << (8 - bits % 8));
+    }
+    node->bits = (uint8_t)bits;
+    node->terminal = terminal;
+    return node;
+}
+
+static bool _trie_add(
+    dd_cidr_node *nullable *nonnull link, const uint8_t *nonnull key, unsigned bits)
+{
+    while (true) {
+        dd_cidr_node *node = *link;
+        if (!node) {
+            *link = _node_new(key, bits, true);
+            return *link != NULL;
+        }
+
+        unsigned max = node->bits < bits ? node->bits : bits;
+        unsigned common = _common_bits(node->key, key, max);
+        if (common == node->bits) {
+            if (bits == node->bits) {
+                node->terminal = true;
+                return true;
+            }
+            link = &node->child[_bit(key, node->bits)];
+            continue;
+        }
+
+        // the new network diverges from node (or contains it); split
+        dd_cidr_node *split = _node_new(key, common, common == bits);
+        if (!split) {
+            return false;
+        }
+        split->child[_bit(node->key, common)] = node;
+        if (common != bits) {
+            dd_cidr_node *leaf = _node_new(key, bits, true);
+            if (!leaf) {
+                free(split);
+                return false;
+            }
+            split->child[_bit(key, common)] = leaf;
+        }
+        *link = split;
+        return true;
+    }
+}
+
+static bool _trie_contains(const dd_cidr_node *nullable node,
+    const uint8_t *nonnull key, unsigned max_bits)
+{
+    while (node) {
+        if (!_prefix_matches(node, key)) {
+            return false;
+        }
+        if (node->terminal) {
+            return true;
+        }
+        if (node->bits >= max_bits) {
+            return false;
+        }
+        node = node->child[_bit(key, node->bits)];
+    }
+    return false;
+}
+
+static void _trie_destroy(dd_cidr_node *nullable node)
+{
+    if (!node) {
+        return;
+    }
+    _trie_destroy(node->child[0]);
+    _trie_destroy(node->child[1]);
+    free(node);
+}
+
+bool dd_cidr_set_add_addr(
+    dd_cidr_set *nonnull set, const dd_ipaddr *nonnull addr, unsigned bits)
+{
+    if (addr->af == AF_INET) {
+        if (bits > IPV4_BITS) {
+            return false;
+        }
+        return _trie_add(&set->v4, (const uint8_t *)&addr->v4.s_addr, bits);
+    }
+    if (bits > IPV6_BITS) {
+        return false;
+    }
+    return _trie_add(&set->v6, addr->v6.s6_addr, bits);
+}
+
+bool dd_cidr_set_add(
+    dd_cidr_set *nonnull set, const char *nonnull cidr, size_t len)
+{
+    const char *slash = memchr(cidr, '/', len);
+    dd_ipaddr addr;
+    if (!dd_ip_parse(cidr, slash ? (size_t)(slash - cidr) : len, &addr)) {
+        return false;
+    }
+
+    unsigned bits = addr.af == AF_INET ? IPV4_BITS : IPV6_BITS;
+    if (slash) {
+        const char *p = slash + 1;
+        const char *end = cidr + len;
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+        if (p == end || end - p > 3) {
+            return false;
+        }
+        bits = 0;
+        for (; p < end; p++) {
+            if (*p < '0' || *p > '9') {
+                return false;
+            }
+            // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+            bits = bits * 10 + (unsigned)(*p - '0');
+        }
+    }
+
+    return dd_cidr_set_add_addr(set, &addr, bits);
+}
+
+bool dd_cidr_set_contains(
+    const dd_cidr_set *nonnull set, const dd_ipaddr *nonnull addr)
+{
+    if (addr->af == AF_INET) {
+        return _trie_contains(
+            set->v4, (const uint8_t *)&addr->v4.s_addr, IPV4_BITS);
+    }
+    return _trie_contains(set->v6, addr->v6.s6_addr, IPV6_BITS);
+}
+
+void dd_cidr_set_destroy(dd_cidr_set *nonnull set)
+{
+    _trie_destroy(set->v4);
+    _trie_destroy(set->v6);
+    set->v4 = NULL;
+    set->v6 = NULL;
+}
@@ -0,0 +1,63 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+#pragma once
+
+// This file does not depend on PHP, so that it can be benchmarked separately
+// (see tests/bench_ip_extraction)
+
+#include "attributes.h"
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct _dd_ipaddr {
+    int af;
+    union {
+        struct in_addr v4;
+        struct in6_addr v6;
+    };
+} dd_ipaddr;
+
+// Parses an IPv4 or IPv6 address. The input needn't be NUL-terminated.
+// IPv4-mapped IPv6 addresses are returned as IPv4 addresses
+bool dd_ip_parse(const char *nonnull s, size_t len, dd_ipaddr *nonnull out);
+
+// Like dd_ip_parse, but also accepts addr:port and [addr6]:port
+bool dd_ip_parse_maybe_port(
+    const char *nonnull s, size_t len, dd_ipaddr *nonnull out);
+
+// Iterates over the elements of a comma separated header list, with the
+// surrounding whitespace removed. Empty elements are skipped
+typedef struct _dd_list_iter {
+    const char *nonnull cur;
+    const char *nonnull end;
+} dd_list_iter;
+
+static inline void dd_list_iter_init(
+    dd_list_iter *nonnull it, const char *nonnull s, size_t len)
+{
+    it->cur = s;
+    it->end = s + len;
+}
+bool dd_list_iter_next(dd_list_iter *nonnull it, const char *nonnull *nonnull elem,
+    size_t *nonnull elem_len);
+
+// A set of IPv4/IPv6 networks, stored in path-compressed binary tries
+typedef struct _dd_cidr_node dd_cidr_node;
+typedef struct _dd_cidr_set {
+    dd_cidr_node *nullable v4;
+    dd_cidr_node *nullable v6;
+} dd_cidr_set;
+
+// Accepts both address/prefix_len and plain addresses
+bool dd_cidr_set_add(
+    dd_cidr_set *nonnull set, const char *nonnull cidr, size_t len);
+bool dd_cidr_set_add_addr(
+    dd_cidr_set *nonnull set, const dd_ipaddr *nonnull addr, unsigned bits);
+bool dd_cidr_set_contains(
+    const dd_cidr_set *nonnull set, const dd_ipaddr *nonnull addr);
+void dd_cidr_set_destroy(dd_cidr_set *nonnull set);
@@ -8,6 +8,7 @@
 #include "attributes.h"
 #include "ddappsec.h"
 #include "dddefs.h"
+#include "ip_addr.h"
 #include "logging.h"
 #include "php_compat.h"
 #include "php_helpers.h"
@@ -20,13 +21,7 @@
 #include <zend_API.h>
 #include <zend_smart_str.h>
 
-typedef struct _ipaddr {
-    int af;
-    union {
-        struct in_addr v4;
-        struct in6_addr v6;
-    };
-} ipaddr;
+typedef dd_ipaddr ipaddr;
 
 typedef bool (*extract_func_t)(zend_string *nonnull value, ipaddr *nonnull out);
 
@@ -53,6 +48,9 @@ typedef enum _priority_header_id {
 static header_map_node priority_header_map[MAX_HEADER_ID];
 
 static zend_string *nonnull _remote_addr_key;
+// private networks and, if configured, the trusted proxies. Addresses in these
+// networks are skipped when looking for the client ip
+static dd_cidr_set _skipped_networks;
 static THREAD_LOCAL_ON_ZTS zend_string *nullable client_ip;
 
 static void _register_testing_objects(void);
@@ -67,6 +65,7 @@ static bool _parse_x_forwarded_for(
 static bool _parse_plain(zend_string *nonnull zvalue, ipaddr *nonnull out);
 static bool _parse_plain_raw(zend_string *nonnull zvalue, ipaddr *nonnull out);
 static bool _parse_forwarded(zend_string *nonnull zvalue, ipaddr *nonnull out);
+static void _init_private_networks(void);
 
 static void _init_relevant_ip_headers()
 {
@@ -115,9 +114,29 @@ void dd_ip_extraction_startup()
     _remote_addr_key = zend_string_init_interned(ZEND_STRL("REMOTE_ADDR"), 1);
 
     _init_relevant_ip_headers();
+    _init_private_networks();
     _register_testing_objects();
 }
 
+void dd_ip_extraction_rinit_once()
+{
+    zval *cidr;
+    ZEND_HASH_FOREACH_VAL(get_global_DD_APPSEC_TRUSTED_PROXIES(), cidr)
+    {
+        if (Z_TYPE_P(cidr) != IS_STRING) {
+            continue;
+        }
+        if (!dd_cidr_set_add(
+                &_skipped_networks, Z_STRVAL_P(cidr), Z_STRLEN_P(cidr))) {
+            mlog(dd_log_warning, "Invalid network in trusted proxies: %s",
+                Z_STRVAL_P(cidr));
+        }
+    }
+    ZEND_HASH_FOREACH_END();
+}
+
+void dd_ip_extraction_shutdown() { dd_cidr_set_destroy(&_skipped_networks); }
+
 bool dd_parse_client_ip_header_config(
     zai_str value, zval *nonnull decoded_value, bool persistent)
 {
@@ -264,20 +283,17 @@ static bool _parse_ip_address_maybe_port_pair(
 static bool _parse_x_forwarded_for(
     zend_string *nonnull zvalue, ipaddr *nonnull out)
 {
-    const char *value = ZSTR_VAL(zvalue);
-    const char *end = value + ZSTR_LEN(zvalue);
-    bool succ;
-    do {
-        for (; value < end && *value == ' '; value++) {}
-        const char *comma = memchr(value, ',', end - value);
-        const char *end_cur = comma ? comma : end;
-        succ = _parse_ip_address_maybe_port_pair(value, end_cur - value, out);
-        if (succ) {
-            succ = !_is_private(out);
+    dd_list_iter it;
+    dd_list_iter_init(&it, ZSTR_VAL(zvalue), ZSTR_LEN(zvalue));
+    const char *elem;
+    size_t elem_len;
+    while (dd_list_iter_next(&it, &elem, &elem_len)) {
+        if (_parse_ip_address_maybe_port_pair(elem, elem_len, out) &&
+            !_is_private(out)) {
+            return true;
         }
-        value = (comma && comma + 1 < end) ? (comma + 1) : NULL;
-    } while (!succ && value);
-    return succ;
+    }
+    return false;
 }
 
 static bool _parse_forwarded(zend_string *nonnull zvalue, ipaddr *nonnull out)
@@ -379,48 +395,23 @@ static bool _parse_plain(zend_string *nonnull zvalue, ipaddr *nonnull out)
            !_is_private(out);
 }
 
+static void _log_not_recognized(const char *nonnull addr, size_t addr_len)
+{
+    int len = addr_len > INT_MAX ? INT_MAX : (int)addr_len;
+    mlog(dd_log_info, "Not recognized as IP address: \"%.*s\"", len, addr);
+}
+
 static bool _parse_ip_address(
-    const char *nonnull _addr, size_t addr_len, ipaddr *nonnull out)
+    const char *nonnull addr, size_t addr_len, ipaddr *nonnull out)
 {
     if (addr_len == 0) {
         return false;
     }
-    char *addr = safe_emalloc(addr_len, 1, 1);
-    memcpy(addr, _addr, addr_len);
-    addr[addr_len] = '\0';
-
-    bool res = true;
-
-    int ret = inet_pton(AF_INET, addr, &out->v4);
-    if (ret != 1) {
-        ret = inet_pton(AF_INET6, addr, &out->v6);
-        if (ret != 1) {
-            mlog(dd_log_info, "Not recognized as IP address: \"%s\"", addr);
-            res = false;
-            goto err;
-        }
-
-        uint8_t *s6addr = out->v6.s6_addr;
-        static const uint8_t ip4_mapped_prefix[12] = {[10 ... 11] = 0xFF};
-        if (memcmp(s6addr, ip4_mapped_prefix, sizeof(ip4_mapped_prefix)) == 0) {
-            // IPv4 mapped
-            mlog(dd_log_debug, "Parsed as IPv4 mapped address: %s", addr);
-            uint8_t s4addr[4];
-            memcpy(s4addr, s6addr + sizeof(ip4_mapped_prefix), 4);
-            memcpy(&out->v4.s_addr, s4addr, sizeof(s4addr));
-            out->af = AF_INET;
-        } else {
-            mlog(dd_log_debug, "Parsed as IPv6 address: %s", addr);
-            out->af = AF_INET6;
-        }
-    } else {
-        mlog(dd_log_debug, "Parsed as IPv4 address: %s", addr);
-        out->af = AF_INET;
+    if (!dd_ip_parse(addr, addr_len, out)) {
+        _log_not_recognized(addr, addr_len);
+        return false;
     }
-
-err:
-    efree(addr);
-    return res;
+    return true;
 }
 
 static bool _parse_ip_address_maybe_port_pair(
@@ -429,116 +420,38 @@ static bool _parse_ip_address_maybe_port_pair(
     if (addr_len == 0) {
         return false;
     }
-    if (addr[0] == '[') { // ipv6
-        const char *pos_close = memchr(addr + 1, ']', addr_len - 1);
-        if (!pos_close) {
-            return false;
-        }
-        return _parse_ip_address(addr + 1, pos_close - (addr + 1), out);
-    }
-    const char *colon = memchr(addr, ':', addr_len);
-    if (colon && zend_memrchr(addr, ':', addr_len) == colon) {
-        return _parse_ip_address(addr, colon - addr, out);
-    }
-
-    return _parse_ip_address(addr, addr_len, out);
-}
-
-#define CT_HTONL(x)                                                            \
-    ((((x) >> 24) & 0x000000FFU) | (((x) >> 8) & 0x0000FF00U) |                \
-        (((x) << 8) & 0x00FF0000U) | (((x) << 24) & 0xFF000000U))
-
-static bool _is_private_v4(const struct in_addr *nonnull addr)
-{
-    static const struct {
-        struct in_addr base;
-        struct in_addr mask;
-    } priv_ranges[] = {
-        {
-            .base.s_addr = CT_HTONL(0x0A000000U), // 10.0.0.0
-            .mask.s_addr = CT_HTONL(0xFF000000U), // 255.0.0.0
-        },
-        {
-            .base.s_addr = CT_HTONL(0xAC100000U), // 172.16.0.0
-            .mask.s_addr = CT_HTONL(0xFFF00000U), // 255.240.0.0
-        },
-        {
-            .base.s_addr = CT_HTONL(0xC0A80000U), // 192.168.0.0
-            .mask.s_addr = CT_HTONL(0xFFFF0000U), // 255.255.0.0
-        },
-        {
-            .base.s_addr = CT_HTONL(0x7F000000U), // 127.0.0.0
-            .mask.s_addr = CT_HTONL(0xFF000000U), // 255.0.0.0
-        },
-        {
-            .base.s_addr = CT_HTONL(0xA9FE0000U), // 169.254.0.0
-            .mask.s_addr = CT_HTONL(0xFFFF0000U), // 255.255.0.0
-        },
-    };
-
-    for (unsigned i = 0; i < ARRAY_SIZE(priv_ranges); i++) {
-        __auto_type range = priv_ranges[i];
-        if ((addr->s_addr & range.mask.s_addr) == range.base.s_addr) {
-            return true;
-        }
+    if (!dd_ip_parse_maybe_port(addr, addr_len, out)) {
+        _log_not_recognized(addr, addr_len);
+        return false;
     }
-    return false;
+    return true;
 }
 
-static bool _is_private_v6(const struct in6_addr *nonnull addr)
+static void _init_private_networks()
 {
-    // clang-format off
-    static const struct {
-        union {
-            struct in6_addr base;
-            unsigned __int128 base_i;
-        };
-        union {
-            struct in6_addr mask;
-            unsigned __int128 mask_i;
-        };
-    } priv_ranges[] = {
-        {
-            .base.s6_addr = {[15] = 1}, // loopback
-            .mask.s6_addr = {[0 ... 15] = 0xFF}, // /128
-        },
-        {
-            .base.s6_addr = {0xFE, 0x80}, // link-local
-            .mask.s6_addr = {0xFF, 0xC0}, // /10
-        },
-        {
-            .base.s6_addr = {0xFE, 0xC0}, // site-local
-            .mask.s6_addr = {0xFF, 0xC0}, // /10
-        },
-        {
-            .base.s6_addr = {0xFD}, // unique local address
-            .mask.s6_addr = {0xFF}, // /8
-        },
-        {
-            .base.s6_addr = {0xFC},
-            .mask.s6_addr = {0xFE}, // /7
-        },
+    static const char *const private_networks[] = {
+        "10.0.0.0/8",
+        "172.16.0.0/12",
+        "192.168.0.0/16",
+        "127.0.0.0/8",
+        "169.254.0.0/16",
+        "::1/128",    // loopback
+        "fe80::/10",  // link-local
+        "fec0::/10",  // site-local
+        "fc00::/7",   // unique local address
     };
-    // clang-format on
-
-    unsigned __int128 addr_i;
-    memcpy(&addr_i, addr->s6_addr, sizeof(addr_i));
 
-    for (unsigned i = 0; i < ARRAY_SIZE(priv_ranges); i++) {
-        __auto_type range = &priv_ranges[i];
-        if ((addr_i & range->mask_i) == range->base_i) {
-            return true;
+    for (unsigned i = 0; i < ARRAY_SIZE(private_networks); i++) {
+        const char *net = private_networks[i];
+        if (!dd_cidr_set_add(&_skipped_networks, net, strlen(net))) {
+            mlog(dd_log_error, "Failed adding private network %s", net);
         }
     }
-    return false;
 }
 
 static bool _is_private(const ipaddr *nonnull addr)
 {
-    if (addr->af == AF_INET) {
-        return _is_private_v4(&addr->v4);
-    }
-    return _is_private_v6(&addr->v6);
+    return dd_cidr_set_contains(&_skipped_networks, addr);
 }
 
 static PHP_FUNCTION(datadog_appsec_testing_extract_ip_addr)
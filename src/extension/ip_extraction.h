@@ -15,6 +15,8 @@
 #include <php.h>
 
 void dd_ip_extraction_startup(void);
+void dd_ip_extraction_rinit_once(void);
+void dd_ip_extraction_shutdown(void);
 void dd_ip_extraction_rinit(void);
 void dd_ip_extraction_rshutdown(void);
 
@@ -147,16 +147,27 @@ static void _iovec_writer_flush(
 
 static void _iovec_writer_teardown(mpack_writer_t *w);
 
+// below this size, fragments are copied into the writer's buffer
+static const size_t FRAGMENT_MIN_LEN_BY_REF = 128;
+// after splicing a fragment, keep writing to the rest of the current buffer
+// only if at least this much space is left
+static const size_t MIN_BUFFER_TAIL = 1024;
+
 typedef struct {
     zend_llist *list;
+    // the current buffer is the tail of a buffer already in the list, so it's
+    // not to be freed on its own
+    bool buffer_is_tail;
 } may_alias iovec_list_t;
 
 static void _iovec_list_destroy(void *ptr)
 {
-    struct iovec *iov = ptr;
-    MPACK_FREE(iov->iov_base);
-    iov->iov_base = NULL;
-    iov->iov_len = 0;
+    dd_iovec *diov = ptr;
+    if (diov->owned) {
+        MPACK_FREE(diov->iov.iov_base);
+    }
+    diov->iov.iov_base = NULL;
+    diov->iov.iov_len = 0;
 }
 
 void dd_mpack_writer_init_iov(
@@ -167,7 +178,8 @@ void dd_mpack_writer_init_iov(
     iovec_list_t *iovecl = (iovec_list_t *)writer->reserved;
 
     iovecl->list = iovec_list;
-    zend_llist_init(iovec_list, sizeof(struct iovec), _iovec_list_destroy, 0);
+    iovecl->buffer_is_tail = false;
+    zend_llist_init(iovec_list, sizeof(dd_iovec), _iovec_list_destroy, 0);
 
     const size_t capacity = MPACK_BUFFER_SIZE;
     char *buffer = MPACK_MALLOC(capacity);
@@ -181,6 +193,127 @@ void dd_mpack_writer_init_iov(
     mpack_writer_set_teardown(writer, _iovec_writer_teardown);
 }
 
+bool dd_mpack_fragment_init(
+    dd_mpack_fragment *nonnull frag, dd_mpack_fragment_cb nonnull cb)
+{
+    mpack_writer_t w;
+    char *data = NULL;
+    size_t len = 0;
+    mpack_writer_init_growable(&w, &data, &len);
+    cb(&w);
+    if (mpack_writer_destroy(&w) != mpack_ok) {
+        mlog(dd_log_warning, "Failed encoding msgpack fragment");
+        *frag = (dd_mpack_fragment){0};
+        return false;
+    }
+
+    frag->data = data;
+    frag->len = len;
+    return true;
+}
+
+bool dd_mpack_fragment_init_str(
+    dd_mpack_fragment *nonnull frag, const char *nonnull str, size_t len)
+{
+    mpack_writer_t w;
+    char *data = NULL;
+    size_t data_len = 0;
+    mpack_writer_init_growable(&w, &data, &data_len);
+    mpack_write_str(&w, str, len);
+    if (mpack_writer_destroy(&w) != mpack_ok) {
+        mlog(dd_log_warning, "Failed encoding msgpack fragment");
+        *frag = (dd_mpack_fragment){0};
+        return false;
+    }
+
+    frag->data = data;
+    frag->len = data_len;
+    return true;
+}
+
+void dd_mpack_fragment_destroy(dd_mpack_fragment *nonnull frag)
+{
+    if (frag->data) {
+        MPACK_FREE(frag->data);
+    }
+    *frag = (dd_mpack_fragment){0};
+}
+
+static void _iovec_writer_splice(
+    mpack_writer_t *nonnull w, const char *nonnull data, size_t len);
+void dd_mpack_write_fragment(
+    mpack_writer_t *nonnull w, const dd_mpack_fragment *nonnull frag)
+{
+    if (UNEXPECTED(!frag->data)) {
+        // initialization failed; the message would be inconsistent
+        mpack_writer_flag_error(w, mpack_error_bug);
+        return;
+    }
+
+    if (frag->len >= FRAGMENT_MIN_LEN_BY_REF && w->flush == _iovec_writer_flush
+#if MPACK_BUILDER
+        && w->builder.current_build == NULL
+#endif
+    ) {
+        _iovec_writer_splice(w, frag->data, frag->len);
+        return;
+    }
+
+    mpack_write_object_bytes(w, frag->data, frag->len);
+}
+
+static void _iovec_writer_splice(
+    mpack_writer_t *nonnull w, const char *nonnull data, size_t len)
+{
+    if (mpack_writer_error(w) != mpack_ok) {
+        return;
+    }
+
+#if MPACK_WRITE_TRACKING
+    mpack_error_t err = mpack_track_element(&w->track, false);
+    if (err != mpack_ok) {
+        mpack_writer_flag_error(w, err);
+        return;
+    }
+#endif
+
+    iovec_list_t *giovec = (iovec_list_t *)w->reserved;
+
+    size_t used = mpack_writer_buffer_used(w);
+    if (used > 0) {
+        // hand over what was written so far, like a flush would do
+        zend_llist_add_element(giovec->list, &(dd_iovec){
+                                                 .iov.iov_base = w->buffer,
+                                                 .iov.iov_len = used,
+                                                 .owned = !giovec->buffer_is_tail,
+                                             });
+
+        if ((size_t)(w->end - w->position) >= MIN_BUFFER_TAIL) {
+            w->buffer = w->position;
+            giovec->buffer_is_tail = true;
+        } else {
+            char *new_buffer = MPACK_MALLOC(MPACK_BUFFER_SIZE);
+            if (!new_buffer) {
+                w->buffer = NULL;
+                w->position = NULL;
+                w->end = NULL;
+                mpack_writer_flag_error(w, mpack_error_memory);
+                return;
+            }
+            w->buffer = new_buffer;
+            w->position = new_buffer;
+            w->end = new_buffer + MPACK_BUFFER_SIZE;
+            giovec->buffer_is_tail = false;
+        }
+    }
+
+    zend_llist_add_element(giovec->list, &(dd_iovec){
+                                             .iov.iov_base = (void *)data,
+                                             .iov.iov_len = len,
+                                             .owned = false,
+                                         });
+}
+
 static void _iovec_writer_flush(
     mpack_writer_t *w, const char *data, size_t count)
 {
@@ -196,10 +329,12 @@ static void _iovec_writer_flush(
 
     if (data == w->buffer) {
         // in this case, we can use the buffer without copying
-        zend_llist_add_element(giovec->list, &(struct iovec){
-                                                 .iov_base = w->buffer,
-                                                 .iov_len = count,
+        zend_llist_add_element(giovec->list, &(dd_iovec){
+                                                 .iov.iov_base = w->buffer,
+                                                 .iov.iov_len = count,
+                                                 .owned = !giovec->buffer_is_tail,
                                              });
+        giovec->buffer_is_tail = false;
 
         if (mpack_writer_buffer_used(w) == count) {
             // teardown, no allocation of new buffer
@@ -228,9 +363,10 @@ static void _iovec_writer_flush(
     }
 
     memcpy(iovec_buffer, data, count); // NOLINT
-    zend_llist_add_element(giovec->list, &(struct iovec){
-                                             .iov_base = iovec_buffer,
-                                             .iov_len = count,
+    zend_llist_add_element(giovec->list, &(dd_iovec){
+                                             .iov.iov_base = iovec_buffer,
+                                             .iov.iov_len = count,
+                                             .owned = true,
                                          });
 }
 
@@ -242,7 +378,9 @@ static void _iovec_writer_teardown(mpack_writer_t *w)
         zend_llist_clean(giovec->list);
     }
 
-    MPACK_FREE(w->buffer);
+    if (!giovec->buffer_is_tail) {
+        MPACK_FREE(w->buffer);
+    }
     w->buffer = NULL;
     w->context = NULL;
 }
@@ -10,6 +10,7 @@
 #include "string_helpers.h"
 #include <mpack.h>
 #include <php.h>
+#include <sys/uio.h>
 
 // safe against null returning from mpack_node_str because length is checked 1st
 #define dd_mpack_node_lstr_eq(node, lstr)                                      \
@@ -34,7 +35,36 @@ void dd_mpack_write_nullable_zstr(
 
 void dd_mpack_write_zval(mpack_writer_t *nonnull w, zval *nullable zv);
 
+// Elements of the lists filled by the iovec writer. The iovec is the first
+// member, so the elements can be used as struct iovec
+typedef struct _dd_iovec {
+    struct iovec iov;
+    bool owned;
+} dd_iovec;
+
 void dd_mpack_writer_init_iov(
     mpack_writer_t *nonnull writer, zend_llist *nonnull iovec_list);
 
+// A single msgpack object, encoded once (normally on MINIT) and written as is
+// afterwards. The data is allocated with MPACK_MALLOC.
+typedef struct _dd_mpack_fragment {
+    char *nullable data;
+    size_t len;
+} dd_mpack_fragment;
+
+typedef void (*dd_mpack_fragment_cb)(mpack_writer_t *nonnull w);
+
+bool dd_mpack_fragment_init(
+    dd_mpack_fragment *nonnull frag, dd_mpack_fragment_cb nonnull cb);
+bool dd_mpack_fragment_init_str(
+    dd_mpack_fragment *nonnull frag, const char *nonnull str, size_t len);
+#define dd_mpack_fragment_init_lstr(frag, str)                                 \
+    dd_mpack_fragment_init_str(frag, str, LSTRLEN(str))
+void dd_mpack_fragment_destroy(dd_mpack_fragment *nonnull frag);
+
+// Large fragments are added to the lists of iovec writers by reference, so the
+// fragment must outlive the iovec list
+void dd_mpack_write_fragment(
+    mpack_writer_t *nonnull w, const dd_mpack_fragment *nonnull frag);
+
 #endif // DD_MSGPACK_HELPERS_H
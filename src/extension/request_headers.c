@@ -0,0 +1,217 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "request_headers.h"
+#include "configuration.h"
+#include "php_compat.h"
+#include "php_helpers.h"
+#include "string_helpers.h"
+#include <ctype.h>
+
+#define HTTP_PREFIX "HTTP_"
+#define DD_PREFIX_TAG_REQUEST_HEADER "http.request.headers."
+
+typedef struct _known_header {
+    zend_string *name;
+    zend_string *nullable tag_name;
+    unsigned flags;
+} known_header;
+
+// Both tables point to the same known_header entries. The first is keyed by
+// the $_SERVER key (e.g. HTTP_X_FORWARDED_FOR), so that the hash already
+// computed for the key in $_SERVER can be reused and nothing is allocated for
+// irrelevant headers; the second is keyed by the normalized name and is only
+// used for keys not in the canonical form
+static HashTable _known_by_key;
+static HashTable _known_by_name;
+
+static THREAD_LOCAL_ON_ZTS bool _collected;
+static THREAD_LOCAL_ON_ZTS dd_request_header *nullable _headers;
+static THREAD_LOCAL_ON_ZTS size_t _headers_count;
+
+static void _add_known_header(
+    const char *nonnull name, size_t name_len, unsigned flags);
+static void _known_header_dtor(zval *nonnull zv);
+static void _collect(void);
+
+void dd_request_headers_startup(void)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    zend_hash_init(&_known_by_key, 32, NULL, _known_header_dtor, 1);
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    zend_hash_init(&_known_by_name, 32, NULL, NULL, 1);
+
+#define ADD_HEADER(str, flags) _add_known_header(LSTRARG(str), flags)
+#define IP_TAG (DD_HEADER_TAG | DD_HEADER_IP_TAG)
+    ADD_HEADER("cookie", DD_HEADER_COOKIE);
+
+    ADD_HEADER("x-forwarded-for", IP_TAG);
+    ADD_HEADER("x-real-ip", IP_TAG);
+    ADD_HEADER("client-ip", IP_TAG);
+    ADD_HEADER("x-forwarded", IP_TAG);
+    ADD_HEADER("x-cluster-client-ip", IP_TAG);
+    ADD_HEADER("forwarded-for", IP_TAG);
+    ADD_HEADER("forwarded", IP_TAG);
+    ADD_HEADER("true-client-ip", IP_TAG);
+    ADD_HEADER("via", IP_TAG);
+
+    ADD_HEADER("x-client-ip", DD_HEADER_TAG);
+    ADD_HEADER("content-length", DD_HEADER_TAG);
+    ADD_HEADER("content-type", DD_HEADER_TAG);
+    ADD_HEADER("content-encoding", DD_HEADER_TAG);
+    ADD_HEADER("content-language", DD_HEADER_TAG);
+    ADD_HEADER("host", DD_HEADER_TAG);
+    ADD_HEADER("user-agent", DD_HEADER_TAG);
+    ADD_HEADER("accept", DD_HEADER_TAG);
+    ADD_HEADER("accept-encoding", DD_HEADER_TAG);
+    ADD_HEADER("accept-language", DD_HEADER_TAG);
+#undef IP_TAG
+#undef ADD_HEADER
+
+    // already lowercase
+    zend_string *extra;
+    ZEND_HASH_FOREACH_STR_KEY(get_global_DD_APPSEC_EXTRA_HEADERS(), extra)
+    {
+        if (extra && ZSTR_LEN(extra) > 0) {
+            _add_known_header(ZSTR_VAL(extra), ZSTR_LEN(extra), DD_HEADER_TAG);
+        }
+    }
+    ZEND_HASH_FOREACH_END();
+}
+
+void dd_request_headers_shutdown(void)
+{
+    zend_hash_destroy(&_known_by_name);
+    _known_by_name = (HashTable){0};
+
+    zend_hash_destroy(&_known_by_key);
+    _known_by_key = (HashTable){0};
+}
+
+void dd_request_headers_rshutdown(void)
+{
+    for (size_t i = 0; i < _headers_count; i++) {
+        dd_request_header *h = &_headers[i];
+        zend_string_release(h->name);
+        zval_ptr_dtor(&h->value);
+    }
+    if (_headers) {
+        efree(_headers);
+        _headers = NULL;
+    }
+    _headers_count = 0;
+    _collected = false;
+}
+
+dd_request_header *nullable dd_request_headers_get(size_t *nonnull count)
+{
+    if (!_collected) {
+        _collect();
+        _collected = true;
+    }
+
+    *count = _headers_count;
+    return _headers;
+}
+
+static zend_string *nonnull _init_interned_concat(const char *nonnull prefix,
+    size_t prefix_len, const char *nonnull str, size_t len)
+{
+    size_t total_len = prefix_len + len;
+    char *buf = pemalloc(total_len, 1);
+    memcpy(buf, prefix, prefix_len);
+    memcpy(buf + prefix_len, str, len);
+    zend_string *ret = zend_string_init_interned(buf, total_len, 1);
+    pefree(buf, 1);
+    return ret;
+}
+
+static void _add_known_header(
+    const char *nonnull name, size_t name_len, unsigned flags)
+{
+    bool is_tag = (flags & (DD_HEADER_TAG | DD_HEADER_IP_TAG)) != 0;
+
+    known_header *kh = zend_hash_str_find_ptr(&_known_by_name, name, name_len);
+    if (kh) {
+        // e.g. an extra header that is also a default one
+        if (is_tag && !kh->tag_name) {
+            kh->tag_name = _init_interned_concat(
+                LSTRARG(DD_PREFIX_TAG_REQUEST_HEADER), name, name_len);
+        }
+        kh->flags |= flags;
+        return;
+    }
+
+    kh = pemalloc(sizeof(*kh), 1);
+    kh->name = zend_string_init_interned(name, name_len, 1);
+    kh->tag_name = is_tag ? _init_interned_concat(
+                                LSTRARG(DD_PREFIX_TAG_REQUEST_HEADER), name,
+                                name_len)
+                          : NULL;
+    kh->flags = flags;
+
+    // the $_SERVER form: uppercase, with dashes turned into underscores
+    char *key_name = pemalloc(name_len, 1);
+    for (size_t i = 0; i < name_len; i++) {
+        char c = name[i];
+        key_name[i] = c == '-' ? '_' : (char)toupper((unsigned char)c);
+    }
+    zend_string *key =
+        _init_interned_concat(LSTRARG(HTTP_PREFIX), key_name, name_len);
+    pefree(key_name, 1);
+
+    zend_hash_add_new_ptr(&_known_by_key, key, kh);
+    zend_hash_add_new_ptr(&_known_by_name, kh->name, kh);
+}
+
+static void _known_header_dtor(zval *nonnull zv)
+{
+    // the strings are interned
+    pefree(Z_PTR_P(zv), 1);
+}
+
+static void _collect(void)
+{
+    zval *server =
+        dd_php_get_autoglobal(TRACK_VARS_SERVER, LSTRARG("_SERVER"));
+    if (!server || zend_hash_num_elements(Z_ARRVAL_P(server)) == 0) {
+        return;
+    }
+
+    _headers = safe_emalloc(zend_hash_num_elements(Z_ARRVAL_P(server)),
+        sizeof(*_headers), 0);
+
+    zend_string *key;
+    zval *val;
+    ZEND_HASH_FOREACH_STR_KEY_VAL(Z_ARRVAL_P(server), key, val)
+    {
+        if (!key || ZSTR_LEN(key) <= LSTRLEN(HTTP_PREFIX) ||
+            memcmp(ZSTR_VAL(key), LSTRARG(HTTP_PREFIX)) != 0) {
+            continue;
+        }
+
+        zend_string *name;
+        known_header *kh = zend_hash_find_ptr(&_known_by_key, key);
+        if (kh) {
+            name = kh->name; // interned, no need to copy
+        } else {
+            size_t name_len = ZSTR_LEN(key) - LSTRLEN(HTTP_PREFIX);
+            name = zend_string_alloc(name_len, 0);
+            dd_string_normalize_header2(
+                ZSTR_VAL(key) + LSTRLEN(HTTP_PREFIX), ZSTR_VAL(name), name_len);
+            // keys not in the canonical form, e.g. HTTP_X_Forwarded_For
+            kh = zend_hash_find_ptr(&_known_by_name, name);
+        }
+
+        dd_request_header *h = &_headers[_headers_count++];
+        h->name = name;
+        h->tag_name = kh ? kh->tag_name : NULL;
+        h->flags = kh ? kh->flags : 0;
+        // $_SERVER may be changed by the time the tags are added
+        ZVAL_DEREF(val);
+        ZVAL_COPY(&h->value, val);
+    }
+    ZEND_HASH_FOREACH_END();
+}
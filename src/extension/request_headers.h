@@ -0,0 +1,36 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include "attributes.h"
+#include <php.h>
+
+typedef enum _dd_request_header_flags {
+    // added as a span tag when all the ancillary tags are added
+    DD_HEADER_TAG = 1 << 0,
+    // added as a span tag even when only the basic tags are added
+    DD_HEADER_IP_TAG = 1 << 1,
+    // not sent to the helper as part of the headers
+    DD_HEADER_COOKIE = 1 << 2,
+} dd_request_header_flags;
+
+typedef struct _dd_request_header {
+    // normalized name, e.g. x-forwarded-for
+    zend_string *nonnull name;
+    // http.request.headers.<name>, set iff flags has a tag flag
+    zend_string *nullable tag_name;
+    zval value;
+    unsigned flags;
+} dd_request_header;
+
+void dd_request_headers_startup(void);
+void dd_request_headers_shutdown(void);
+void dd_request_headers_rshutdown(void);
+
+// The HTTP_* entries of $_SERVER, with normalized names. They're collected on
+// the first call in each request and shared by the request_init command and
+// the span tags code. The result is valid until the end of the request
+dd_request_header *nullable dd_request_headers_get(size_t *nonnull count);
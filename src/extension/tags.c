@@ -12,6 +12,7 @@
 #include "php_compat.h"
 #include "php_helpers.h"
 #include "php_objects.h"
+#include "request_headers.h"
 #include "string_helpers.h"
 #include "user_tracking.h"
 #include <SAPI.h>
@@ -32,7 +33,6 @@
 #define DD_TAG_HTTP_STATUS_CODE "http.status_code"
 #define DD_TAG_HTTP_URL "http.url"
 #define DD_TAG_NETWORK_CLIENT_IP "network.client.ip"
-#define DD_PREFIX_TAG_REQUEST_HEADER "http.request.headers."
 #define DD_TAG_HTTP_RH_CONTENT_LENGTH "http.response.headers.content-length"
 #define DD_TAG_HTTP_RH_CONTENT_TYPE "http.response.headers.content-type"
 #define DD_TAG_HTTP_RH_CONTENT_ENCODING "http.response.headers.content-encoding"
@@ -106,17 +106,12 @@ static zend_string *_track_zstr;
 static zend_string *_usr_exists_zstr;
 static zend_string *_uuid_zstr;
 static zend_string *_id_zstr;
-static HashTable _relevant_headers;
-static HashTable _relevant_ip_headers;
-static THREAD_LOCAL_ON_ZTS bool _appsec_json_frags_inited;
-static THREAD_LOCAL_ON_ZTS zend_llist _appsec_json_frags;
+// the value of _dd.appsec.json, built as the fragments are received
+static THREAD_LOCAL_ON_ZTS smart_str _appsec_json_data;
 static THREAD_LOCAL_ON_ZTS zend_string *nullable _event_user_id;
 static THREAD_LOCAL_ON_ZTS bool _blocked;
 static THREAD_LOCAL_ON_ZTS bool _force_keep;
 
-static void _init_relevant_headers(void);
-static zend_string *_concat_json_fragments(void);
-static void _zend_string_release_indirect(void *s);
 static void _add_basic_ancillary_tags(void);
 static bool _add_all_ancillary_tags(void);
 void _set_runtime_family(void);
@@ -211,85 +206,20 @@ void dd_tags_startup()
         zend_string_init_interned(LSTRARG("extended"), 1 /* permanent */);
     _mode_cstr = _mode_safe_cstr; // default
 
-    _init_relevant_headers();
-
     _register_functions();
 
     if (get_global_DD_APPSEC_TESTING()) {
         _register_test_functions();
     }
 }
-static void _init_relevant_headers()
-{
-    zend_hash_init(&_relevant_headers, 32, NULL, NULL, 1);
-    zend_hash_init(&_relevant_ip_headers, 32, NULL, NULL, 1);
-    zval nullzv;
-    ZVAL_NULL(&nullzv);
-#define ADD_RELEVANT_HEADER(str)                                               \
-    zend_hash_str_add_new(&_relevant_headers, str "", sizeof(str) - 1, &nullzv);
-#define ADD_RELEVANT_IP_HEADER(str)                                            \
-    zend_hash_str_add_new(                                                     \
-        &_relevant_ip_headers, str "", sizeof(str) - 1, &nullzv);
-
-    ADD_RELEVANT_IP_HEADER("x-forwarded-for");
-    ADD_RELEVANT_IP_HEADER("x-real-ip");
-    ADD_RELEVANT_IP_HEADER("client-ip");
-    ADD_RELEVANT_IP_HEADER("x-forwarded");
-    ADD_RELEVANT_IP_HEADER("x-cluster-client-ip");
-    ADD_RELEVANT_IP_HEADER("forwarded-for");
-    ADD_RELEVANT_IP_HEADER("forwarded");
-    ADD_RELEVANT_IP_HEADER("true-client-ip");
-    ADD_RELEVANT_IP_HEADER("via");
-
-    ADD_RELEVANT_HEADER("x-forwarded-for");
-    ADD_RELEVANT_HEADER("x-client-ip");
-    ADD_RELEVANT_HEADER("x-real-ip");
-    ADD_RELEVANT_HEADER("client-ip");
-    ADD_RELEVANT_HEADER("x-forwarded");
-    ADD_RELEVANT_HEADER("x-cluster-client-ip");
-    ADD_RELEVANT_HEADER("forwarded-for");
-    ADD_RELEVANT_HEADER("forwarded");
-    ADD_RELEVANT_HEADER("true-client-ip");
-    ADD_RELEVANT_HEADER("via");
-    ADD_RELEVANT_HEADER("content-length");
-    ADD_RELEVANT_HEADER("content-type");
-    ADD_RELEVANT_HEADER("content-encoding");
-    ADD_RELEVANT_HEADER("content-language");
-    ADD_RELEVANT_HEADER("host");
-    ADD_RELEVANT_HEADER("user-agent");
-    ADD_RELEVANT_HEADER("accept");
-    ADD_RELEVANT_HEADER("accept-encoding");
-    ADD_RELEVANT_HEADER("accept-language");
-
-#undef ADD_RELEVANT_HEADER
-
-    zend_hash_copy(
-        &_relevant_headers, get_global_DD_APPSEC_EXTRA_HEADERS(), NULL);
-}
-
-void dd_tags_shutdown()
-{
-    zend_hash_destroy(&_relevant_headers);
-    _relevant_headers = (HashTable){0};
-
-    zend_hash_destroy(&_relevant_ip_headers);
-    _relevant_ip_headers = (HashTable){0};
-}
 
 void dd_tags_rinit()
 {
-    bool init_list = false;
-    if (UNEXPECTED(!_appsec_json_frags_inited)) {
-        init_list = true;
-        _appsec_json_frags_inited = true;
-    } else if (UNEXPECTED(zend_llist_count(&_appsec_json_frags) > 0)) {
+    if (UNEXPECTED(_appsec_json_data.s != NULL)) {
+        // the request memory it was allocated on is gone by now
         mlog(dd_log_warning,
             "Previous request's appsec data tag fragments were not processed");
-        init_list = true;
-    }
-    if (init_list) {
-        zend_llist_init(&_appsec_json_frags, sizeof(zend_string *),
-            _zend_string_release_indirect, 0);
+        _appsec_json_data = (smart_str){0};
     }
 
     // Just in case...
@@ -298,9 +228,20 @@ void dd_tags_rinit()
     _force_keep = false;
 }
 
-void dd_tags_add_appsec_json_frag(zend_string *nonnull zstr)
+#define DD_DATA_TAG_BEFORE "{\"triggers\":["
+#define DD_DATA_TAG_AFTER "]}"
+
+void dd_tags_add_appsec_json_frag(const char *nonnull data, size_t len)
 {
-    zend_llist_add_element(&_appsec_json_frags, &zstr);
+    // fragments are comma-separated events, so they're appended as they are
+    if (_appsec_json_data.s == NULL) {
+        smart_str_alloc(&_appsec_json_data,
+            LSTRLEN(DD_DATA_TAG_BEFORE) + len + LSTRLEN(DD_DATA_TAG_AFTER), 0);
+        smart_str_appendl(&_appsec_json_data, LSTRARG(DD_DATA_TAG_BEFORE));
+    } else {
+        smart_str_appendc(&_appsec_json_data, ',');
+    }
+    smart_str_appendl(&_appsec_json_data, data, len);
 }
 
 void dd_tags_set_event_user_id(zend_string *nonnull zstr)
@@ -310,7 +251,7 @@ void dd_tags_set_event_user_id(zend_string *nonnull zstr)
 
 void dd_tags_rshutdown()
 {
-    zend_llist_clean(&_appsec_json_frags);
+    smart_str_free(&_appsec_json_data);
 
     if (_event_user_id) {
         zend_string_release(_event_user_id);
@@ -339,12 +280,15 @@ void dd_tags_add_tags()
         mlog(dd_log_debug, "Updated sampling priority to user_keep");
     }
 
-    if (zend_llist_count(&_appsec_json_frags) == 0) {
+    if (_appsec_json_data.s == NULL) {
         _add_basic_ancillary_tags();
         return;
     }
 
-    zend_string *tag_value = _concat_json_fragments();
+    smart_str_appendl(&_appsec_json_data, LSTRARG(DD_DATA_TAG_AFTER));
+    smart_str_0(&_appsec_json_data);
+    zend_string *tag_value = _appsec_json_data.s;
+    _appsec_json_data = (smart_str){0};
 
     zval tag_value_zv;
     ZVAL_STR(&tag_value_zv, tag_value);
@@ -382,52 +326,6 @@ void dd_tags_rshutdown_testing()
 
 void dd_tags_set_sampling_priority() { _force_keep = true; }
 
-static void _zend_string_release_indirect(void *s)
-{
-    zend_string_release(*(zend_string **)s);
-}
-
-static zend_string *_concat_json_fragments()
-{
-#define DD_DATA_TAG_BEFORE "{\"triggers\":["
-#define DD_DATA_TAG_AFTER "]}"
-
-    size_t count = zend_llist_count(&_appsec_json_frags);
-    size_t needed_len = LSTRLEN(DD_DATA_TAG_BEFORE) +
-                        LSTRLEN(DD_DATA_TAG_AFTER) +
-                        (count > 0 ? (count - 1) : 0) /* for commas */;
-
-    zend_llist_position pos;
-    for (zend_string **sp = zend_llist_get_first_ex(&_appsec_json_frags, &pos);
-         sp != NULL; sp = zend_llist_get_next_ex(&_appsec_json_frags, &pos)) {
-        zend_string *s = *sp;
-        needed_len += ZSTR_LEN(s);
-    }
-
-    zend_string *tag_value = zend_string_alloc(needed_len, 0);
-    char *buf = ZSTR_VAL(tag_value);
-    memcpy(buf, DD_DATA_TAG_BEFORE, LSTRLEN(DD_DATA_TAG_BEFORE));
-    buf += LSTRLEN(DD_DATA_TAG_BEFORE);
-
-    size_t i = 0;
-    for (zend_string **sp = zend_llist_get_first_ex(&_appsec_json_frags, &pos);
-         sp != NULL;
-         sp = zend_llist_get_next_ex(&_appsec_json_frags, &pos), i++) {
-        if (i != 0) {
-            *buf++ = ',';
-        }
-        zend_string *s = *sp;
-        size_t len = ZSTR_LEN(s);
-        memcpy(buf, ZSTR_VAL(s), len);
-        buf += len;
-    }
-    memcpy(buf, DD_DATA_TAG_AFTER, LSTRLEN(DD_DATA_TAG_AFTER));
-    buf += LSTRLEN(DD_DATA_TAG_AFTER);
-    *buf = '\0';
-
-    return tag_value;
-}
-
 static void _add_basic_tags_to_meta(zval *nonnull meta);
 static void _add_all_tags_to_meta(zval *nonnull meta);
 static void _dd_http_method(zend_array *meta_ht);
@@ -436,8 +334,7 @@ static void _dd_http_user_agent(zend_array *meta_ht, zval *_server);
 static void _dd_http_status_code(zend_array *meta_ht);
 static void _dd_http_network_client_ip(zend_array *meta_ht, zval *_server);
 static void _dd_http_client_ip(zend_array *meta_ht);
-static void _dd_request_headers(
-    zend_array *meta_ht, zval *_server, HashTable *relevant_headers);
+static void _dd_request_headers(zend_array *meta_ht, unsigned flag);
 static void _dd_response_headers(zend_array *meta_ht);
 static void _dd_event_user_id(zend_array *meta_ht);
 static void _dd_appsec_blocked(zend_array *meta_ht);
@@ -474,7 +371,7 @@ static void _add_basic_tags_to_meta(zval *nonnull meta)
     }
 
     _dd_http_client_ip(meta_ht);
-    _dd_request_headers(meta_ht, _server, &_relevant_ip_headers);
+    _dd_request_headers(meta_ht, DD_HEADER_IP_TAG);
 }
 
 static void _add_all_tags_to_meta(zval *nonnull meta)
@@ -491,7 +388,7 @@ static void _add_all_tags_to_meta(zval *nonnull meta)
     _dd_http_user_agent(meta_ht, _server);
     _dd_http_status_code(meta_ht);
     _dd_http_network_client_ip(meta_ht, _server);
-    _dd_request_headers(meta_ht, _server, &_relevant_headers);
+    _dd_request_headers(meta_ht, DD_HEADER_TAG);
     _dd_http_client_ip(meta_ht);
     _dd_response_headers(meta_ht);
     _dd_event_user_id(meta_ht);
@@ -649,56 +546,25 @@ static void _dd_http_client_ip(zend_array *meta_ht)
     }
 }
 
-static void _dd_request_headers(
-    zend_array *meta_ht, zval *_server, HashTable *relevant_headers)
+static void _dd_request_headers(zend_array *meta_ht, unsigned flag)
 {
-    // Pack headers
-    zend_string *key;
-    zval *val;
-    ZEND_HASH_FOREACH_STR_KEY_VAL(Z_ARRVAL_P(_server), key, val)
-    {
-        if (!key) {
-            continue;
-        }
-
-        if (Z_TYPE_P(val) != IS_STRING) {
+    size_t count;
+    dd_request_header *headers = dd_request_headers_get(&count);
+    for (size_t i = 0; i < count; i++) {
+        dd_request_header *h = &headers[i];
+        if (!(h->flags & flag) || Z_TYPE(h->value) != IS_STRING) {
             continue;
         }
 
-        if (ZSTR_LEN(key) <= LSTRLEN("HTTP_") ||
-            memcmp(ZSTR_VAL(key), LSTRARG("HTTP_")) != 0) {
-            continue;
-        }
-
-        size_t header_name_len = ZSTR_LEN(key) - LSTRLEN("HTTP_");
-        size_t tag_len =
-            LSTRLEN(DD_PREFIX_TAG_REQUEST_HEADER) + header_name_len;
-
-        zend_string *tag_name = zend_string_alloc(tag_len, 0);
-
-        char *tag_p = ZSTR_VAL(tag_name);
-        memcpy(tag_p, LSTRARG(DD_PREFIX_TAG_REQUEST_HEADER));
-        tag_p += LSTRLEN(DD_PREFIX_TAG_REQUEST_HEADER);
-
-        memcpy(tag_p, ZSTR_VAL(key) + LSTRLEN("HTTP_"), header_name_len);
-        tag_p[header_name_len] = '\0';
-        dd_string_normalize_header(tag_p, header_name_len);
-        if (!zend_hash_str_exists(relevant_headers, tag_p, header_name_len)) {
-            zend_string_efree(tag_name);
-            continue;
-        }
-
-        Z_TRY_ADDREF_P(val);
-        bool added = zend_hash_add(meta_ht, tag_name, val) != NULL;
+        Z_TRY_ADDREF(h->value);
+        bool added = zend_hash_add(meta_ht, h->tag_name, &h->value) != NULL;
         if (added) {
             mlog(dd_log_debug, "Adding request header tag '%s' -> '%s",
-                ZSTR_VAL(tag_name), ZSTR_VAL(Z_STR_P(val)));
+                ZSTR_VAL(h->tag_name), Z_STRVAL(h->value));
         } else {
-            zval_delref_p(val);
+            Z_TRY_DELREF(h->value);
         }
-        zend_string_release(tag_name);
     }
-    ZEND_HASH_FOREACH_END();
 }
 
 static zend_string *nullable _is_relevant_resp_header(
@@ -13,7 +13,6 @@
 #define DD_TAG_DATA_MAX_LEN (1024UL * 1024UL)
 
 void dd_tags_startup(void);
-void dd_tags_shutdown(void);
 void dd_tags_rinit(void);
 void dd_tags_rshutdown(void);
 void dd_tags_add_tags(void);
@@ -25,8 +24,8 @@ void dd_tags_set_sampling_priority();
 // Copies (or increases refcount) of zstr
 void dd_tags_set_event_user_id(zend_string *nonnull zstr);
 
-// does not increase the refcount on zstr
-void dd_tags_add_appsec_json_frag(zend_string *nonnull zstr);
+// copies the fragment, one or more comma-separated events
+void dd_tags_add_appsec_json_frag(const char *nonnull data, size_t len);
 
 bool dd_parse_automated_user_events_tracking(
     zai_str value, zval *nonnull decoded_value, bool persistent);
@@ -0,0 +1,25 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog (https://www.datadoghq.com/).
+// Copyright 2021 Datadog, Inc.
+#ifndef DD_TRACEPOINTS_H
+#define DD_TRACEPOINTS_H
+
+// USDT probes under the ddappsec provider, see src/helper/tracepoints.hpp
+// for the helper ones. They're compiled out unless DD_APPSEC_ENABLE_USDT is
+// set, in which case they're a nop until a tracer attaches to them.
+//
+//   command_exec_begin(name, name_len)
+//   command_exec_end(name, name_len, result)
+
+#ifdef DD_APPSEC_USDT
+#    include <sys/sdt.h>
+#    define DD_TRACEPOINT(name, ...) STAP_PROBEV(ddappsec, name, __VA_ARGS__)
+#else
+#    define DD_TRACEPOINT(name, ...)                                           \
+        do {                                                                   \
+        } while (0)
+#endif
+
+#endif // DD_TRACEPOINTS_H
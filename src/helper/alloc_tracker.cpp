@@ -0,0 +1,103 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "metrics.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+
+namespace {
+// Plain thread-local counters, so counting doesn't need any synchronisation
+// nor allocate itself. They're in the static TLS block, which malloc can use
+// at any time.
+__attribute__((tls_model("initial-exec"))) thread_local uint64_t
+    allocation_count = 0;
+__attribute__((tls_model("initial-exec"))) thread_local uint64_t
+    allocated_bytes = 0;
+} // namespace
+
+namespace dds::metrics {
+
+allocations thread_allocations() noexcept
+{
+    return {allocation_count, allocated_bytes};
+}
+
+} // namespace dds::metrics
+
+#ifdef DD_APPSEC_ALLOC_TRACKING
+
+#    ifndef __GLIBC__
+#        error "DD_APPSEC_ENABLE_ALLOC_TRACKING requires glibc"
+#    endif
+
+// The malloc family is replaced, rather than operator new, so that the
+// allocations of the C libraries (the msgpack zone, the ddwaf_object_*
+// functions, ...) are counted too. operator new gets its memory from malloc
+// or aligned_alloc, so it's counted as well. The replacements forward to the
+// glibc implementations, free is left alone.
+// NOLINTBEGIN
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t nmemb, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+}
+
+namespace {
+void *counted(void *ptr, std::size_t size) noexcept
+{
+    if (ptr != nullptr) {
+        allocation_count++;
+        allocated_bytes += size;
+    }
+    return ptr;
+}
+} // namespace
+
+extern "C" {
+void *malloc(std::size_t size) noexcept
+{
+    return counted(__libc_malloc(size), size);
+}
+
+void *calloc(std::size_t nmemb, std::size_t size) noexcept
+{
+    return counted(__libc_calloc(nmemb, size), nmemb * size);
+}
+
+void *realloc(void *ptr, std::size_t size) noexcept
+{
+    return counted(__libc_realloc(ptr, size), size);
+}
+
+void *memalign(std::size_t alignment, std::size_t size) noexcept
+{
+    return counted(__libc_memalign(alignment, size), size);
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) noexcept
+{
+    return counted(__libc_memalign(alignment, size), size);
+}
+
+int posix_memalign(
+    void **memptr, std::size_t alignment, std::size_t size) noexcept
+{
+    if (alignment % sizeof(void *) != 0 ||
+        (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void *ptr = counted(__libc_memalign(alignment, size), size);
+    if (ptr == nullptr) {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+}
+// NOLINTEND
+
+#endif
@@ -7,6 +7,7 @@
 #include "base64.h"
 #include "compression.hpp"
 #include "exception.hpp"
+#include "network/addresses.hpp"
 #include "network/broker.hpp"
 #include "network/proto.hpp"
 #include "std_logging.hpp"
@@ -15,6 +16,7 @@
 #include <stdexcept>
 #include <string>
 #include <thread>
+#include <vector>
 
 using namespace std::chrono_literals;
 
@@ -79,11 +81,15 @@ bool handle_message(client &client, const network::base_broker &broker,
         SPDLOG_DEBUG("Wait for one of these messages: {}", all_names.str());
     }
 
+    metrics::command_timings timings;
     bool send_error = false;
     bool result = true;
     try {
         auto msg = broker.recv(initial_timeout);
-        return maybe_exec_cmd_M<Ms...>(client, msg);
+        timings.set_command(msg.id);
+        result = maybe_exec_cmd_M<Ms...>(client, msg);
+        client.add_request_durations(timings.durations());
+        return result;
     } catch (const unexpected_command &e) {
         send_error = true;
         if (!ignore_unexpected_messages) {
@@ -137,6 +143,43 @@ bool handle_message(client &client, const network::base_broker &broker,
     return result;
 }
 
+// The data of request_exec is either a map of addresses or a batch of them,
+// gathered by the extension, which are published one after the other so
+// that all the values of an address are evaluated
+std::vector<parameter> split_batch(parameter &&data)
+{
+    std::vector<parameter> batch;
+    if (data.type() != parameter_type::array) {
+        batch.emplace_back(std::move(data));
+        return batch;
+    }
+
+    batch.reserve(data.size());
+    for (std::size_t i = 0; i < data.size(); i++) {
+        batch.emplace_back(std::move(data[i]));
+    }
+    return batch;
+}
+
+void merge_result(
+    std::optional<engine::result> &result, engine::result &&other)
+{
+    if (!result) {
+        result = std::move(other);
+        return;
+    }
+
+    result->events.insert(result->events.end(),
+        std::make_move_iterator(other.events.begin()),
+        std::make_move_iterator(other.events.end()));
+    result->schemas.merge(other.schemas);
+    result->force_keep = result->force_keep || other.force_keep;
+    if (other.type > result->type) {
+        result->type = other.type;
+        result->parameters = std::move(other.parameters);
+    }
+}
+
 } // namespace
 
 bool client::handle_command(const network::client_init::request &command)
@@ -192,6 +235,12 @@ bool client::handle_command(const network::client_init::request &command)
     response->errors = std::move(errors);
     response->meta = std::move(meta);
     response->metrics = std::move(metrics);
+    for (const auto &capability : command.capabilities) {
+        if (capability == network::capability_address_ids) {
+            response->capabilities.emplace_back(
+                network::capability_address_ids);
+        }
+    }
 
     try {
         if (!broker_->send(response)) {
@@ -240,6 +289,7 @@ bool client::handle_command(network::request_init::request &command)
 
     auto response = std::make_shared<network::request_init::response>();
     try {
+        context_->add_truncated_values(command.truncated_values);
         auto res = context_->publish(std::move(command.data));
         if (res) {
             switch (res->type) {
@@ -308,7 +358,17 @@ bool client::handle_command(network::request_exec::request &command)
 
     auto response = std::make_shared<network::request_exec::response>();
     try {
-        auto res = context_->publish(std::move(command.data));
+        context_->add_truncated_values(command.truncated_values);
+        std::optional<engine::result> res;
+        for (auto &data : split_batch(std::move(command.data))) {
+            if (auto data_res = context_->publish(std::move(data)); data_res) {
+                merge_result(res, std::move(*data_res));
+            }
+            // The rest of the batch couldn't change a blocking verdict
+            if (res && res->type != engine::action_type::record) {
+                break;
+            }
+        }
         if (res) {
             switch (res->type) {
             case engine::action_type::block:
@@ -431,7 +491,7 @@ bool client::handle_command(network::request_shutdown::request &command)
     SPDLOG_DEBUG("received command request_shutdown");
 
     // Free the context at the end of request shutdown
-    auto free_ctx = defer([this]() { this->context_.reset(); });
+    auto free_ctx = defer([this]() { this->release_context(); });
 
     auto response = std::make_shared<network::request_shutdown::response>();
 
@@ -449,6 +509,7 @@ bool client::handle_command(network::request_shutdown::request &command)
             }
         }
 
+        context_->add_truncated_values(command.truncated_values);
         auto res = context_->publish(std::move(command.data));
         if (res) {
             switch (res->type) {
@@ -486,6 +547,14 @@ bool client::handle_command(network::request_shutdown::request &command)
         }
 
         context_->get_meta_and_metrics(response->meta, response->metrics);
+
+        // The response isn't sent yet, so its send time is left out
+        auto durations = request_durations_;
+        if (auto *timings = metrics::command_timings::current();
+            timings != nullptr) {
+            metrics::accumulate(durations, timings->durations());
+        }
+        metrics::add_span_metrics(durations, response->metrics);
     } catch (const invalid_object &e) {
         // This error indicates some issue in either the communication with
         // the client, incompatible versions or malicious client.
@@ -510,6 +579,19 @@ bool client::handle_command(network::request_shutdown::request &command)
     return false;
 }
 
+void client::add_request_durations(const metrics::stage_durations &durations)
+{
+    if (context_) {
+        metrics::accumulate(request_durations_, durations);
+    }
+}
+
+void client::release_context()
+{
+    context_.reset();
+    request_durations_ = {};
+}
+
 bool client::run_client_init()
 {
     static constexpr auto client_init_timeout{std::chrono::milliseconds{500}};
@@ -539,6 +621,9 @@ void client::run(worker::queue_consumer &q)
         }
     }};
 
+    metrics::command_stats::instance().record(network::request_id::client_init,
+        metrics::stage::queue, std::chrono::steady_clock::now() - created_);
+
     if (q.running()) {
         if (!run_client_init()) {
             SPDLOG_DEBUG("Finished handling client (client_init failed)");
@@ -9,6 +9,7 @@
 
 #include "config.hpp"
 #include "engine.hpp"
+#include "metrics.hpp"
 #include "network/broker.hpp"
 #include "network/proto.hpp"
 #include "network/socket.hpp"
@@ -29,9 +30,11 @@ public:
     {}
 
     client(std::shared_ptr<service_manager> service_manager,
-        network::base_socket::ptr &&socket)
+        network::base_socket::ptr &&socket,
+        network::capture::ptr capture = nullptr)
         : service_manager_(std::move(service_manager)),
-          broker_(std::make_unique<network::broker>(std::move(socket)))
+          broker_(std::make_unique<network::broker>(
+              std::move(socket), std::move(capture)))
     {}
 
     ~client() = default;
@@ -62,16 +65,25 @@ public:
     void run(worker::queue_consumer &q);
     bool compute_client_status();
 
+    // Adds the stage durations of the last command to those of the request
+    // in flight, if any, reported on request_shutdown.
+    void add_request_durations(const metrics::stage_durations &durations);
+
 protected:
+    void release_context();
+
     bool initialised{false};
     uint32_t version{};
     network::base_broker::ptr broker_;
     std::shared_ptr<service_manager> service_manager_;
     std::shared_ptr<service> service_ = {nullptr};
     std::optional<engine::context> context_;
+    metrics::stage_durations request_durations_{};
     std::optional<bool> client_enabled_conf;
     bool request_enabled_ = {false};
     std::string runtime_id_;
+    std::chrono::steady_clock::time_point created_{
+        std::chrono::steady_clock::now()};
 };
 
 } // namespace dds
@@ -64,7 +64,8 @@ const std::unordered_map<std::string_view, std::string_view> config::defaults =
     {
         {"lock_path", "/tmp/ddappsec.lock"},
         {"socket_path", "/tmp/ddappsec.sock"}, {"log_level", "warn"},
-        {"runner_idle_timeout", "1440"} // minutes
+        {"runner_idle_timeout", "1440"}, // minutes
+        {"capture_max_size", "256"}      // MiB, only used with capture_path
 };
 
 } // namespace dds::config
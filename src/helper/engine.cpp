@@ -4,6 +4,8 @@
 // This product includes software developed at Datadog
 // (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <rapidjson/rapidjson.h>
 #include <set>
 #include <spdlog/fmt/ostr.h>
@@ -13,12 +15,39 @@
 #include "engine_settings.hpp"
 #include "exception.hpp"
 #include "json_helper.hpp"
+#include "metrics.hpp"
 #include "parameter_view.hpp"
 #include "std_logging.hpp"
 #include "subscriber/waf.hpp"
+#include "tags.hpp"
+#include "worker_pool.hpp"
 
 namespace dds {
 
+namespace {
+// Only runs subscribers, its workers are started as needed, up to
+// engine::max_parallel_workers
+worker::pool &subscriber_executor()
+{
+    // Never destroyed, as its workers may outlive any static
+    // NOLINTNEXTLINE(cppcoreguidelines-owning-memory)
+    static auto *executor = new worker::pool();
+    return *executor;
+}
+
+// Bytes of the keys and strings of the data, an estimate of the work of the
+// subscribers
+// NOLINTNEXTLINE(misc-no-recursion)
+std::size_t data_size(const parameter_view &data)
+{
+    std::size_t size = data.key().size() + data.length();
+    if (data.is_container()) {
+        for (const auto &child : data) { size += data_size(child); }
+    }
+    return size;
+}
+} // namespace
+
 void engine::subscribe(const subscriber::ptr &sub)
 {
     auto common = std::atomic_load(&common_);
@@ -53,13 +82,16 @@ void engine::update(engine_ruleset &ruleset,
     }
 
     std::shared_ptr<shared_state> const new_common(
-        new shared_state{std::move(new_subscribers), std::move(new_actions)});
+        new shared_state{std::move(new_subscribers), std::move(new_actions),
+            common_->generation + 1});
 
     std::atomic_store(&common_, new_common);
 }
 
 std::optional<engine::result> engine::context::publish(parameter &&param)
 {
+    const metrics::stage_timer timer{metrics::stage::publish};
+
     // Once the parameter reaches this function, it is guaranteed to be
     // owned by the engine.
     prev_published_params_.push_back(std::move(param));
@@ -73,17 +105,132 @@ std::optional<engine::result> engine::context::publish(parameter &&param)
         DD_STDLOG(DD_STDLOG_IG_DATA_PUSHED, entry.key());
     }
 
+    // A verdict can only be reused if it depends on nothing but the data
+    const bool use_cache =
+        cache_ && std::all_of(common_->subscribers.begin(),
+                      common_->subscribers.end(),
+                      [](const subscriber::ptr &sub) {
+                          return sub->is_stateless();
+                      });
+    if (use_cache) {
+        cache_key_ = cache_->key(cache_key_, common_->generation, data);
+        if (cache_->contains(cache_key_)) {
+            unseen_params_++;
+            cache_hits_++;
+            return std::nullopt;
+        }
+    }
+
     std::vector<std::string> event_data;
     std::unordered_set<std::string> event_actions;
     std::map<std::string, std::string> schemas;
 
+    // The subscribers need all the data of the request, so they first get
+    // what they skipped thanks to the cache
+    bool complete = true;
+    for (auto i = prev_published_params_.size() - 1 - unseen_params_;
+         i < prev_published_params_.size() - 1; i++) {
+        parameter_view unseen(prev_published_params_[i]);
+        complete =
+            run_subscribers(unseen, event_data, event_actions, schemas) &&
+            complete;
+    }
+    unseen_params_ = 0;
+
+    complete = run_subscribers(data, event_data, event_actions, schemas) &&
+               complete;
+
+    if (event_actions.empty() && event_data.empty()) {
+        // Finding nothing only means something if the subscribers didn't
+        // fail, time out or run out of budget
+        if (use_cache && complete && schemas.empty() &&
+            !(budget_ && budget_->exhausted)) {
+            cache_->insert(cache_key_);
+        }
+        return std::nullopt;
+    }
+
+    dds::engine::result res{
+        action_type::record, {}, std::move(event_data), std::move(schemas)};
+    // The extension can only handle one action, so we pick the strongest
+    if (const auto *action = strongest_action(event_actions);
+        action != nullptr) {
+        res.type = action->type;
+        res.parameters = action->parameters;
+    }
+
+    res.force_keep = limiter_.allow();
+
+    return res;
+}
+
+const engine::action *engine::context::strongest_action(
+    const std::unordered_set<std::string> &ids) const
+{
+    const action *strongest = nullptr;
+    const std::string *strongest_id = nullptr;
+    for (const auto &id : ids) {
+        auto it = common_->actions.find(id);
+        if (it == common_->actions.end()) {
+            continue;
+        }
+
+        // Between actions of the same type, the first by id, so that the
+        // choice doesn't depend on the order of the set
+        const auto &candidate = it->second;
+        if (strongest == nullptr || candidate.type > strongest->type ||
+            (candidate.type == strongest->type && id < *strongest_id)) {
+            strongest = &candidate;
+            strongest_id = &id;
+        }
+    }
+    return strongest;
+}
+
+engine::context::~context()
+{
+    for (auto &[subscriber, listener] : listeners_) {
+        subscriber->recycle(std::move(listener));
+    }
+}
+
+subscriber::listener::ptr &engine::context::get_listener(
+    const subscriber::ptr &sub)
+{
+    // A linear search, there are only a few subscribers
+    for (auto &[subscriber, listener] : listeners_) {
+        if (subscriber == sub) {
+            return listener;
+        }
+    }
+    return listeners_.emplace_back(sub, sub->get_listener()).second;
+}
+
+bool engine::context::run_subscribers(parameter_view &data,
+    std::vector<std::string> &event_data,
+    std::unordered_set<std::string> &event_actions,
+    std::map<std::string, std::string> &schemas)
+{
+    if (parallel_min_size_ > 0 && common_->subscribers.size() > 1 &&
+        data_size(data) >= parallel_min_size_) {
+        return run_subscribers_parallel(
+            data, event_data, event_actions, schemas);
+    }
+
+    bool complete = true;
     for (auto &sub : common_->subscribers) {
-        auto it = listeners_.find(sub);
-        if (it == listeners_.end()) {
-            it = listeners_.emplace(sub, sub->get_listener()).first;
+        // Nothing the remaining subscribers could find would override a
+        // block, so they're spared the work
+        if (const auto *action = strongest_action(event_actions);
+            action != nullptr && action->type == action_type::block) {
+            SPDLOG_DEBUG("Request blocked, skipping subscriber {}",
+                sub->get_name());
+            continue;
         }
+
+        auto &listener = get_listener(sub);
         try {
-            auto event = it->second->call(data);
+            auto event = listener->call(data, budget_ ? &*budget_ : nullptr);
             if (event) {
                 event_data.insert(event_data.end(),
                     std::make_move_iterator(event->data.begin()),
@@ -93,41 +240,145 @@ std::optional<engine::result> engine::context::publish(parameter &&param)
             }
         } catch (std::exception &e) {
             SPDLOG_ERROR("subscriber failed: {}", e.what());
+            complete = false;
         }
     }
+    return complete;
+}
 
-    if (event_actions.empty() && event_data.empty()) {
-        return std::nullopt;
+bool engine::context::run_subscribers_parallel(parameter_view &data,
+    std::vector<std::string> &event_data,
+    std::unordered_set<std::string> &event_actions,
+    std::map<std::string, std::string> &schemas)
+{
+    struct run {
+        subscriber::listener::ptr listener;
+        std::optional<subscriber::time_budget> budget;
+        std::optional<subscriber::event> event;
+        bool failed{false};
+        metrics::stage_durations durations{};
+        metrics::stage_allocations allocs{};
+    };
+
+    const auto &subscribers = common_->subscribers;
+    std::vector<run> runs(subscribers.size());
+    for (std::size_t i = 0; i < subscribers.size(); i++) {
+        // The listeners are looked up here, as that may add to listeners_
+        runs[i].listener = get_listener(subscribers[i]);
+        runs[i].budget = budget_;
     }
 
-    dds::engine::result res{
-        action_type::record, {}, std::move(event_data), std::move(schemas)};
-    // Currently the only action the extension can perform is block
-    if (!event_actions.empty()) {
-        // The extension can only handle one action, so we pick the first one
-        // available in the list of actions.
-        for (const auto &action_str : event_actions) {
-            auto it = common_->actions.find(action_str);
-            if (it != common_->actions.end()) {
-                res.type = it->second.type;
-                res.parameters = it->second.parameters;
-                break;
+    auto execute = [&data](run &r) {
+        // Workers handle no command, so the stages measured by the subscriber
+        // are kept here and recorded on the calling thread after the runs
+        const metrics::command_timings timings;
+        try {
+            r.event =
+                r.listener->call(data, r.budget ? &*r.budget : nullptr);
+        } catch (const std::exception &e) {
+            SPDLOG_ERROR("subscriber failed: {}", e.what());
+            r.failed = true;
+        } catch (...) {
+            SPDLOG_ERROR("subscriber failed: unknown reason");
+            r.failed = true;
+        }
+        r.durations = timings.durations();
+        r.allocs = timings.allocs();
+    };
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::size_t pending = 0;
+
+    // This thread runs the first subscriber, and any other for which no
+    // worker is available
+    for (std::size_t i = 1; i < runs.size(); i++) {
+        {
+            const std::lock_guard<std::mutex> lock{mtx};
+            pending++;
+        }
+
+        const bool launched = subscriber_executor().launch(
+            [&, i](worker::queue_consumer & /*q*/) {
+                execute(runs[i]);
+                // Notified with the lock held, as the waiting thread is free
+                // to go as soon as it's released
+                const std::lock_guard<std::mutex> lock{mtx};
+                pending--;
+                cv.notify_one();
+            },
+            max_parallel_workers);
+        if (!launched) {
+            {
+                const std::lock_guard<std::mutex> lock{mtx};
+                pending--;
             }
+            execute(runs[i]);
         }
     }
+    execute(runs[0]);
 
-    res.force_keep = limiter_.allow();
+    {
+        std::unique_lock<std::mutex> lock{mtx};
+        cv.wait(lock, [&pending] { return pending == 0; });
+    }
 
-    return res;
+    bool complete = true;
+    auto remaining = budget_ ? budget_->remaining : std::chrono::microseconds{};
+    unsigned skipped = 0;
+    for (auto &r : runs) {
+        complete = complete && !r.failed;
+        for (std::size_t i = 0; i < metrics::stage_count; i++) {
+            metrics::record(
+                static_cast<metrics::stage>(i), r.durations[i], r.allocs[i]);
+        }
+        if (budget_) {
+            // The runs happened at the same time, so the request took as long
+            // as the longest of them
+            remaining = std::min(remaining, r.budget->remaining);
+            budget_->exhausted = budget_->exhausted || r.budget->exhausted;
+            skipped += r.budget->skipped - budget_->skipped;
+        }
+        if (r.event) {
+            event_data.insert(event_data.end(),
+                std::make_move_iterator(r.event->data.begin()),
+                std::make_move_iterator(r.event->data.end()));
+            event_actions.merge(r.event->actions);
+            schemas.merge(r.event->schemas);
+        }
+    }
+    if (budget_) {
+        budget_->remaining = remaining;
+        budget_->skipped += skipped;
+    }
+
+    return complete;
 }
 
 void engine::context::get_meta_and_metrics(
     std::map<std::string, std::string> &meta,
     std::map<std::string_view, double> &metrics)
 {
+    // Even if the cache spared all the runs, the tags of the listeners, such
+    // as the rules version, are still expected
+    if (cache_hits_ > 0) {
+        for (const auto &sub : common_->subscribers) { get_listener(sub); }
+        metrics[tag::waf_cache_hits] = cache_hits_;
+    }
+
     for (const auto &[subscriber, listener] : listeners_) {
         listener->get_meta_and_metrics(meta, metrics);
     }
+
+    if (truncated_values_ > 0) {
+        metrics[tag::waf_truncated_values] =
+            static_cast<double>(truncated_values_);
+    }
+
+    if (budget_ && budget_->exhausted) {
+        metrics[tag::waf_request_budget_exhausted] = 1.0;
+        metrics[tag::waf_skipped_runs] = budget_->skipped;
+    }
 }
 
 template <typename T> engine::action parse_action(T &action_object)
@@ -242,8 +493,16 @@ engine::ptr engine::from_settings(const dds::engine_settings &eng_settings,
     auto ruleset = engine_ruleset::from_path(rules_path);
     auto actions =
         parse_actions(ruleset.get_document(), engine::default_actions);
-    std::shared_ptr engine_ptr{
-        engine::create(eng_settings.trace_rate_limit, std::move(actions))};
+    verdict_cache::ptr cache;
+    if (eng_settings.verdict_cache_size > 0) {
+        cache = std::make_shared<verdict_cache>(eng_settings.verdict_cache_size,
+            std::chrono::seconds{eng_settings.verdict_cache_ttl_s});
+    }
+
+    std::shared_ptr engine_ptr{engine::create(eng_settings.trace_rate_limit,
+        std::move(actions),
+        std::chrono::microseconds{eng_settings.waf_request_budget_us},
+        std::move(cache), eng_settings.parallel_subscribers_min_size)};
 
     try {
         SPDLOG_DEBUG("Will load WAF rules from {}", rules_path);
@@ -11,6 +11,9 @@
 #include "parameter.hpp"
 #include "rate_limit.hpp"
 #include "subscriber/base.hpp"
+#include "verdict_cache.hpp"
+#include <boost/container/small_vector.hpp>
+#include <chrono>
 #include <map>
 #include <memory>
 #include <rapidjson/document.h>
@@ -37,6 +40,7 @@ public:
     using subscription_map =
         std::map<std::string_view, std::vector<subscriber::ptr>>;
 
+    // Ordered by priority, block being the strongest
     enum class action_type : uint8_t { record = 1, redirect = 2, block = 3 };
 
     struct action {
@@ -49,6 +53,7 @@ public:
     struct result {
         action_type type;
         std::unordered_map<std::string, std::string> parameters;
+        // JSON fragments of comma-separated events, see subscriber::event
         std::vector<std::string> events;
         std::map<std::string, std::string> schemas;
         bool force_keep;
@@ -58,6 +63,8 @@ protected:
     struct shared_state {
         std::vector<subscriber::ptr> subscribers;
         action_map actions;
+        // changes on every update, so verdicts aren't reused across rules
+        uint64_t generation{0};
     };
 
 public:
@@ -68,24 +75,75 @@ public:
     public:
         explicit context(engine &engine)
             : common_(std::atomic_load(&engine.common_)),
-              limiter_(engine.limiter_)
-        {}
+              limiter_(engine.limiter_), cache_(engine.verdict_cache_),
+              parallel_min_size_(engine.parallel_min_size_)
+        {
+            if (engine.request_budget_.count() > 0) {
+                budget_ = subscriber::time_budget{engine.request_budget_};
+            }
+        }
         context(const context &) = delete;
         context &operator=(const context &) = delete;
         context(context &&) = delete;
         context &operator=(context &&) = delete;
-        ~context() = default;
+        // Gives the listeners back to their subscribers
+        ~context();
 
         std::optional<result> publish(parameter &&param);
+        // Values of the request the decoder cut short to the limits of the
+        // WAF, reported as a metric
+        void add_truncated_values(uint64_t count) noexcept
+        {
+            truncated_values_ += count;
+        }
         // NOLINTNEXTLINE(google-runtime-references)
         void get_meta_and_metrics(std::map<std::string, std::string> &meta,
             std::map<std::string_view, double> &metrics);
 
     protected:
-        std::vector<parameter> prev_published_params_;
-        std::map<subscriber::ptr, subscriber::listener::ptr> listeners_;
+        // Requests usually have a single subscriber and a few publishes, so
+        // that these fit within the context itself
+        static constexpr std::size_t inline_listeners = 2;
+        static constexpr std::size_t inline_params = 4;
+
+        subscriber::listener::ptr &get_listener(const subscriber::ptr &sub);
+
+        // The known action of highest priority among the given ones, if any
+        [[nodiscard]] const action *strongest_action(
+            const std::unordered_set<std::string> &ids) const;
+
+        // Returns whether no subscriber failed
+        // NOLINTNEXTLINE(google-runtime-references)
+        bool run_subscribers(parameter_view &data,
+            std::vector<std::string> &event_data,
+            std::unordered_set<std::string> &event_actions,
+            std::map<std::string, std::string> &schemas);
+        // Runs all the subscribers at once, on the executor shared by the
+        // engines, each with a copy of the time budget
+        // NOLINTNEXTLINE(google-runtime-references)
+        bool run_subscribers_parallel(parameter_view &data,
+            std::vector<std::string> &event_data,
+            std::unordered_set<std::string> &event_actions,
+            std::map<std::string, std::string> &schemas);
+
+        boost::container::small_vector<parameter, inline_params>
+            prev_published_params_;
+        boost::container::small_vector<
+            std::pair<subscriber::ptr, subscriber::listener::ptr>,
+            inline_listeners>
+            listeners_;
         std::shared_ptr<shared_state> common_;
         rate_limiter &limiter_;
+        std::optional<subscriber::time_budget> budget_;
+        verdict_cache::ptr cache_;
+        // key of all the data published so far
+        uint64_t cache_key_{0};
+        // the last published parameters, found on the cache, which the
+        // subscribers haven't seen
+        std::size_t unseen_params_{0};
+        unsigned cache_hits_{0};
+        uint64_t truncated_values_{0};
+        std::size_t parallel_min_size_;
     };
 
     engine(const engine &) = delete;
@@ -100,15 +158,23 @@ public:
 
     static auto create(
         uint32_t trace_rate_limit = engine_settings::default_trace_rate_limit,
-        action_map actions = default_actions)
+        action_map actions = default_actions,
+        std::chrono::microseconds request_budget = {},
+        verdict_cache::ptr cache = {}, std::size_t parallel_min_size = 0)
     {
         return std::shared_ptr<engine>(
-            new engine(trace_rate_limit, std::move(actions)));
+            new engine(trace_rate_limit, std::move(actions), request_budget,
+                std::move(cache), parallel_min_size));
     }
 
     context get_context() { return context{*this}; }
     void subscribe(const subscriber::ptr &sub);
 
+    [[nodiscard]] const verdict_cache::ptr &get_verdict_cache() const
+    {
+        return verdict_cache_;
+    }
+
     // Update is not thread-safe, although only one remote config client should
     // be able to update it so in practice it should not be a problem.
     virtual void update(engine_ruleset &ruleset,
@@ -125,15 +191,28 @@ public:
         const T &doc, const action_map &default_actions);
 
 protected:
-    explicit engine(uint32_t trace_rate_limit, action_map &&actions = {})
+    explicit engine(uint32_t trace_rate_limit, action_map &&actions = {},
+        std::chrono::microseconds request_budget = {},
+        verdict_cache::ptr cache = {}, std::size_t parallel_min_size = 0)
         : limiter_(trace_rate_limit),
-          common_(new shared_state{{}, std::move(actions)})
+          common_(new shared_state{{}, std::move(actions)}),
+          request_budget_(request_budget), verdict_cache_(std::move(cache)),
+          parallel_min_size_(parallel_min_size)
     {}
 
     static const action_map default_actions;
+    // Threads of the executor running subscribers in parallel, shared by all
+    // the engines
+    static constexpr unsigned max_parallel_workers = 4;
 
     std::shared_ptr<shared_state> common_;
     rate_limiter limiter_;
+    // Total time the subscribers can spend on a request, no limit if zero
+    std::chrono::microseconds request_budget_;
+    // Verdicts of the requests on which nothing was found, if enabled
+    verdict_cache::ptr verdict_cache_;
+    // Bytes of data from which the subscribers run in parallel, never if zero
+    std::size_t parallel_min_size_;
 };
 
 } // namespace dds
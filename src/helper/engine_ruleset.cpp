@@ -46,8 +46,15 @@ void engine_ruleset::add_default_processors_and_scanners()
 
 engine_ruleset engine_ruleset::from_path(std::string_view path)
 {
-    auto ruleset = read_file(path);
-    auto engine = engine_ruleset{ruleset};
+    auto source = std::make_unique<std::string>(read_file(path));
+
+    rapidjson::Document doc;
+    rapidjson::ParseResult const result = doc.ParseInsitu(source->data());
+    if ((result == nullptr) || !doc.IsObject()) {
+        throw parsing_error("invalid json rule");
+    }
+
+    auto engine = engine_ruleset{std::move(doc), std::move(source)};
     engine.add_default_processors_and_scanners();
 
     return engine;
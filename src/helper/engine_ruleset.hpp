@@ -5,7 +5,9 @@
 // (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
 #pragma once
 
+#include <memory>
 #include <rapidjson/document.h>
+#include <string>
 #include <string_view>
 
 namespace dds {
@@ -25,6 +27,8 @@ public:
         return doc_[key.data()];
     }
 
+    // The file is parsed in place, so the strings of the document point into
+    // its contents rather than being copies
     static engine_ruleset from_path(std::string_view path);
 
     // Used only for testing
@@ -36,6 +40,12 @@ public:
     void add_default_processors_and_scanners();
 
 protected:
+    engine_ruleset(rapidjson::Document doc, std::unique_ptr<std::string> source)
+        : source_(std::move(source)), doc_(std::move(doc))
+    {}
+
+    // What the document was parsed from, if it was parsed in place
+    std::unique_ptr<std::string> source_;
     rapidjson::Document doc_;
 };
 
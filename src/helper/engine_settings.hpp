@@ -31,9 +31,19 @@ struct schema_extraction_settings {
 struct engine_settings {
     static constexpr int default_waf_timeout_us = 10000;
     static constexpr int default_trace_rate_limit = 100;
+    static constexpr int default_verdict_cache_ttl_s = 60;
 
     std::string rules_file;
     std::uint64_t waf_timeout_us = default_waf_timeout_us;
+    // total for all the WAF runs of a request, no limit if zero
+    std::uint64_t waf_request_budget_us = 0;
+    // entries of the cache of WAF verdicts, disabled if zero
+    std::uint32_t verdict_cache_size = 0;
+    std::uint32_t verdict_cache_ttl_s = default_verdict_cache_ttl_s;
+    // bytes of data from which the subscribers run in parallel, never if zero
+    std::uint32_t parallel_subscribers_min_size = 0;
+    // compile apart the rules restricted to some routes, see waf::instance
+    bool waf_route_scoping = false;
     std::uint32_t trace_rate_limit = default_trace_rate_limit;
     std::string obfuscator_key_regex;
     std::string obfuscator_value_regex;
@@ -52,13 +62,21 @@ struct engine_settings {
         return rules_file;
     }
 
-    MSGPACK_DEFINE_MAP(rules_file, waf_timeout_us, trace_rate_limit,
-        obfuscator_key_regex, obfuscator_value_regex, schema_extraction);
+    MSGPACK_DEFINE_MAP(rules_file, waf_timeout_us, waf_request_budget_us,
+        verdict_cache_size, verdict_cache_ttl_s, parallel_subscribers_min_size,
+        waf_route_scoping, trace_rate_limit, obfuscator_key_regex,
+        obfuscator_value_regex, schema_extraction);
 
     bool operator==(const engine_settings &oth) const noexcept
     {
         return rules_file == oth.rules_file &&
                waf_timeout_us == oth.waf_timeout_us &&
+               waf_request_budget_us == oth.waf_request_budget_us &&
+               verdict_cache_size == oth.verdict_cache_size &&
+               verdict_cache_ttl_s == oth.verdict_cache_ttl_s &&
+               parallel_subscribers_min_size ==
+                   oth.parallel_subscribers_min_size &&
+               waf_route_scoping == oth.waf_route_scoping &&
                trace_rate_limit == oth.trace_rate_limit &&
                obfuscator_key_regex == oth.obfuscator_key_regex &&
                obfuscator_value_regex == oth.obfuscator_value_regex &&
@@ -71,6 +89,12 @@ struct engine_settings {
     {
         return os << "{rules_file=" << c.rules_file
                   << ", waf_timeout_us=" << c.waf_timeout_us
+                  << ", waf_request_budget_us=" << c.waf_request_budget_us
+                  << ", verdict_cache_size=" << c.verdict_cache_size
+                  << ", verdict_cache_ttl_s=" << c.verdict_cache_ttl_s
+                  << ", parallel_subscribers_min_size="
+                  << c.parallel_subscribers_min_size
+                  << ", waf_route_scoping=" << c.waf_route_scoping
                   << ", trace_rate_limit=" << c.trace_rate_limit
                   << ", obfuscator_key_regex=" << c.obfuscator_key_regex
                   << ", obfuscator_value_regex=" << c.obfuscator_value_regex
@@ -83,9 +107,12 @@ struct engine_settings {
     struct settings_hash {
         std::size_t operator()(const engine_settings &s) const noexcept
         {
-            return hash(s.rules_file, s.waf_timeout_us, s.trace_rate_limit,
-                s.obfuscator_key_regex, s.obfuscator_value_regex,
-                s.schema_extraction.enabled, s.schema_extraction.sample_rate);
+            return hash(s.rules_file, s.waf_timeout_us, s.waf_request_budget_us,
+                s.verdict_cache_size, s.verdict_cache_ttl_s,
+                s.parallel_subscribers_min_size, s.waf_route_scoping,
+                s.trace_rate_limit, s.obfuscator_key_regex,
+                s.obfuscator_value_regex, s.schema_extraction.enabled,
+                s.schema_extraction.sample_rate);
         }
     };
 };
@@ -10,9 +10,13 @@
 #include "std_logging.hpp"
 #include <base64.h>
 #include <ddwaf.h>
+#include <cstring>
 #include <rapidjson/error/en.h>
+#include <rapidjson/memorystream.h>
 #include <rapidjson/prettywriter.h>
+#include <rapidjson/reader.h>
 #include <string_view>
+#include <vector>
 
 using namespace std::literals;
 
@@ -20,46 +24,45 @@ namespace dds {
 
 namespace {
 
-// TODO: Limit recursion
-template <typename T>
+// Writes the JSON of pv straight from the parameter, without a DOM. Throws
+// on invalid parameters and on containers nested deeper than max_json_depth.
+template <typename Writer>
 // NOLINTNEXTLINE(misc-no-recursion, google-runtime-references)
-void parameter_to_json_helper(const parameter_view &pv, T &output,
-    rapidjson::Document::AllocatorType &alloc)
+void write_json(const parameter_view &pv, Writer &writer, std::size_t depth)
 {
     switch (pv.type()) {
     case parameter_type::int64:
-        output.SetInt64(int64_t(pv));
+        writer.Int64(int64_t(pv));
         break;
     case parameter_type::uint64:
-        output.SetUint64(uint64_t(pv));
+        writer.Uint64(uint64_t(pv));
         break;
     case parameter_type::string: {
         auto sv = std::string_view(pv);
-        output.SetString(sv.data(), sv.size(), alloc);
+        writer.String(sv.data(), static_cast<rapidjson::SizeType>(sv.size()));
     } break;
     case parameter_type::boolean:
-        output.SetBool(bool(pv));
+        writer.Bool(bool(pv));
         break;
     case parameter_type::map:
-        output.SetObject();
+        if (depth >= max_json_depth) {
+            throw std::runtime_error("parameter nested too deeply");
+        }
+        writer.StartObject();
         for (const auto &v : pv) {
-            rapidjson::Value key;
-            rapidjson::Value value;
-            parameter_to_json_helper(v, value, alloc);
-
             std::string_view const sv = v.key();
-            key.SetString(sv.data(), sv.size(), alloc);
-
-            output.AddMember(key, value, alloc);
+            writer.Key(sv.data(), static_cast<rapidjson::SizeType>(sv.size()));
+            write_json(v, writer, depth + 1);
         }
+        writer.EndObject();
         break;
     case parameter_type::array:
-        output.SetArray();
-        for (const auto &v : pv) {
-            rapidjson::Value value;
-            parameter_to_json_helper(v, value, alloc);
-            output.PushBack(value, alloc);
+        if (depth >= max_json_depth) {
+            throw std::runtime_error("parameter nested too deeply");
         }
+        writer.StartArray();
+        for (const auto &v : pv) { write_json(v, writer, depth + 1); }
+        writer.EndArray();
         break;
     case parameter_type::invalid:
         throw std::runtime_error("invalid parameter in structure");
@@ -68,99 +71,224 @@ void parameter_to_json_helper(const parameter_view &pv, T &output,
 
 } // namespace
 
-std::string parameter_to_json(const parameter_view &pv)
+bool parameter_to_json(const parameter_view &pv, string_buffer &buffer)
 {
+    auto &output = buffer.get_string_ref();
+    auto initial_size = output.size();
     try {
-        rapidjson::Document document;
-        rapidjson::Document::AllocatorType &alloc = document.GetAllocator();
+        rapidjson::Writer<string_buffer> writer(buffer);
+        write_json(pv, writer, 0);
+        return true;
+    } catch (const std::exception &e) {
+        SPDLOG_WARN("Failed to convert WAF parameter to JSON: {}", e.what());
+    }
 
-        parameter_to_json_helper(pv, document, alloc);
+    output.resize(initial_size);
+    return false;
+}
 
-        dds::string_buffer buffer;
-        rapidjson::Writer<decltype(buffer)> writer(buffer);
+std::string parameter_to_json(const parameter_view &pv)
+{
+    dds::string_buffer buffer;
+    if (!parameter_to_json(pv, buffer)) {
+        return {};
+    }
+    return std::move(buffer.get_string_ref());
+}
 
-        if (document.Accept(writer)) {
-            return std::move(buffer.get_string_ref());
+std::string parameter_elements_to_json(const parameter_view &pv)
+{
+    if (!pv.is_container()) {
+        SPDLOG_WARN("Failed to convert WAF parameter to JSON: not a container");
+        return {};
+    }
+
+    dds::string_buffer buffer;
+    try {
+        // The elements are written one after the other into the same buffer,
+        // the writer being reset after each of them
+        rapidjson::Writer<string_buffer> writer(buffer);
+        for (const auto &v : pv) {
+            if (buffer.GetSize() > 0) {
+                buffer.Put(',');
+            }
+            writer.Reset(buffer);
+            write_json(v, writer, 1);
         }
     } catch (const std::exception &e) {
         SPDLOG_WARN("Failed to convert WAF parameter to JSON: {}", e.what());
+        return {};
     }
 
-    return {};
+    return std::move(buffer.get_string_ref());
 }
 
-// TODO: we should limit the recursion
-template <typename T,
-    typename = std::enable_if_t<std::disjunction_v<
-        std::is_same<rapidjson::Document, std::remove_cv_t<std::decay_t<T>>>,
-        std::is_same<rapidjson::Value, std::remove_cv_t<std::decay_t<T>>>>>>
-// NOLINTNEXTLINE(misc-no-recursion)
-void json_to_object(ddwaf_object *object, T &doc)
-{
-    switch (doc.GetType()) {
-    case rapidjson::kFalseType:
-        ddwaf_object_stringl(object, "false", sizeof("false") - 1);
-        break;
-    case rapidjson::kTrueType:
-        ddwaf_object_stringl(object, "true", sizeof("true") - 1);
-        break;
-    case rapidjson::kObjectType: {
-        ddwaf_object_map(object);
-        for (auto &kv : doc.GetObject()) {
-            ddwaf_object element;
-            json_to_object(&element, kv.value);
-
-            std::string_view const key = kv.name.GetString();
-            ddwaf_object_map_addl(object, key.data(), key.length(), &element);
+namespace {
+
+// Builds a ddwaf_object tree from SAX events, as they come from the parser or
+// from an existing document. The elements of the open containers are kept on
+// a stack, so each container is allocated once, with its final size, when
+// it ends, rather than grown element by element.
+class object_builder
+    : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, object_builder> {
+public:
+    object_builder() = default;
+    object_builder(const object_builder &) = delete;
+    object_builder &operator=(const object_builder &) = delete;
+    object_builder(object_builder &&) = delete;
+    object_builder &operator=(object_builder &&) = delete;
+
+    ~object_builder()
+    {
+        // Only left over if the input was invalid
+        for (auto &object : elements_) { ddwaf_object_free(&object); }
+        // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+        for (auto &key : keys_) { free(const_cast<char *>(key.data())); }
+    }
+
+    // Booleans and numbers are converted to strings, null and floating
+    // point numbers aren't supported
+    bool Null() { return push(ddwaf_object_invalid(&scratch_)); }
+    bool Bool(bool b)
+    {
+        return b ? push(ddwaf_object_stringl(
+                       &scratch_, "true", sizeof("true") - 1))
+                 : push(ddwaf_object_stringl(
+                       &scratch_, "false", sizeof("false") - 1));
+    }
+    bool Int(int i) { return Int64(i); }
+    bool Uint(unsigned u) { return Uint64(u); }
+    bool Int64(int64_t i)
+    {
+        return push(ddwaf_object_string_from_signed(&scratch_, i));
+    }
+    bool Uint64(uint64_t u)
+    {
+        return push(ddwaf_object_string_from_unsigned(&scratch_, u));
+    }
+    bool Double(double /*d*/) { return Null(); }
+    bool String(const char *str, rapidjson::SizeType length, bool /*copy*/)
+    {
+        return push(ddwaf_object_stringl(&scratch_, str, length));
+    }
+
+    bool StartObject() { return start(true); }
+    bool Key(const char *str, rapidjson::SizeType length, bool /*copy*/)
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+        auto *key = static_cast<char *>(malloc(length + 1));
+        if (key == nullptr) {
+            return false;
         }
-        break;
+        memcpy(key, str, length);
+        key[length] = '\0';
+        keys_.emplace_back(key, length);
+        return true;
+    }
+    bool EndObject(rapidjson::SizeType /*count*/)
+    {
+        return end(ddwaf_object_map(&scratch_));
+    }
+
+    bool StartArray() { return start(false); }
+    bool EndArray(rapidjson::SizeType /*count*/)
+    {
+        return end(ddwaf_object_array(&scratch_));
     }
-    case rapidjson::kArrayType: {
-        ddwaf_object_array(object);
-        for (auto &v : doc.GetArray()) {
-            ddwaf_object element;
-            json_to_object(&element, v);
 
-            ddwaf_object_array_add(object, &element);
+    dds::parameter get()
+    {
+        if (elements_.size() != 1 || !containers_.empty()) {
+            throw parsing_error("invalid json object");
         }
-        break;
+        dds::parameter result{elements_.back()};
+        elements_.clear();
+        return result;
     }
-    case rapidjson::kStringType: {
-        std::string_view const str = doc.GetString();
-        ddwaf_object_stringl(object, str.data(), str.size());
-        break;
+
+protected:
+    struct container {
+        std::size_t first_element;
+        bool is_map;
+    };
+
+    bool start(bool is_map)
+    {
+        containers_.push_back({elements_.size(), is_map});
+        return true;
     }
-    case rapidjson::kNumberType: {
-        if (doc.IsInt64()) {
-            ddwaf_object_string_from_signed(object, doc.GetInt64());
-        } else if (doc.IsUint64()) {
-            ddwaf_object_string_from_unsigned(object, doc.GetUint64());
+
+    bool end(ddwaf_object *object)
+    {
+        auto first = containers_.back().first_element;
+        containers_.pop_back();
+
+        auto size = elements_.size() - first;
+        if (size > 0) {
+            // NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+            auto *array = static_cast<ddwaf_object *>(
+                malloc(size * sizeof(ddwaf_object)));
+            if (array == nullptr) {
+                return false;
+            }
+            memcpy(array, &elements_[first], size * sizeof(ddwaf_object));
+            elements_.resize(first);
+
+            object->array = array;
+            object->nbEntries = size;
         }
-        break;
+        return push(object);
     }
-    case rapidjson::kNullType:
-    default:
-        ddwaf_object_invalid(object);
-        break;
+
+    bool push(ddwaf_object *object)
+    {
+        if (object == nullptr) {
+            return false;
+        }
+
+        // The key of a map element comes before its value, and the value of
+        // a container, after the keys of its own elements
+        if (!containers_.empty() && containers_.back().is_map) {
+            auto key = keys_.back();
+            keys_.pop_back();
+            object->parameterName = key.data();
+            object->parameterNameLength = key.size();
+        } else {
+            object->parameterName = nullptr;
+            object->parameterNameLength = 0;
+        }
+        elements_.push_back(*object);
+        return true;
     }
-}
+
+    ddwaf_object scratch_{};
+    std::vector<ddwaf_object> elements_;
+    std::vector<container> containers_;
+    std::vector<std::string_view> keys_;
+};
+
+} // namespace
 
 dds::parameter json_to_parameter(const rapidjson::Document &doc)
 {
-    dds::parameter obj;
-    json_to_object(obj, doc);
-    return obj;
+    object_builder builder;
+    if (!doc.Accept(builder)) {
+        throw parsing_error("invalid json object");
+    }
+    return builder.get();
 }
 
 dds::parameter json_to_parameter(std::string_view json)
 {
-    rapidjson::Document doc;
-    rapidjson::ParseResult const result = doc.Parse(json.data());
+    object_builder builder;
+    rapidjson::Reader reader;
+    rapidjson::MemoryStream stream{json.data(), json.size()};
+    rapidjson::ParseResult const result = reader.Parse(stream, builder);
     if (result.IsError()) {
         throw parsing_error("invalid json object: "s +
                             rapidjson::GetParseError_En(result.Code()));
     }
-    return json_to_parameter(doc);
+    return builder.get();
 }
 
 std::optional<rapidjson::Value::ConstMemberIterator>
@@ -49,7 +49,20 @@ protected:
     std::string buffer_;
 };
 
+// Parameters nested deeper than this can't be converted to JSON. API security
+// schemas take up to two levels per level of their input, which the WAF
+// doesn't inspect beyond 20 levels, so nothing the WAF outputs is this deep.
+constexpr std::size_t max_json_depth = 64;
+
+// Appends the JSON of the parameter to the buffer, so that a buffer can be
+// reused across calls. On failure false is returned and the buffer is left
+// as it was.
+// NOLINTNEXTLINE(google-runtime-references)
+bool parameter_to_json(const dds::parameter_view &pv, string_buffer &buffer);
 std::string parameter_to_json(const dds::parameter_view &pv);
+// Writes the elements of a container as comma-separated JSON values, so that
+// they can be spliced as they are into a JSON array
+std::string parameter_elements_to_json(const dds::parameter_view &pv);
 dds::parameter json_to_parameter(const rapidjson::Document &doc);
 dds::parameter json_to_parameter(std::string_view json);
 
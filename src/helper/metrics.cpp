@@ -0,0 +1,221 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "metrics.hpp"
+#include "tags.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <utility>
+
+namespace dds::metrics {
+
+namespace {
+
+constexpr std::array<std::string_view, stage_count> stage_names{
+    "queue", "recv", "decode", "publish", "format", "send"};
+
+constexpr std::array<std::string_view, command_count> command_names{"unknown",
+    "client_init", "request_init", "request_exec", "request_shutdown",
+    "config_sync"};
+
+constexpr std::size_t index(network::request_id command)
+{
+    return static_cast<std::size_t>(command);
+}
+
+constexpr std::size_t index(stage s) { return static_cast<std::size_t>(s); }
+
+std::size_t bucket_for(uint64_t us)
+{
+    std::size_t bucket = 0;
+    while (us > 0 && bucket < histogram::bucket_count - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+} // namespace
+
+std::string_view to_string(stage s) { return stage_names.at(index(s)); }
+
+std::string_view to_string(network::request_id command)
+{
+    return command_names.at(index(command));
+}
+
+uint64_t histogram::snapshot::percentile(double p) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    auto rank = static_cast<uint64_t>(std::ceil(p / 100.0 * count));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucket_count; i++) {
+        seen += buckets.at(i);
+        if (seen >= rank) {
+            return std::min<uint64_t>(uint64_t{1} << i, max_us);
+        }
+    }
+    return max_us;
+}
+
+void histogram::record(std::chrono::nanoseconds duration) noexcept
+{
+    auto us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(duration)
+            .count());
+
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(us, std::memory_order_relaxed);
+    buckets_[bucket_for(us)].fetch_add(1, std::memory_order_relaxed);
+
+    auto max = max_us_.load(std::memory_order_relaxed);
+    while (us > max && !max_us_.compare_exchange_weak(
+                           max, us, std::memory_order_relaxed)) {}
+}
+
+histogram::snapshot histogram::get() const noexcept
+{
+    snapshot s;
+    s.count = count_.load(std::memory_order_relaxed);
+    s.sum_us = sum_us_.load(std::memory_order_relaxed);
+    s.max_us = max_us_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < bucket_count; i++) {
+        s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+void histogram::reset() noexcept
+{
+    count_.store(0, std::memory_order_relaxed);
+    sum_us_.store(0, std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+    for (auto &bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+command_stats &command_stats::instance()
+{
+    static command_stats stats;
+    return stats;
+}
+
+void command_stats::record(network::request_id command, stage s,
+    std::chrono::nanoseconds duration) noexcept
+{
+    histograms_[index(command)][index(s)].record(duration);
+}
+
+void command_stats::record(network::request_id command,
+    const stage_durations &durations, const stage_allocations &allocs) noexcept
+{
+    for (std::size_t i = 0; i < stage_count; i++) {
+        // The queue is measured per connection rather than per command
+        if (i == index(stage::queue)) {
+            continue;
+        }
+        histograms_[index(command)][i].record(durations[i]);
+
+        auto &totals = allocations_[index(command)][i];
+        totals.count.fetch_add(allocs[i].count, std::memory_order_relaxed);
+        totals.bytes.fetch_add(allocs[i].bytes, std::memory_order_relaxed);
+    }
+}
+
+const histogram &command_stats::get(network::request_id command, stage s) const
+{
+    return histograms_.at(index(command)).at(index(s));
+}
+
+allocations command_stats::get_allocations(
+    network::request_id command, stage s) const
+{
+    const auto &totals = allocations_.at(index(command)).at(index(s));
+    return {totals.count.load(std::memory_order_relaxed),
+        totals.bytes.load(std::memory_order_relaxed)};
+}
+
+std::string command_stats::summary() const
+{
+    std::ostringstream ss;
+    for (std::size_t c = 0; c < command_count; c++) {
+        for (std::size_t s = 0; s < stage_count; s++) {
+            auto snapshot = histograms_.at(c).at(s).get();
+            if (snapshot.count == 0) {
+                continue;
+            }
+            // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+            ss << command_names.at(c) << '.' << stage_names.at(s)
+               << ": count=" << snapshot.count
+               << " avg=" << snapshot.sum_us / snapshot.count
+               << "us p50=" << snapshot.percentile(50)
+               << "us p99=" << snapshot.percentile(99)
+               << "us max=" << snapshot.max_us << "us";
+            // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+            if (alloc_tracking) {
+                const auto &totals = allocations_.at(c).at(s);
+                ss << " allocs="
+                   << totals.count.load(std::memory_order_relaxed) /
+                          snapshot.count
+                   << " alloc_bytes="
+                   << totals.bytes.load(std::memory_order_relaxed) /
+                          snapshot.count;
+            }
+            ss << '\n';
+        }
+    }
+    return ss.str();
+}
+
+void command_stats::reset() noexcept
+{
+    for (auto &command : histograms_) {
+        for (auto &h : command) { h.reset(); }
+    }
+    for (auto &command : allocations_) {
+        for (auto &totals : command) {
+            totals.count.store(0, std::memory_order_relaxed);
+            totals.bytes.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+thread_local command_timings *command_timings::current_ = nullptr;
+
+command_timings::~command_timings()
+{
+    current_ = previous_;
+    if (command_ != network::request_id::unknown) {
+        command_stats::instance().record(command_, durations_, allocations_);
+    }
+}
+
+void add_span_metrics(const stage_durations &durations,
+    std::map<std::string_view, double> &metrics)
+{
+    static constexpr std::array<std::pair<stage, std::string_view>, 5> tags{{
+        {stage::recv, tag::helper_recv_duration},
+        {stage::decode, tag::helper_decode_duration},
+        {stage::publish, tag::helper_publish_duration},
+        {stage::format, tag::helper_format_duration},
+        {stage::send, tag::helper_send_duration},
+    }};
+
+    for (const auto &[s, name] : tags) {
+        metrics[name] =
+            std::chrono::duration<double, std::micro>(durations.at(index(s)))
+                .count();
+    }
+}
+
+} // namespace dds::metrics
@@ -0,0 +1,229 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include "network/proto.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace dds::metrics {
+
+// Stages a command goes through in the helper
+enum class stage : unsigned {
+    // from the connection being accepted until a worker starts handling it,
+    // only recorded for client_init
+    queue,
+    // reading the message body once its header has arrived
+    recv,
+    // unpacking the message body into a request
+    decode,
+    // running the subscribers on the data, format included
+    publish,
+    // converting the WAF events and schemas to JSON
+    format,
+    // serializing and writing the response
+    send,
+};
+
+constexpr std::size_t stage_count = static_cast<std::size_t>(stage::send) + 1;
+constexpr std::size_t command_count =
+    static_cast<std::size_t>(network::request_id::config_sync) + 1;
+
+std::string_view to_string(stage s);
+std::string_view to_string(network::request_id command);
+
+using stage_durations = std::array<std::chrono::nanoseconds, stage_count>;
+
+inline void accumulate(stage_durations &to, const stage_durations &from)
+{
+    for (std::size_t i = 0; i < stage_count; i++) { to[i] += from[i]; }
+}
+
+// Whether the helper was built with DD_APPSEC_ENABLE_ALLOC_TRACKING, which
+// replaces malloc and its variants to count the allocations of each thread,
+// including those of operator new and of the C libraries. Otherwise, all the
+// allocation counts are zero.
+#ifdef DD_APPSEC_ALLOC_TRACKING
+constexpr bool alloc_tracking = true;
+#else
+constexpr bool alloc_tracking = false;
+#endif
+
+struct allocations {
+    uint64_t count{0};
+    uint64_t bytes{0};
+
+    allocations operator-(const allocations &other) const noexcept
+    {
+        return {count - other.count, bytes - other.bytes};
+    }
+
+    allocations &operator+=(const allocations &other) noexcept
+    {
+        count += other.count;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+using stage_allocations = std::array<allocations, stage_count>;
+
+// The allocations done so far by the calling thread
+allocations thread_allocations() noexcept;
+
+// Lock-free histogram of durations with power of two buckets in
+// microseconds: bucket 0 holds durations under 1us, bucket i those in
+// [2^(i-1), 2^i) and the last one everything above.
+class histogram {
+public:
+    static constexpr std::size_t bucket_count = 28;
+
+    struct snapshot {
+        uint64_t count{0};
+        uint64_t sum_us{0};
+        uint64_t max_us{0};
+        std::array<uint64_t, bucket_count> buckets{};
+
+        // Upper bound of the bucket containing the given percentile
+        [[nodiscard]] uint64_t percentile(double p) const;
+    };
+
+    void record(std::chrono::nanoseconds duration) noexcept;
+    [[nodiscard]] snapshot get() const noexcept;
+    void reset() noexcept;
+
+protected:
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_us_{0};
+    std::atomic<uint64_t> max_us_{0};
+    std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+};
+
+// Process-wide histograms, per command and stage
+class command_stats {
+public:
+    static command_stats &instance();
+
+    void record(network::request_id command, stage s,
+        std::chrono::nanoseconds duration) noexcept;
+    void record(network::request_id command, const stage_durations &durations,
+        const stage_allocations &allocs = {}) noexcept;
+
+    [[nodiscard]] const histogram &get(
+        network::request_id command, stage s) const;
+    // Total of the allocations of all the recorded samples
+    [[nodiscard]] allocations get_allocations(
+        network::request_id command, stage s) const;
+
+    // One line per command and stage with samples, for logging
+    [[nodiscard]] std::string summary() const;
+
+    void reset() noexcept;
+
+protected:
+    struct allocation_totals {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+    };
+
+    std::array<std::array<histogram, stage_count>, command_count> histograms_;
+    std::array<std::array<allocation_totals, stage_count>, command_count>
+        allocations_;
+};
+
+// Durations and allocations of the stages of the command being handled.
+// While an instance is alive, the stages measured on its thread are added to
+// it and, once the command is known, they're recorded on command_stats on
+// destruction.
+class command_timings {
+public:
+    command_timings() noexcept : previous_(current_) { current_ = this; }
+    ~command_timings();
+    command_timings(const command_timings &) = delete;
+    command_timings &operator=(const command_timings &) = delete;
+    command_timings(command_timings &&) = delete;
+    command_timings &operator=(command_timings &&) = delete;
+
+    void set_command(network::request_id command) noexcept
+    {
+        command_ = command;
+    }
+
+    void add(stage s, std::chrono::nanoseconds duration,
+        const allocations &allocs = {}) noexcept
+    {
+        durations_[static_cast<std::size_t>(s)] += duration;
+        allocations_[static_cast<std::size_t>(s)] += allocs;
+    }
+
+    [[nodiscard]] const stage_durations &durations() const noexcept
+    {
+        return durations_;
+    }
+
+    [[nodiscard]] const stage_allocations &allocs() const noexcept
+    {
+        return allocations_;
+    }
+
+    [[nodiscard]] static command_timings *current() noexcept
+    {
+        return current_;
+    }
+
+protected:
+    network::request_id command_{network::request_id::unknown};
+    stage_durations durations_{};
+    stage_allocations allocations_{};
+    command_timings *previous_;
+    static thread_local command_timings *current_;
+};
+
+// Adds a duration to the command being handled on this thread, if any
+inline void record(stage s, std::chrono::nanoseconds duration,
+    const allocations &allocs = {}) noexcept
+{
+    auto *timings = command_timings::current();
+    if (timings != nullptr) {
+        timings->add(s, duration, allocs);
+    }
+}
+
+// Measures a stage, and the allocations done by it, until it goes out of
+// scope
+class stage_timer {
+public:
+    explicit stage_timer(stage s) noexcept
+        : stage_(s), start_(std::chrono::steady_clock::now()),
+          start_allocs_(thread_allocations())
+    {}
+    ~stage_timer()
+    {
+        record(stage_, std::chrono::steady_clock::now() - start_,
+            thread_allocations() - start_allocs_);
+    }
+    stage_timer(const stage_timer &) = delete;
+    stage_timer &operator=(const stage_timer &) = delete;
+    stage_timer(stage_timer &&) = delete;
+    stage_timer &operator=(stage_timer &&) = delete;
+
+protected:
+    stage stage_;
+    std::chrono::steady_clock::time_point start_;
+    allocations start_allocs_;
+};
+
+// Adds the durations of a request, in microseconds, to the span metrics
+void add_span_metrics(const stage_durations &durations,
+    // NOLINTNEXTLINE(google-runtime-references)
+    std::map<std::string_view, double> &metrics);
+
+} // namespace dds::metrics
@@ -20,7 +20,7 @@ using namespace std::chrono_literals;
 
 namespace dds::network::local {
 
-acceptor::acceptor(const std::string_view &sv)
+acceptor::acceptor(const std::string_view &sv, mode_t mode)
     : sock_(::socket(AF_UNIX, SOCK_STREAM, 0))
 {
     if (sock_ == -1) {
@@ -44,7 +44,7 @@ acceptor::acceptor(const std::string_view &sv)
         throw std::system_error(errno, std::generic_category());
     }
 
-    ::chmod(sv.data(), 0777); // NOLINT
+    ::chmod(sv.data(), mode); // NOLINT
     static constexpr int backlog = 50;
     if (::listen(sock_, backlog) == -1) {
         throw std::system_error(errno, std::generic_category());
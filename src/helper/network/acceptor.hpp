@@ -8,6 +8,7 @@
 #include "socket.hpp"
 #include <chrono>
 #include <string_view>
+#include <sys/types.h>
 
 namespace dds::network {
 
@@ -31,7 +32,9 @@ namespace local {
 class acceptor : public base_acceptor {
 public:
     explicit acceptor(int fd) : sock_{fd} {};
-    explicit acceptor(const std::string_view &sv);
+    // The socket file is given the mode, by default any local user can
+    // connect to it
+    explicit acceptor(const std::string_view &sv, mode_t mode = 0777);
     acceptor(const acceptor &) = delete;
     acceptor &operator=(const acceptor &) = delete;
 
@@ -0,0 +1,47 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace dds::network {
+
+// Clients which negotiated this capability on client_init can send the
+// well-known addresses below as integers, rather than strings, on the top
+// level of the request_init, request_exec and request_shutdown maps.
+constexpr std::string_view capability_address_ids = "address_ids";
+
+// The index of each address is its id. The ids are part of the protocol and
+// must match those in the extension (addresses.h); new addresses must be
+// appended at the end.
+constexpr std::array<std::string_view, 13> known_addresses = {
+    "server.request.query",
+    "server.request.method",
+    "server.request.cookies",
+    "server.request.uri.raw",
+    "server.request.headers.no_cookies",
+    "server.request.body",
+    "server.request.body.filenames",
+    "server.request.body.files_field_names",
+    "server.request.path_params",
+    "http.client_ip",
+    "server.request.body.raw",
+    "server.response.status",
+    "server.response.headers.no_cookies",
+};
+
+constexpr std::optional<std::string_view> address_from_id(uint64_t id)
+{
+    if (id >= known_addresses.size()) {
+        return std::nullopt;
+    }
+    return known_addresses[id]; // NOLINT
+}
+
+} // namespace dds::network
@@ -5,12 +5,13 @@
 // (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
 #include "broker.hpp"
 #include "../exception.hpp"
+#include "../metrics.hpp"
+#include "../tracepoints.hpp"
 #include "proto.hpp"
 #include <chrono>
 #include <iostream>
 #include <msgpack.hpp>
 #include <spdlog/spdlog.h>
-#include <sstream>
 #include <stdexcept>
 
 namespace {
@@ -40,15 +41,18 @@ request broker::recv(std::chrono::milliseconds initial_timeout) const
             "Not enough data for header:" + std::to_string(res) + " bytes");
     }
 
+    // The time waiting for the header is the client's, not ours
+    auto recv_start = std::chrono::steady_clock::now();
+
+    static constexpr auto timeout_msg_body{std::chrono::milliseconds{300}};
+    socket_->set_recv_timeout(timeout_msg_body);
+
     static msgpack::unpack_limit const limits(max_array_size, max_map_size,
         max_string_length, max_binary_size, max_extension_size, max_depth);
 
     msgpack::unpacker u(&default_reference_func, MSGPACK_NULLPTR,
         MSGPACK_UNPACKER_INIT_BUFFER_SIZE, limits); // NOLINT
 
-    static constexpr auto timeout_msg_body{std::chrono::milliseconds{300}};
-    socket_->set_recv_timeout(timeout_msg_body);
-
     if (h.size >= max_msg_body_size) {
         auto res = socket_->discard(h.size);
         if (res < h.size) {
@@ -71,12 +75,30 @@ request broker::recv(std::chrono::milliseconds initial_timeout) const
     }
     u.buffer_consumed(h.size);
 
+    DD_TRACEPOINT(msg_recv, h.size);
+
+    auto decode_start = std::chrono::steady_clock::now();
+    auto decode_start_allocs = metrics::thread_allocations();
+    metrics::record(metrics::stage::recv, decode_start - recv_start);
+
     msgpack::object_handle oh;
     if (!u.next(oh)) {
         throw bad_cast("Invalid msgpack message");
     }
+    auto decode_duration = std::chrono::steady_clock::now() - decode_start;
+    auto decode_allocs = metrics::thread_allocations() - decode_start_allocs;
+
+    if (capture_) {
+        capture_->record(connection_id_, oh.get());
+    }
+
+    // The capture is left out of the decode time
+    const metrics::stage_timer timer{metrics::stage::decode};
+    metrics::record(metrics::stage::decode, decode_duration, decode_allocs);
 
-    return oh.get().as<network::request>();
+    auto request = oh.get().as<network::request>();
+    DD_TRACEPOINT(msg_decoded, static_cast<unsigned>(request.id));
+    return request;
 }
 
 bool broker::send(
@@ -86,6 +108,8 @@ bool broker::send(
         return false;
     }
 
+    const metrics::stage_timer timer{metrics::stage::send};
+
     std::vector<
         msgpack::type::tuple<std::string_view, std::shared_ptr<base_response>>>
         tuples;
@@ -94,9 +118,9 @@ bool broker::send(
         tuples.emplace_back(message->get_type(), message);
     }
 
-    std::stringstream ss;
-    msgpack::pack(ss, tuples);
-    const std::string &buffer = ss.str();
+    // Packed straight into the buffer which is sent, the events included
+    msgpack::sbuffer buffer;
+    msgpack::pack(buffer, tuples);
 
     // TODO: Add check to ensure buffer.size() fits in uint32_t
     header_t h = {"dds", (uint32_t)buffer.size()};
@@ -108,7 +132,8 @@ bool broker::send(
         return false;
     }
 
-    res = socket_->send(buffer.c_str(), buffer.size());
+    res = socket_->send(buffer.data(), buffer.size());
+    DD_TRACEPOINT(msg_sent, buffer.size(), res == buffer.size());
 
     return res == buffer.size();
 }
@@ -5,6 +5,7 @@
 // (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
 #pragma once
 
+#include "capture.hpp"
 #include "proto.hpp"
 #include "socket.hpp"
 #include <chrono>
@@ -32,18 +33,24 @@ public:
 
 class broker : public base_broker {
 public:
-    // msgpack limits
-    static constexpr std::size_t max_array_size = 256;
-    static constexpr std::size_t max_map_size = 256;
-    static constexpr std::size_t max_string_length = 4096;
+    // other limits
+    static constexpr std::size_t max_msg_body_size = 65536;
+
+    // msgpack limits, containers and strings are only bounded by the size of
+    // the body, larger values are truncated to the WAF limits on conversion
+    static constexpr std::size_t max_array_size = max_msg_body_size;
+    static constexpr std::size_t max_map_size = max_msg_body_size;
+    static constexpr std::size_t max_string_length = max_msg_body_size;
     static constexpr std::size_t max_binary_size = 0;
     static constexpr std::size_t max_extension_size = 0;
     static constexpr std::size_t max_depth = 32;
 
-    // other limits
-    static constexpr std::size_t max_msg_body_size = 65536;
-
     explicit broker(base_socket::ptr &&socket) : socket_(std::move(socket)) {}
+    // Messages received are also recorded on the given capture, if any
+    broker(base_socket::ptr &&socket, capture::ptr capture)
+        : socket_(std::move(socket)), capture_(std::move(capture)),
+          connection_id_(capture_ ? capture_->new_connection() : 0)
+    {}
     broker(const broker &) = delete;
     broker &operator=(const broker &) = delete;
     broker(broker &&) = default;
@@ -60,6 +67,8 @@ public:
 
 protected:
     base_socket::ptr socket_;
+    capture::ptr capture_;
+    uint32_t connection_id_{0};
 };
 
 } // namespace dds::network
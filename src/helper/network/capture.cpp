@@ -0,0 +1,297 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "capture.hpp"
+#include "addresses.hpp"
+#include "proto.hpp"
+#include <algorithm>
+#include <array>
+#include <regex>
+#include <spdlog/spdlog.h>
+#include <stdexcept>
+
+using namespace std::chrono_literals;
+
+namespace dds::network {
+
+namespace {
+
+using packer_t = msgpack::packer<msgpack::sbuffer>;
+
+constexpr std::string_view client_ip_address{"http.client_ip"};
+constexpr std::string_view cookies_address{"server.request.cookies"};
+constexpr std::string_view request_headers_address{
+    "server.request.headers.no_cookies"};
+constexpr std::string_view response_headers_address{
+    "server.response.headers.no_cookies"};
+constexpr std::string_view uri_raw_address{"server.request.uri.raw"};
+// TEST-NET-1, see RFC 5737
+constexpr std::string_view masked_client_ip{"192.0.2.1"};
+
+constexpr std::array<std::string_view, 7> sensitive_headers{"authorization",
+    "proxy-authorization", "cookie", "set-cookie", "x-api-key",
+    "x-auth-token", "x-csrf-token"};
+
+// The default obfuscator key regex of the extension, without the (?i) flag
+// which std::regex doesn't support
+constexpr std::string_view sensitive_key_pattern{
+    "(?:p(?:ass)?w(?:or)?d|pass(?:_?phrase)?|secret|(?:api_?|private_?|"
+    "public_?)key)|token|consumer_?(?:id|key|secret)|sign(?:ed|ature)|bearer|"
+    "authorization"};
+
+constexpr auto flush_interval = 1s;
+
+enum class mask { strings, sensitive_keys, sensitive_headers };
+
+void pack_masked_string(packer_t &pk, uint32_t size)
+{
+    static constexpr std::size_t chunk_size = 64;
+    static const std::string chunk(chunk_size, 'x');
+
+    pk.pack_str(size);
+    while (size > 0) {
+        auto len = std::min<uint32_t>(size, chunk_size);
+        pk.pack_str_body(chunk.data(), len);
+        size -= len;
+    }
+}
+
+bool is_sensitive_key(std::string_view name)
+{
+    static const std::regex regex{sensitive_key_pattern.begin(),
+        sensitive_key_pattern.end(),
+        std::regex::ECMAScript | std::regex::icase | std::regex::optimize};
+    return std::regex_search(name.begin(), name.end(), regex);
+}
+
+bool is_sensitive_key(const msgpack::object &key)
+{
+    if (key.type != msgpack::type::STR) {
+        return false;
+    }
+    std::string_view name{key.via.str.ptr, key.via.str.size};
+    return is_sensitive_key(name);
+}
+
+bool is_sensitive_header(const msgpack::object &key)
+{
+    if (key.type != msgpack::type::STR) {
+        return false;
+    }
+    std::string_view name{key.via.str.ptr, key.via.str.size};
+    return std::find(sensitive_headers.begin(), sensitive_headers.end(),
+               name) != sensitive_headers.end();
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void pack_masked(packer_t &pk, const msgpack::object &o, mask m)
+{
+    switch (o.type) {
+    case msgpack::type::STR:
+        if (m == mask::strings) {
+            pack_masked_string(pk, o.via.str.size);
+        } else {
+            pk.pack(o);
+        }
+        break;
+    case msgpack::type::ARRAY: {
+        const msgpack::object_array &array = o.via.array;
+        pk.pack_array(array.size);
+        for (uint32_t i = 0; i < array.size; i++) {
+            pack_masked(pk, array.ptr[i], m);
+        }
+        break;
+    }
+    case msgpack::type::MAP: {
+        const msgpack::object_map &map = o.via.map;
+        pk.pack_map(map.size);
+        for (uint32_t i = 0; i < map.size; i++) {
+            const msgpack::object_kv &kv = map.ptr[i];
+            pk.pack(kv.key);
+            mask child_mask = m;
+            if (m == mask::sensitive_headers && is_sensitive_header(kv.key)) {
+                child_mask = mask::strings;
+            } else if (m != mask::strings && is_sensitive_key(kv.key)) {
+                child_mask = mask::strings;
+            } else if (m == mask::sensitive_headers) {
+                child_mask = mask::sensitive_keys;
+            }
+            pack_masked(pk, kv.val, child_mask);
+        }
+        break;
+    }
+    default:
+        pk.pack(o);
+        break;
+    }
+}
+
+// Masks the values of the query parameters with sensitive names
+void pack_masked_uri(packer_t &pk, std::string_view uri)
+{
+    auto query_start = uri.find('?');
+    if (query_start == std::string_view::npos) {
+        pk.pack(uri);
+        return;
+    }
+
+    std::string masked{uri};
+    auto pos = query_start + 1;
+    while (pos < masked.size()) {
+        auto end = masked.find_first_of("&#", pos);
+        if (end == std::string::npos) {
+            end = masked.size();
+        }
+
+        auto eq = masked.find('=', pos);
+        if (eq < end &&
+            is_sensitive_key(std::string_view{masked}.substr(pos, eq - pos))) {
+            std::fill(masked.begin() + static_cast<std::ptrdiff_t>(eq + 1),
+                masked.begin() + static_cast<std::ptrdiff_t>(end), 'x');
+        }
+
+        if (end == masked.size() || masked[end] == '#') {
+            break;
+        }
+        pos = end + 1;
+    }
+    pk.pack(masked);
+}
+
+void pack_request_data(packer_t &pk, const msgpack::object &data)
+{
+    if (data.type != msgpack::type::MAP) {
+        pk.pack(data);
+        return;
+    }
+
+    const msgpack::object_map &map = data.via.map;
+    pk.pack_map(map.size);
+    for (uint32_t i = 0; i < map.size; i++) {
+        const msgpack::object_kv &kv = map.ptr[i];
+
+        std::optional<std::string_view> address;
+        if (kv.key.type == msgpack::type::POSITIVE_INTEGER) {
+            address = address_from_id(kv.key.via.u64);
+        } else if (kv.key.type == msgpack::type::STR) {
+            address = std::string_view{kv.key.via.str.ptr, kv.key.via.str.size};
+        }
+
+        if (!address) {
+            pk.pack(kv.key);
+            pk.pack(kv.val);
+            continue;
+        }
+
+        pk.pack(*address);
+        if (*address == client_ip_address &&
+            kv.val.type == msgpack::type::STR) {
+            pk.pack(masked_client_ip);
+        } else if (*address == cookies_address) {
+            pack_masked(pk, kv.val, mask::strings);
+        } else if (*address == request_headers_address ||
+                   *address == response_headers_address) {
+            pack_masked(pk, kv.val, mask::sensitive_headers);
+        } else if (*address == uri_raw_address &&
+                   kv.val.type == msgpack::type::STR) {
+            pack_masked_uri(
+                pk, std::string_view{kv.val.via.str.ptr, kv.val.via.str.size});
+        } else {
+            pack_masked(pk, kv.val, mask::sensitive_keys);
+        }
+    }
+}
+
+bool carries_request_data(std::string_view method)
+{
+    return method == request_init::name || method == request_exec::name ||
+           method == request_shutdown::name;
+}
+
+} // namespace
+
+capture::capture(const std::string &path, std::size_t max_size)
+    : os_{path, std::ios::binary | std::ios::out | std::ios::trunc},
+      max_size_{max_size}, start_{std::chrono::steady_clock::now()},
+      last_flush_{start_}
+{
+    if (!os_.is_open()) {
+        throw std::runtime_error("Could not open capture file " + path);
+    }
+    os_.write(file_magic.data(), file_magic.size());
+    written_ = file_magic.size();
+}
+
+void capture::sanitize(packer_t &packer, const msgpack::object &message)
+{
+    // [method, [args...]]
+    if (message.type != msgpack::type::ARRAY || message.via.array.size != 2 ||
+        message.via.array.ptr[0].type != msgpack::type::STR ||
+        message.via.array.ptr[1].type != msgpack::type::ARRAY) {
+        packer.pack(message);
+        return;
+    }
+
+    const msgpack::object &method_obj = message.via.array.ptr[0];
+    const msgpack::object_array &args = message.via.array.ptr[1].via.array;
+    std::string_view method{method_obj.via.str.ptr, method_obj.via.str.size};
+
+    packer.pack_array(2);
+    packer.pack(method_obj);
+    packer.pack_array(args.size);
+    for (uint32_t i = 0; i < args.size; i++) {
+        if (i == 0 && carries_request_data(method)) {
+            pack_request_data(packer, args.ptr[i]);
+        } else {
+            packer.pack(args.ptr[i]);
+        }
+    }
+}
+
+void capture::record(
+    uint32_t connection_id, const msgpack::object &message) noexcept
+{
+    try {
+        msgpack::sbuffer buffer;
+        packer_t packer{buffer};
+        sanitize(packer, message);
+
+        const std::lock_guard<std::mutex> lock{mtx_};
+        if (full_) {
+            return;
+        }
+
+        capture_record_header_t header;
+        header.connection_id = connection_id;
+        header.size = static_cast<uint32_t>(buffer.size());
+
+        if (written_ + sizeof(header) + buffer.size() > max_size_) {
+            full_ = true;
+            os_.flush();
+            SPDLOG_INFO("Capture file reached {} bytes, no longer capturing",
+                written_);
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        header.time_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(now - start_)
+                .count();
+
+        // NOLINTNEXTLINE
+        os_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        os_.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        written_ += sizeof(header) + buffer.size();
+
+        if (now - last_flush_ >= flush_interval) {
+            os_.flush();
+            last_flush_ = now;
+        }
+    } catch (const std::exception &e) {
+        SPDLOG_DEBUG("Failed to capture message: {}", e.what());
+    }
+}
+
+} // namespace dds::network
@@ -0,0 +1,75 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <msgpack.hpp>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace dds::network {
+
+// Each record of a capture file is made of this header followed by the
+// sanitized message ([method, [args...]]), packed as msgpack.
+using capture_record_header_t = struct __attribute__((__packed__))
+capture_record_header {
+    // microseconds since the capture was started
+    uint64_t time_us{0};
+    uint32_t connection_id{0};
+    uint32_t size{0};
+};
+
+// Records the messages received by the helper, so that they can be replayed
+// by tests/bench_helper. Before being written, messages are sanitized:
+//  - cookie values, credential headers and the values of any key matching
+//    the default obfuscator key regex (in the query, the body, the raw uri,
+//    ...) are replaced with 'x' characters of the same length and the client
+//    ip with a documentation address;
+//  - address ids are replaced with the address names, so that captures can
+//    be replayed by clients which don't negotiate address ids.
+// Everything else is kept as is, as it's what drives the cost of running the
+// WAF.
+class capture {
+public:
+    using ptr = std::shared_ptr<capture>;
+
+    static constexpr std::string_view file_magic{"DDCAPT1\n"};
+
+    capture(const std::string &path, std::size_t max_size);
+    capture(const capture &) = delete;
+    capture &operator=(const capture &) = delete;
+    capture(capture &&) = delete;
+    capture &operator=(capture &&) = delete;
+    ~capture() = default;
+
+    uint32_t new_connection() { return ++last_connection_id_; }
+
+    // Never throws, capture failures shouldn't affect request handling
+    void record(
+        uint32_t connection_id, const msgpack::object &message) noexcept;
+
+    // Packs message as it would be recorded, exposed for testing
+    static void sanitize(
+        // NOLINTNEXTLINE(google-runtime-references)
+        msgpack::packer<msgpack::sbuffer> &packer,
+        const msgpack::object &message);
+
+protected:
+    std::mutex mtx_;
+    std::ofstream os_;
+    const std::size_t max_size_;
+    std::size_t written_{0};
+    bool full_{false};
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_flush_;
+    std::atomic<uint32_t> last_connection_id_{0};
+};
+
+} // namespace dds::network
@@ -4,18 +4,42 @@
 // This product includes software developed at Datadog
 // (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
 #include "msgpack_helpers.hpp"
+#include "addresses.hpp"
+
+namespace {
+// values cut short on this thread, see dds::network::truncated_values
+thread_local uint64_t truncated = 0;
+} // namespace
+
+namespace dds::network {
+uint64_t truncated_values() noexcept { return truncated; }
+} // namespace dds::network
 
 namespace msgpack {
 MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
 namespace adaptor {
 
 namespace {
+// The default limits of the WAF, which ignores whatever lies beyond them, so
+// there is no point in converting more
 constexpr unsigned max_depth = 20;
+constexpr uint32_t max_container_size = 256;
+constexpr std::size_t max_string_length = 4096;
+
+uint32_t truncate_size(uint32_t size)
+{
+    if (size > max_container_size) {
+        truncated++;
+        return max_container_size;
+    }
+    return size;
+}
 
 // NOLINTNEXTLINE(misc-no-recursion)
 dds::parameter msgpack_to_param(const msgpack::object &o, unsigned depth = 0)
 {
     if (depth++ >= max_depth) {
+        truncated++;
         return {};
     }
 
@@ -23,7 +47,8 @@ dds::parameter msgpack_to_param(const msgpack::object &o, unsigned depth = 0)
     case msgpack::type::ARRAY: {
         dds::parameter p = dds::parameter::array();
         const msgpack::object_array &array = o.via.array;
-        for (uint32_t i = 0; i < array.size; i++) {
+        auto size = truncate_size(array.size);
+        for (uint32_t i = 0; i < size; i++) {
             const msgpack::object &item = array.ptr[i];
             p.add(msgpack_to_param(item, depth));
         }
@@ -32,16 +57,30 @@ dds::parameter msgpack_to_param(const msgpack::object &o, unsigned depth = 0)
     case msgpack::type::MAP: {
         dds::parameter p = dds::parameter::map();
         const msgpack::object_map &map = o.via.map;
-        for (uint32_t i = 0; i < map.size; i++) {
+        auto size = truncate_size(map.size);
+        for (uint32_t i = 0; i < size; i++) {
             const msgpack::object_kv &kv = map.ptr[i];
-            // Assume keys are strings
+            // Top level keys can be address ids, otherwise assume strings
+            if (depth == 1 && kv.key.type == msgpack::type::POSITIVE_INTEGER) {
+                auto address = dds::network::address_from_id(kv.key.via.u64);
+                if (address) {
+                    p.add(*address, msgpack_to_param(kv.val, depth));
+                }
+                continue;
+            }
             p.add(
                 kv.key.as<std::string_view>(), msgpack_to_param(kv.val, depth));
         }
         return p;
     }
-    case msgpack::type::STR:
-        return dds::parameter::string(o.as<std::string_view>());
+    case msgpack::type::STR: {
+        auto str = o.as<std::string_view>();
+        if (str.size() > max_string_length) {
+            truncated++;
+            str = str.substr(0, max_string_length);
+        }
+        return dds::parameter::string(str);
+    }
     case msgpack::type::BOOLEAN:
         return dds::parameter::as_boolean(o.as<bool>());
     case msgpack::type::FLOAT64:
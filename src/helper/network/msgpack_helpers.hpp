@@ -10,6 +10,12 @@
 #include <msgpack.hpp>
 #include <sstream>
 
+namespace dds::network {
+// Number of strings, containers and nested values cut short to the limits of
+// the WAF by the conversions to parameter done on this thread so far
+uint64_t truncated_values() noexcept;
+} // namespace dds::network
+
 namespace msgpack {
 MSGPACK_API_VERSION_NAMESPACE(MSGPACK_DEFAULT_API_NS) {
 namespace adaptor {
@@ -37,7 +37,11 @@ template <typename T> auto msgpack_to_request(const msgpack::object &o)
 {
     using R = typename T::request;
     try {
-        return std::make_shared<R>(o.as<R>());
+        auto truncated_before = dds::network::truncated_values();
+        auto request = std::make_shared<R>(o.as<R>());
+        request->truncated_values =
+            dds::network::truncated_values() - truncated_before;
+        return request;
     } catch (...) {
         return std::make_shared<R>();
     }
@@ -59,6 +59,9 @@ struct base_request {
     base_request &operator=(base_request &&) = default;
 
     virtual ~base_request() = default;
+
+    // Not on the wire, the values truncated while decoding the request
+    uint64_t truncated_values{0};
 };
 
 struct base_response {
@@ -103,6 +106,8 @@ struct client_init {
         dds::service_identifier service;
         dds::engine_settings engine_settings;
         dds::remote_config::settings rc_settings;
+        // optional, not sent by older clients
+        std::vector<std::string> capabilities;
 
         request() = default;
         request(const request &) = delete;
@@ -112,7 +117,8 @@ struct client_init {
         ~request() override = default;
 
         MSGPACK_DEFINE(pid, client_version, runtime_version,
-            enabled_configuration, service, engine_settings, rc_settings);
+            enabled_configuration, service, engine_settings, rc_settings,
+            capabilities);
     };
 
     struct response : base_response_generic<response> {
@@ -129,7 +135,11 @@ struct client_init {
         std::map<std::string, std::string> meta;
         std::map<std::string_view, double> metrics;
 
-        MSGPACK_DEFINE(status, version, errors, meta, metrics);
+        // the subset of the capabilities requested by the client which are
+        // supported by the helper
+        std::vector<std::string_view> capabilities;
+
+        MSGPACK_DEFINE(status, version, errors, meta, metrics, capabilities);
     };
 };
 
@@ -83,6 +83,7 @@ bool client_handler::start()
 void client_handler::handle_error()
 {
     rc_action_ = [this] { discover(); };
+    polling_ = false;
 
     if (errors_ < std::numeric_limits<std::uint16_t>::max() - 1) {
         errors_++;
@@ -91,7 +92,7 @@ void client_handler::handle_error()
     if (interval_ < max_interval) {
         auto new_interval =
             std::chrono::duration_cast<std::chrono::milliseconds>(
-                poll_interval_ * pow(2, errors_));
+                poll_interval_ * pow(2, errors_.load()));
         interval_ = std::min(max_interval, new_interval);
     }
 }
@@ -110,6 +111,7 @@ void client_handler::discover()
         if (rc_client_->is_remote_config_available()) {
             // Remote config is available. Start polls
             rc_action_ = [this] { poll(); };
+            polling_ = true;
             errors_ = 0;
             interval_ = poll_interval_;
             return;
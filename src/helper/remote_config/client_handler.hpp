@@ -12,6 +12,7 @@
 #include "service_identifier.hpp"
 #include "std_logging.hpp"
 #include "utils.hpp"
+#include <atomic>
 #include <future>
 #include <memory>
 #include <spdlog/spdlog.h>
@@ -46,6 +47,11 @@ public:
 
     remote_config::client *get_client() { return rc_client_.get(); }
 
+    // Whether remote config was found on the agent and is being polled
+    [[nodiscard]] bool is_polling() const { return polling_; }
+    // Consecutive discovery or poll failures
+    [[nodiscard]] std::uint16_t error_count() const { return errors_; }
+
     void register_runtime_id(const std::string &id)
     {
         if (rc_client_) {
@@ -74,7 +80,8 @@ protected:
     void tick();
     std::function<void()> rc_action_;
 
-    std::uint16_t errors_ = {0};
+    std::atomic<std::uint16_t> errors_ = {0};
+    std::atomic<bool> polling_ = {false};
 
     std::promise<bool> exit_;
     std::thread handler_;
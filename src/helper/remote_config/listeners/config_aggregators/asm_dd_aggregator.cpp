@@ -31,7 +31,8 @@ void dds::remote_config::asm_dd_aggregator::remove(const config & /*config*/)
     auto ruleset = engine_ruleset::from_path(fallback_rules_file_);
 
     rapidjson::Document doc(&ruleset_.GetAllocator());
-    doc.CopyFrom(ruleset.get_document(), doc.GetAllocator());
+    // The strings of the ruleset point into its source, so they're copied too
+    doc.CopyFrom(ruleset.get_document(), doc.GetAllocator(), true);
 
     ruleset_ = std::move(doc);
 }
@@ -6,11 +6,17 @@
 #include "runner.hpp"
 
 #include "client.hpp"
+#include "metrics.hpp"
 #include "subscriber/waf.hpp"
+#include "tracepoints.hpp"
 #include <cstdio>
+#include <fstream>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
 #include <spdlog/spdlog.h>
 #include <stdexcept>
 #include <sys/stat.h>
+#include <unistd.h>
 
 namespace dds {
 
@@ -32,6 +38,130 @@ network::base_acceptor::ptr acceptor_from_config(const config::config &cfg)
 
     return std::make_unique<network::local::acceptor>(value);
 }
+
+network::capture::ptr capture_from_config(const config::config &cfg)
+{
+    if (!cfg.get<bool>("capture_path")) {
+        return nullptr;
+    }
+
+    auto path{cfg.get<std::string>("capture_path")};
+    try {
+        static constexpr std::size_t mib = 1024 * 1024;
+        auto max_size{cfg.get<std::size_t>("capture_max_size") * mib};
+        auto capture = std::make_shared<network::capture>(path, max_size);
+        SPDLOG_INFO("Capturing messages to {}", path);
+        return capture;
+    } catch (const std::exception &e) {
+        // Not a critical error, we should continue
+        SPDLOG_WARN("Failed to start capture: {}", e.what());
+    }
+    return nullptr;
+}
+
+stats_server::ptr stats_server_from_config(
+    const config::config &cfg, stats_server::snapshot_fn &&fn)
+{
+    if (!cfg.get<bool>("stats_socket_path")) {
+        return nullptr;
+    }
+
+    auto path{cfg.get<std::string_view>("stats_socket_path")};
+    try {
+        auto server = std::make_unique<stats_server>(
+            std::make_unique<network::local::acceptor>(
+                path, stats_server::socket_mode),
+            std::move(fn));
+        SPDLOG_INFO("Serving stats on {}", path);
+        return server;
+    } catch (const std::exception &e) {
+        // Not a critical error, we should continue
+        SPDLOG_WARN("Failed to start the stats server: {}", e.what());
+    }
+    return nullptr;
+}
+
+// Resident set size of the process, in bytes
+uint64_t resident_memory()
+{
+    std::ifstream statm{"/proc/self/statm"};
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    if (!(statm >> size >> resident)) {
+        return 0;
+    }
+    return resident * static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+}
+
+using json_writer = rapidjson::Writer<rapidjson::StringBuffer>;
+
+// NOLINTNEXTLINE(google-runtime-references)
+void write_latencies(json_writer &w)
+{
+    const auto &stats = metrics::command_stats::instance();
+
+    w.StartObject();
+    for (std::size_t c = 1; c < metrics::command_count; c++) {
+        auto command = static_cast<network::request_id>(c);
+        auto name = metrics::to_string(command);
+        w.Key(name.data(), name.size());
+        w.StartObject();
+        for (std::size_t s = 0; s < metrics::stage_count; s++) {
+            auto stage = static_cast<metrics::stage>(s);
+            auto snapshot = stats.get(command, stage).get();
+            if (snapshot.count == 0) {
+                continue;
+            }
+
+            auto stage_name = metrics::to_string(stage);
+            w.Key(stage_name.data(), stage_name.size());
+            w.StartObject();
+            w.Key("count");
+            w.Uint64(snapshot.count);
+            w.Key("sum_us");
+            w.Uint64(snapshot.sum_us);
+            w.Key("max_us");
+            w.Uint64(snapshot.max_us);
+            // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+            w.Key("p50_us");
+            w.Uint64(snapshot.percentile(50));
+            w.Key("p99_us");
+            w.Uint64(snapshot.percentile(99));
+            // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+            // Bucket i counts the durations below 2^i us
+            w.Key("buckets");
+            w.StartArray();
+            for (auto count : snapshot.buckets) { w.Uint64(count); }
+            w.EndArray();
+            if (metrics::alloc_tracking) {
+                auto allocs = stats.get_allocations(command, stage);
+                w.Key("allocs");
+                w.Uint64(allocs.count);
+                w.Key("alloc_bytes");
+                w.Uint64(allocs.bytes);
+            }
+            w.EndObject();
+        }
+        w.EndObject();
+    }
+    w.EndObject();
+}
+
+// NOLINTNEXTLINE(google-runtime-references)
+void log_stats(std::chrono::steady_clock::time_point &last)
+{
+    static constexpr auto stats_interval{std::chrono::minutes{5}};
+    auto now = std::chrono::steady_clock::now();
+    if (now - last < stats_interval) {
+        return;
+    }
+    last = now;
+
+    auto summary = metrics::command_stats::instance().summary();
+    if (!summary.empty()) {
+        SPDLOG_INFO("Command latencies:\n{}", summary);
+    }
+}
 } // namespace
 
 runner::runner(const config::config &cfg)
@@ -41,8 +171,9 @@ runner::runner(const config::config &cfg)
 runner::runner(
     const config::config &cfg, network::base_acceptor::ptr &&acceptor)
     : cfg_(cfg), service_manager_{std::make_shared<service_manager>()},
-      acceptor_(std::move(acceptor)),
-      idle_timeout_(cfg.get<unsigned>("runner_idle_timeout"))
+      capture_(capture_from_config(cfg)), acceptor_(std::move(acceptor)),
+      idle_timeout_(cfg.get<unsigned>("runner_idle_timeout")),
+      stats_server_(stats_server_from_config(cfg, [this] { return stats(); }))
 {
     try {
         acceptor_->set_accept_timeout(1min);
@@ -56,8 +187,11 @@ void runner::run()
 {
     try {
         auto last_not_idle = std::chrono::steady_clock::now();
+        auto last_stats = last_not_idle;
         SPDLOG_INFO("Running");
         while (running_) {
+            log_stats(last_stats);
+
             network::base_socket::ptr socket;
             try {
                 socket = acceptor_->accept();
@@ -88,13 +222,17 @@ void runner::run()
                 break;
             }
 
-            const std::shared_ptr<client> c =
-                std::make_shared<client>(service_manager_, std::move(socket));
+            const std::shared_ptr<client> c = std::make_shared<client>(
+                service_manager_, std::move(socket), capture_);
 
             SPDLOG_DEBUG("new client connected");
 
-            worker_pool_.launch(
-                [c](worker::queue_consumer &q) mutable { c->run(q); });
+            client_count_++;
+            DD_TRACEPOINT(conn_accept, client_count_.load());
+            worker_pool_.launch([this, c](worker::queue_consumer &q) mutable {
+                c->run(q);
+                client_count_--;
+            });
 
             last_not_idle = std::chrono::steady_clock::now();
         }
@@ -103,4 +241,82 @@ void runner::run()
     }
 }
 
+std::string runner::stats()
+{
+    rapidjson::StringBuffer buffer;
+    json_writer w(buffer);
+
+    w.StartObject();
+    w.Key("pid");
+    w.Int(::getpid());
+    w.Key("uptime_s");
+    w.Int64(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now() - start_)
+                .count());
+    w.Key("rss_bytes");
+    w.Uint64(resident_memory());
+    w.Key("clients");
+    w.Uint(client_count_);
+    w.Key("workers");
+    w.Uint(worker_pool_.worker_count());
+
+    w.Key("services");
+    w.StartArray();
+    for (const auto &[id, service_ptr] : service_manager_->get_services()) {
+        w.StartObject();
+        w.Key("service");
+        w.String(id.service.c_str(), id.service.size());
+        w.Key("env");
+        w.String(id.env.c_str(), id.env.size());
+        w.Key("asm_enabled");
+        switch (service_ptr->get_service_config()->get_asm_enabled_status()) {
+        case enable_asm_status::ENABLED:
+            w.Bool(true);
+            break;
+        case enable_asm_status::DISABLED:
+            w.Bool(false);
+            break;
+        case enable_asm_status::NOT_SET:
+        default:
+            w.Null();
+            break;
+        }
+
+        auto handler = service_ptr->get_client_handler();
+        w.Key("remote_config");
+        if (handler) {
+            w.StartObject();
+            w.Key("polling");
+            w.Bool(handler->is_polling());
+            w.Key("errors");
+            w.Uint(handler->error_count());
+            w.EndObject();
+        } else {
+            w.Null();
+        }
+
+        const auto &cache = service_ptr->get_engine()->get_verdict_cache();
+        w.Key("verdict_cache");
+        if (cache) {
+            auto cache_stats = cache->get_stats();
+            w.StartObject();
+            w.Key("hits");
+            w.Uint64(cache_stats.hits);
+            w.Key("misses");
+            w.Uint64(cache_stats.misses);
+            w.EndObject();
+        } else {
+            w.Null();
+        }
+        w.EndObject();
+    }
+    w.EndArray();
+
+    w.Key("latencies");
+    write_latencies(w);
+    w.EndObject();
+
+    return {buffer.GetString(), buffer.GetSize()};
+}
+
 } // namespace dds
@@ -10,8 +10,10 @@
 
 #include "config.hpp"
 #include "network/acceptor.hpp"
+#include "network/capture.hpp"
 #include "network/socket.hpp"
 #include "service_manager.hpp"
+#include "stats_server.hpp"
 #include "worker_pool.hpp"
 
 namespace dds {
@@ -30,15 +32,26 @@ public:
 
     void exit() { running_ = false; }
 
+    // JSON snapshot of the counters and latencies of the helper
+    [[nodiscard]] std::string stats();
+
 private:
     const config::config &cfg_;
+    std::chrono::steady_clock::time_point start_{
+        std::chrono::steady_clock::now()};
     std::shared_ptr<service_manager> service_manager_;
+    // Connected clients, it must outlive the workers
+    std::atomic<unsigned> client_count_{0};
     worker::pool worker_pool_;
+    network::capture::ptr capture_;
 
     // Server variables
     network::base_acceptor::ptr acceptor_;
     std::chrono::minutes idle_timeout_;
     std::atomic<bool> running_{true};
+
+    // Last so that it's stopped before anything it reports on is destroyed
+    stats_server::ptr stats_server_;
 };
 
 } // namespace dds
@@ -70,6 +70,12 @@ public:
         return service_config_;
     }
 
+    [[nodiscard]] dds::remote_config::client_handler::ptr
+    get_client_handler() const
+    {
+        return client_handler_;
+    }
+
     [[nodiscard]] std::shared_ptr<sampler> get_schema_sampler()
     {
         return schema_sampler_;
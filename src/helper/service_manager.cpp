@@ -37,6 +37,22 @@ std::shared_ptr<service> service_manager::create_service(
     return service_ptr;
 }
 
+std::vector<std::pair<service_identifier, service::ptr>>
+service_manager::get_services()
+{
+    const std::lock_guard guard{mutex_};
+
+    std::vector<std::pair<service_identifier, service::ptr>> services;
+    services.reserve(cache_.size());
+    for (const auto &[id, weak_ptr] : cache_) {
+        auto service_ptr = weak_ptr.lock();
+        if (service_ptr) {
+            services.emplace_back(id, std::move(service_ptr));
+        }
+    }
+    return services;
+}
+
 void service_manager::cleanup_cache()
 {
     for (auto it = cache_.begin(); it != cache_.end();) {
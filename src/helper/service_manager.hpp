@@ -30,6 +30,10 @@ public:
         std::map<std::string, std::string> &meta,
         std::map<std::string_view, double> &metrics, bool dynamic_enablement);
 
+    // Services still in use, for the stats
+    [[nodiscard]] std::vector<std::pair<service_identifier, service::ptr>>
+    get_services();
+
 protected:
     using cache_t = std::unordered_map<service_identifier,
         std::weak_ptr<service>, service_identifier::hash>;
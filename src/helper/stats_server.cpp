@@ -0,0 +1,58 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "stats_server.hpp"
+#include "exception.hpp"
+#include <spdlog/spdlog.h>
+
+using namespace std::chrono_literals;
+
+namespace dds {
+
+stats_server::stats_server(
+    network::base_acceptor::ptr &&acceptor, snapshot_fn &&fn)
+    : acceptor_(std::move(acceptor)), snapshot_fn_(std::move(fn))
+{
+    // The timeout bounds how long stopping the server can take
+    acceptor_->set_accept_timeout(1s);
+    thread_ = std::thread(&stats_server::run, this);
+}
+
+stats_server::~stats_server()
+{
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void stats_server::run()
+{
+    static constexpr auto send_timeout{100ms};
+    while (running_) {
+        network::base_socket::ptr socket;
+        try {
+            socket = acceptor_->accept();
+        } catch (const timeout_error &) {
+            continue;
+        } catch (const std::exception &e) {
+            SPDLOG_WARN("Stats server stopped: {}", e.what());
+            break;
+        }
+
+        try {
+            socket->set_send_timeout(send_timeout);
+            auto snapshot = snapshot_fn_();
+            if (socket->send(snapshot.data(), snapshot.size()) !=
+                snapshot.size()) {
+                SPDLOG_DEBUG("Failed to send the complete stats snapshot");
+            }
+        } catch (const std::exception &e) {
+            SPDLOG_WARN("Failed to send stats: {}", e.what());
+        }
+    }
+}
+
+} // namespace dds
@@ -0,0 +1,45 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include "network/acceptor.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace dds {
+
+// Serves a snapshot of the helper stats on its own socket, separate from the
+// one used by the extension. Each connection gets the snapshot, as JSON, and
+// is then closed, so it can be scraped with e.g. socat.
+class stats_server {
+public:
+    using ptr = std::unique_ptr<stats_server>;
+    using snapshot_fn = std::function<std::string()>;
+
+    // The stats include the service and env of the applications, so only
+    // the user running the helper can connect to the socket
+    static constexpr mode_t socket_mode = 0600;
+
+    stats_server(network::base_acceptor::ptr &&acceptor, snapshot_fn &&fn);
+    stats_server(const stats_server &) = delete;
+    stats_server &operator=(const stats_server &) = delete;
+    stats_server(stats_server &&) = delete;
+    stats_server &operator=(stats_server &&) = delete;
+    ~stats_server();
+
+protected:
+    void run();
+
+    network::base_acceptor::ptr acceptor_;
+    snapshot_fn snapshot_fn_;
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+};
+
+} // namespace dds
@@ -8,6 +8,7 @@
 #include "../engine_settings.hpp"
 #include "../parameter.hpp"
 #include "../parameter_view.hpp"
+#include <chrono>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -19,11 +20,22 @@ public:
     using ptr = std::shared_ptr<subscriber>;
 
     struct event {
+        // JSON fragments, each holding one or more comma-separated events
         std::vector<std::string> data;
         std::unordered_set<std::string> actions;
         std::map<std::string, std::string> schemas;
     };
 
+    // Time the listeners can still spend on a request, shared by all the
+    // publishes of a request context, so that the time spent on a request
+    // is bounded however many times data is published.
+    struct time_budget {
+        std::chrono::microseconds remaining;
+        bool exhausted{false};
+        // runs skipped because nothing was left of the budget
+        unsigned skipped{0};
+    };
+
     class listener {
     public:
         using ptr = std::shared_ptr<listener>;
@@ -37,6 +49,13 @@ public:
         virtual ~listener() = default;
         // NOLINTNEXTLINE(google-runtime-references)
         virtual std::optional<event> call(parameter_view &data) = 0;
+        // Listeners which don't support a budget ignore it
+        virtual std::optional<event> call(
+            // NOLINTNEXTLINE(google-runtime-references)
+            parameter_view &data, time_budget * /*budget*/)
+        {
+            return call(data);
+        }
 
         // NOLINTNEXTLINE(google-runtime-references)
         virtual void get_meta_and_metrics(
@@ -53,8 +72,14 @@ public:
     subscriber &operator=(subscriber &&) = delete;
 
     virtual std::string_view get_name() = 0;
+    // Whether what the listeners find only depends on the data published on
+    // the request, so that their verdict on some data can be reused
+    virtual bool is_stateless() { return false; }
     virtual std::unordered_set<std::string> get_subscriptions() = 0;
     virtual listener::ptr get_listener() = 0;
+    // Takes back a listener once its request is over, so that it can be
+    // reused by another request
+    virtual void recycle(listener::ptr && /*listener*/) {}
     virtual subscriber::ptr update(parameter &rule,
         std::map<std::string, std::string> &meta,
         std::map<std::string_view, double> &metrics) = 0;
@@ -5,6 +5,7 @@
 // (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
 #include "../std_logging.hpp"
 #include "ddwaf.h"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdlib>
@@ -14,10 +15,14 @@
 #include <rapidjson/document.h>
 #include <rapidjson/error/en.h>
 #include <rapidjson/writer.h>
+#include <set>
 #include <stdexcept>
 #include <string_view>
 
 #include "../json_helper.hpp"
+#include "../metrics.hpp"
+#include "../parameter_view.hpp"
+#include "../tracepoints.hpp"
 #include "../tags.hpp"
 #include "waf.hpp"
 
@@ -27,6 +32,8 @@ namespace {
 
 dds::subscriber::event format_waf_result(ddwaf_result &res)
 {
+    const dds::metrics::stage_timer timer{dds::metrics::stage::format};
+
     dds::subscriber::event output;
     try {
         const parameter_view actions{res.actions};
@@ -34,15 +41,24 @@ dds::subscriber::event format_waf_result(ddwaf_result &res)
             output.actions.emplace(std::string{action});
         }
 
+        // All the events of the run go in a single fragment, which is
+        // forwarded as it is to the extension
         const parameter_view events{res.events};
-        for (const auto &event : events) {
-            output.data.emplace_back(std::move(parameter_to_json(event)));
+        if (events.size() > 0) {
+            auto fragment = parameter_elements_to_json(events);
+            if (!fragment.empty()) {
+                output.data.emplace_back(std::move(fragment));
+            }
         }
 
         const parameter_view schemas{res.derivatives};
         for (const auto &schema : schemas) {
-            output.schemas.emplace(
-                schema.key(), std::move(parameter_to_json(schema)));
+            auto json = parameter_to_json(schema);
+            // The failure was logged, an empty schema isn't worth sending
+            if (json.empty()) {
+                continue;
+            }
+            output.schemas.emplace(schema.key(), std::move(json));
         }
     } catch (const std::exception &e) {
         SPDLOG_ERROR("failed to parse WAF output: {}", e.what());
@@ -145,6 +161,141 @@ void extract_tags_and_metrics(parameter_view diagnostics, std::string &version,
     }
 }
 
+constexpr std::string_view uri_address = "server.request.uri.raw";
+
+std::optional<parameter_view> find_entry(
+    const parameter_view &map, std::string_view key)
+{
+    if (!map.is_map()) {
+        return std::nullopt;
+    }
+    for (const auto &entry : map) {
+        if (entry.key() == key) {
+            return entry;
+        }
+    }
+    return std::nullopt;
+}
+
+bool is_string_entry(
+    const parameter_view &map, std::string_view key, std::string_view value)
+{
+    auto entry = find_entry(map, key);
+    return entry && entry->is_string() && std::string_view(*entry) == value;
+}
+
+bool is_empty_entry(const parameter_view &map, std::string_view key)
+{
+    auto entry = find_entry(map, key);
+    return !entry || (entry->is_container() && entry->size() == 0);
+}
+
+// The raw URIs a rule is restricted to by an exact match condition, none if
+// it could match on any route
+std::vector<std::string_view> rule_routes(const parameter_view &rule)
+{
+    // Transformers could turn other URIs into one of the list
+    if (!is_empty_entry(rule, "transformers")) {
+        return {};
+    }
+
+    auto conditions = find_entry(rule, "conditions");
+    if (!conditions || conditions->type() != parameter_type::array) {
+        return {};
+    }
+
+    for (const auto &condition : *conditions) {
+        auto parameters = find_entry(condition, "parameters");
+        if (!is_string_entry(condition, "operator", "exact_match") ||
+            !parameters) {
+            continue;
+        }
+
+        auto inputs = find_entry(*parameters, "inputs");
+        auto list = find_entry(*parameters, "list");
+        if (!inputs || inputs->type() != parameter_type::array ||
+            inputs->size() != 1 || !list ||
+            list->type() != parameter_type::array) {
+            continue;
+        }
+
+        const auto &input = (*inputs)[0];
+        if (!is_string_entry(input, "address", uri_address) ||
+            !is_empty_entry(input, "key_path") ||
+            !is_empty_entry(input, "transformers")) {
+            continue;
+        }
+
+        std::vector<std::string_view> routes;
+        for (const auto &value : *list) {
+            if (value.is_string()) {
+                routes.emplace_back(value);
+            }
+        }
+        if (!routes.empty()) {
+            return routes;
+        }
+    }
+    return {};
+}
+
+bool is_rules_section(std::string_view key)
+{
+    return key == "rules" || key == "custom_rules";
+}
+
+// Rulesets come from JSON, so they survive the round trip unchanged; a
+// failed conversion throws and leaves the rules unscoped
+parameter copy(const parameter_view &pv)
+{
+    return json_to_parameter(parameter_to_json(pv));
+}
+
+// The ruleset, or update, without the rules restricted to other routes than
+// the given one. Without a route, only the rules matching on any route are
+// kept.
+parameter scope_ruleset(
+    const parameter_view &ruleset, std::optional<std::string_view> route)
+{
+    auto scoped = parameter::map();
+    for (const auto &section : ruleset) {
+        if (!is_rules_section(section.key()) ||
+            section.type() != parameter_type::array) {
+            scoped.add(section.key(), copy(section));
+            continue;
+        }
+
+        auto rules = parameter::array();
+        for (const auto &rule : section) {
+            auto routes = rule_routes(rule);
+            if (routes.empty() ||
+                (route && std::find(routes.begin(), routes.end(), *route) !=
+                              routes.end())) {
+                rules.add(copy(rule));
+            }
+        }
+        scoped.add(section.key(), std::move(rules));
+    }
+    return scoped;
+}
+
+// The routes the rules of the ruleset, or update, are restricted to
+std::set<std::string_view> ruleset_routes(const parameter_view &ruleset)
+{
+    std::set<std::string_view> routes;
+    for (const auto &section : ruleset) {
+        if (!is_rules_section(section.key()) ||
+            section.type() != parameter_type::array) {
+            continue;
+        }
+        for (const auto &rule : section) {
+            auto restricted = rule_routes(rule);
+            routes.insert(restricted.begin(), restricted.end());
+        }
+    }
+    return routes;
+}
+
 } // namespace
 
 void initialise_logging(spdlog::level::level_enum level)
@@ -157,17 +308,48 @@ instance::listener::listener(ddwaf_context ctx,
     : handle_{ctx}, waf_timeout_{waf_timeout}, ruleset_version_(ruleset_version)
 {}
 
+instance::listener::listener(const instance &owner)
+    : waf_timeout_{owner.waf_timeout_},
+      ruleset_version_(owner.ruleset_version_), owner_(&owner)
+{}
+
 instance::listener::listener(instance::listener &&other) noexcept
-    : handle_{other.handle_}, waf_timeout_{other.waf_timeout_}
+    : handle_{other.handle_}, waf_timeout_{other.waf_timeout_},
+      total_runtime_{other.total_runtime_},
+      ruleset_version_{other.ruleset_version_}, owner_{other.owner_},
+      rule_count_{other.rule_count_}
 {
     other.handle_ = nullptr;
     other.waf_timeout_ = {};
+    other.total_runtime_ = 0.0;
+    other.rule_count_ = 0;
 }
 
 instance::listener &instance::listener::operator=(listener &&other) noexcept
 {
+    if (this == &other) {
+        return *this;
+    }
+
+    // The context of this listener would leak otherwise
+    if (handle_ != nullptr) {
+        ddwaf_context_destroy(handle_);
+    }
     handle_ = other.handle_;
     other.handle_ = nullptr;
+
+    waf_timeout_ = other.waf_timeout_;
+    other.waf_timeout_ = {};
+
+    total_runtime_ = other.total_runtime_;
+    other.total_runtime_ = 0.0;
+
+    ruleset_version_ = other.ruleset_version_;
+    owner_ = other.owner_;
+
+    rule_count_ = other.rule_count_;
+    other.rule_count_ = 0;
+
     return *this;
 }
 
@@ -178,13 +360,48 @@ instance::listener::~listener()
     }
 }
 
+void instance::listener::reset(ddwaf_context ctx)
+{
+    if (handle_ != nullptr) {
+        ddwaf_context_destroy(handle_);
+    }
+    handle_ = ctx;
+    total_runtime_ = 0.0;
+    rule_count_ = 0;
+}
+
 std::optional<subscriber::event> instance::listener::call(
     dds::parameter_view &data)
 {
+    return call(data, nullptr);
+}
+
+std::optional<subscriber::event> instance::listener::call(
+    dds::parameter_view &data, time_budget *budget)
+{
+    // The route is only known once the first data of the request is
+    if (handle_ == nullptr && owner_ != nullptr) {
+        handle_ = owner_->init_context(data, rule_count_);
+    }
+
+    auto timeout = waf_timeout_;
+    if (budget != nullptr) {
+        if (budget->remaining.count() <= 0) {
+            budget->exhausted = true;
+            budget->skipped++;
+            SPDLOG_DEBUG("WAF run skipped, the request budget is exhausted");
+            return std::nullopt;
+        }
+        timeout = std::min(timeout, budget->remaining);
+    }
+
     ddwaf_result res;
     DDWAF_RET_CODE code;
     auto run_waf = [&]() {
-        code = ddwaf_run(handle_, data, &res, waf_timeout_.count());
+        DD_TRACEPOINT(waf_run_begin, data.size());
+        code = ddwaf_run(handle_, data, &res, timeout.count());
+        DD_TRACEPOINT(waf_run_end, static_cast<int>(code), res.timeout,
+            res.total_runtime);
     };
 
     if (spdlog::should_log(spdlog::level::debug)) {
@@ -209,6 +426,17 @@ std::optional<subscriber::event> instance::listener::call(
     // NOLINTNEXTLINE
     total_runtime_ += res.total_runtime / 1000.0;
 
+    // Only a timeout caused by the budget, rather than by the per-run
+    // timeout, exhausts it. That's expected, so it isn't an error.
+    const bool budget_timeout = res.timeout && timeout < waf_timeout_;
+    if (budget != nullptr) {
+        // Rounded up, or short runs would never use up the budget
+        auto runtime = std::chrono::ceil<std::chrono::microseconds>(
+            std::chrono::nanoseconds{res.total_runtime});
+        budget->remaining -= std::min(runtime, budget->remaining);
+        budget->exhausted = budget->exhausted || budget_timeout;
+    }
+
     switch (code) {
     case DDWAF_MATCH:
         return format_waf_result(res);
@@ -219,7 +447,7 @@ std::optional<subscriber::event> instance::listener::call(
     case DDWAF_ERR_INVALID_ARGUMENT:
         throw invalid_argument();
     case DDWAF_OK:
-        if (res.timeout) {
+        if (res.timeout && !budget_timeout) {
             throw timeout_error();
         }
         break;
@@ -236,11 +464,15 @@ void instance::listener::get_meta_and_metrics(
 {
     meta[std::string(tag::event_rules_version)] = ruleset_version_;
     metrics[tag::waf_duration] = total_runtime_;
+    if (rule_count_ > 0) {
+        metrics[tag::waf_rules_evaluated] = static_cast<double>(rule_count_);
+    }
 }
 
 instance::instance(parameter &rule, std::map<std::string, std::string> &meta,
     std::map<std::string_view, double> &metrics, std::uint64_t waf_timeout_us,
-    std::string_view key_regex, std::string_view value_regex)
+    std::string_view key_regex, std::string_view value_regex,
+    bool route_scoping)
     : waf_timeout_{waf_timeout_us}
 {
     const ddwaf_config config{
@@ -264,15 +496,23 @@ instance::instance(parameter &rule, std::map<std::string, std::string> &meta,
 
     addresses_.clear();
     for (uint32_t i = 0; i < size; i++) { addresses_.emplace(addrs[i]); }
+
+    if (route_scoping) {
+        scope_routes(parameter_view{rule}, config, metrics);
+    }
 }
 
 instance::instance(instance &&other) noexcept
     : handle_(other.handle_), waf_timeout_(other.waf_timeout_),
       ruleset_version_(std::move(other.ruleset_version_)),
-      addresses_(std::move(other.addresses_))
+      addresses_(std::move(other.addresses_)), rule_count_(other.rule_count_),
+      route_scopes_(std::move(other.route_scopes_)),
+      other_routes_(other.other_routes_)
 {
     other.handle_ = nullptr;
     other.waf_timeout_ = {};
+    other.route_scopes_.clear();
+    other.other_routes_ = {};
 }
 
 instance &instance::operator=(instance &&other) noexcept
@@ -285,21 +525,233 @@ instance &instance::operator=(instance &&other) noexcept
 
     ruleset_version_ = std::move(other.ruleset_version_);
     addresses_ = std::move(other.addresses_);
+    rule_count_ = other.rule_count_;
+
+    route_scopes_ = std::move(other.route_scopes_);
+    other.route_scopes_.clear();
+    other_routes_ = other.other_routes_;
+    other.other_routes_ = {};
 
     return *this;
 }
 
 instance::~instance()
 {
+    clear_scopes();
     if (handle_ != nullptr) {
         ddwaf_destroy(handle_);
     }
 }
 
+void instance::rule_count::update(const parameter_view &ruleset)
+{
+    for (const auto &section : ruleset) {
+        if (section.key() == "rules") {
+            rules = section.size();
+        } else if (section.key() == "custom_rules") {
+            custom_rules = section.size();
+        }
+    }
+}
+
+void instance::scope_routes(const parameter_view &ruleset,
+    const ddwaf_config &config, std::map<std::string_view, double> &metrics)
+{
+    rule_count_.update(ruleset);
+
+    auto routes = ruleset_routes(ruleset);
+    if (routes.empty()) {
+        return;
+    }
+
+    if (routes.size() > max_scoped_routes) {
+        SPDLOG_DEBUG("Rules restricted to {} routes, more than {}, they "
+                     "won't be scoped",
+            routes.size(), max_scoped_routes);
+        return;
+    }
+
+    auto compile = [&](std::optional<std::string_view> route) {
+        scope s;
+        auto subset = scope_ruleset(ruleset, route);
+        s.count.update(parameter_view{subset});
+        if (s.count.total() < rule_count_.total()) {
+            s.handle = ddwaf_init(subset, &config, nullptr);
+            if (s.handle == nullptr) {
+                throw invalid_object();
+            }
+        }
+        return s;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        other_routes_ = compile(std::nullopt);
+        for (auto route : routes) {
+            route_scopes_.emplace(std::string{route}, compile(route));
+        }
+    } catch (const std::exception &e) {
+        SPDLOG_WARN("Failed to scope the rules to routes: {}", e.what());
+        clear_scopes();
+        return;
+    }
+
+    SPDLOG_DEBUG("Compiled {} rule scopes in {}us", scope_count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    metrics[tag::waf_rule_scopes] = static_cast<double>(scope_count());
+}
+
+void instance::update_scopes(const instance &previous,
+    const parameter_view &update, std::map<std::string_view, double> &metrics)
+{
+    if (previous.other_routes_.handle == nullptr) {
+        return;
+    }
+
+    // Routes with no scope of their own would get the rules of the others
+    for (auto route : ruleset_routes(update)) {
+        if (previous.route_scopes_.find(route) ==
+            previous.route_scopes_.end()) {
+            SPDLOG_DEBUG("Rules restricted to the new route {}, they won't be "
+                         "scoped anymore",
+                route);
+            return;
+        }
+    }
+
+    bool has_rules = false;
+    for (const auto &section : update) {
+        has_rules = has_rules || is_rules_section(section.key());
+    }
+
+    auto apply = [&](const scope &prev, std::optional<std::string_view> route) {
+        scope s{nullptr, prev.count};
+        if (prev.handle == nullptr) {
+            // Still the whole ruleset
+            s.count = rule_count_;
+            return s;
+        }
+
+        if (!has_rules) {
+            s.handle = ddwaf_update(prev.handle, &update, nullptr);
+        } else {
+            auto subset = scope_ruleset(update, route);
+            s.count.update(parameter_view{subset});
+            s.handle = ddwaf_update(prev.handle, subset, nullptr);
+        }
+        if (s.handle == nullptr) {
+            throw invalid_object();
+        }
+        return s;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        other_routes_ = apply(previous.other_routes_, std::nullopt);
+        for (const auto &[route, prev] : previous.route_scopes_) {
+            route_scopes_.emplace(route, apply(prev, route));
+        }
+    } catch (const std::exception &e) {
+        SPDLOG_WARN(
+            "Failed to update the rules scoped to routes: {}", e.what());
+        clear_scopes();
+        return;
+    }
+
+    SPDLOG_DEBUG("Updated {} rule scopes in {}us", scope_count(),
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    metrics[tag::waf_rule_scopes] = static_cast<double>(scope_count());
+}
+
+void instance::clear_scopes() noexcept
+{
+    for (auto &[route, s] : route_scopes_) {
+        if (s.handle != nullptr) {
+            ddwaf_destroy(s.handle);
+        }
+    }
+    route_scopes_.clear();
+
+    if (other_routes_.handle != nullptr) {
+        ddwaf_destroy(other_routes_.handle);
+    }
+    other_routes_ = {};
+}
+
+std::size_t instance::scope_count() const noexcept
+{
+    std::size_t count = other_routes_.handle != nullptr ? 1 : 0;
+    for (const auto &[route, s] : route_scopes_) {
+        if (s.handle != nullptr) {
+            count++;
+        }
+    }
+    return count;
+}
+
+ddwaf_context instance::init_context(
+    const parameter_view &data, std::size_t &count) const
+{
+    if (other_routes_.handle != nullptr && data.is_map()) {
+        auto uri = find_entry(data, uri_address);
+        if (uri && uri->is_string()) {
+            auto it = route_scopes_.find(std::string_view(*uri));
+            const auto &s =
+                it != route_scopes_.end() ? it->second : other_routes_;
+            if (s.handle != nullptr) {
+                count = s.count.total();
+                return ddwaf_context_init(s.handle);
+            }
+        }
+    }
+
+    // Only reported when the rules are scoped, it's the same for all the
+    // requests otherwise
+    count = other_routes_.handle != nullptr ? rule_count_.total() : 0;
+    return ddwaf_context_init(handle_);
+}
+
 instance::listener::ptr instance::get_listener()
 {
-    return listener::ptr(new listener(
-        ddwaf_context_init(handle_), waf_timeout_, ruleset_version_));
+    std::shared_ptr<listener> pooled;
+    {
+        const std::lock_guard<std::mutex> lock{pool_mtx_};
+        if (!pool_.empty()) {
+            pooled = std::move(pool_.back());
+            pool_.pop_back();
+        }
+    }
+
+    // libddwaf contexts can't be reset, so only the listener is reused. Its
+    // context is created on its first call, see init_context.
+    if (pooled) {
+        return pooled;
+    }
+
+    return std::make_shared<listener>(*this);
+}
+
+void instance::recycle(subscriber::listener::ptr &&released)
+{
+    // Only this instance's listeners are given back to it
+    auto waf_listener = std::static_pointer_cast<listener>(released);
+    released.reset();
+    if (!waf_listener || waf_listener.use_count() > 1) {
+        return;
+    }
+
+    // The context is released right away rather than when the listener is
+    // reused, so pooled listeners hold no WAF memory
+    waf_listener->reset();
+
+    const std::lock_guard<std::mutex> lock{pool_mtx_};
+    if (pool_.size() < max_pooled_listeners) {
+        pool_.emplace_back(std::move(waf_listener));
+    }
 }
 
 instance::instance(
@@ -335,8 +787,12 @@ subscriber::ptr instance::update(parameter &rule,
         throw invalid_object();
     }
 
-    return subscriber::ptr(
+    auto updated = std::shared_ptr<instance>(
         new instance(new_handle, waf_timeout_, std::move(version)));
+    updated->rule_count_ = rule_count_;
+    updated->rule_count_.update(parameter_view{rule});
+    updated->update_scopes(*this, parameter_view{rule}, metrics);
+    return updated;
 }
 
 instance::ptr instance::from_settings(const engine_settings &settings,
@@ -346,18 +802,22 @@ instance::ptr instance::from_settings(const engine_settings &settings,
     dds::parameter param = json_to_parameter(ruleset.get_document());
     return std::make_shared<instance>(param, meta, metrics,
         settings.waf_timeout_us, settings.obfuscator_key_regex,
-        settings.obfuscator_value_regex);
+        settings.obfuscator_value_regex, settings.waf_route_scoping);
 }
 
 instance::ptr instance::from_string(std::string_view rule,
     std::map<std::string, std::string> &meta,
     std::map<std::string_view, double> &metrics, std::uint64_t waf_timeout_us,
-    std::string_view key_regex, std::string_view value_regex)
+    std::string_view key_regex, std::string_view value_regex,
+    bool route_scoping)
 {
-    engine_ruleset const ruleset{rule};
-    dds::parameter param = json_to_parameter(ruleset.get_document());
-    return std::make_shared<instance>(
-        param, meta, metrics, waf_timeout_us, key_regex, value_regex);
+    // Built straight from the string, without a document
+    dds::parameter param = json_to_parameter(rule);
+    if (param.type() != parameter_type::map) {
+        throw parsing_error("invalid json rule");
+    }
+    return std::make_shared<instance>(param, meta, metrics, waf_timeout_us,
+        key_regex, value_regex, route_scoping);
 }
 
 } // namespace dds::waf
@@ -7,14 +7,18 @@
 
 #include <chrono>
 #include <ddwaf.h>
+#include <map>
+#include <mutex>
 #include <spdlog/spdlog.h>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "../engine.hpp"
 #include "../engine_ruleset.hpp"
 #include "../exception.hpp"
 #include "../parameter.hpp"
+#include "../parameter_view.hpp"
 
 namespace dds::waf {
 
@@ -29,6 +33,9 @@ public:
     public:
         listener(ddwaf_context ctx, std::chrono::microseconds waf_timeout,
             std::string_view ruleset_version = std::string_view());
+        // The WAF context is only created on the first call, with the rules
+        // of the route of the request
+        explicit listener(const instance &owner);
         listener(const listener &) = delete;
         listener &operator=(const listener &) = delete;
         listener(listener &&) noexcept;
@@ -36,24 +43,37 @@ public:
         ~listener() override;
 
         std::optional<event> call(dds::parameter_view &data) override;
+        // Runs for at most the remaining budget, skips the run if there's
+        // nothing left of it
+        std::optional<event> call(
+            dds::parameter_view &data, time_budget *budget) override;
 
         // NOLINTNEXTLINE(google-runtime-references)
         void get_meta_and_metrics(std::map<std::string, std::string> &meta,
             std::map<std::string_view, double> &metrics) override;
 
+        // Starts over with a new context, or none
+        void reset(ddwaf_context ctx = nullptr);
+
     protected:
         ddwaf_context handle_{};
         std::chrono::microseconds waf_timeout_;
         double total_runtime_{0.0};
         std::string_view ruleset_version_;
+        const instance *owner_{nullptr};
+        // rules of the context, 0 unless they are scoped to routes
+        std::size_t rule_count_{0};
     };
 
+    // With route_scoping, the rules restricted to some routes are compiled
+    // apart, see scope_routes.
     // NOLINTNEXTLINE(google-runtime-references)
     instance(dds::parameter &rule, std::map<std::string, std::string> &meta,
         std::map<std::string_view, double> &metrics,
         std::uint64_t waf_timeout_us,
         std::string_view key_regex = std::string_view(),
-        std::string_view value_regex = std::string_view());
+        std::string_view value_regex = std::string_view(),
+        bool route_scoping = false);
     instance(const instance &) = delete;
     instance &operator=(const instance &) = delete;
     instance(instance &&) noexcept;
@@ -62,12 +82,17 @@ public:
 
     std::string_view get_name() override { return "waf"sv; }
 
+    // The rules only look at the data of the request, rule data updates
+    // result in a new instance
+    bool is_stateless() override { return true; }
+
     std::unordered_set<std::string> get_subscriptions() override
     {
         return addresses_;
     }
 
     listener::ptr get_listener() override;
+    void recycle(subscriber::listener::ptr &&released) override;
 
     subscriber::ptr update(parameter &rule,
         std::map<std::string, std::string> &meta,
@@ -83,16 +108,72 @@ public:
         std::map<std::string_view, double> &metrics,
         std::uint64_t waf_timeout_us = default_waf_timeout_us,
         std::string_view key_regex = std::string_view(),
-        std::string_view value_regex = std::string_view());
+        std::string_view value_regex = std::string_view(),
+        bool route_scoping = false);
 
 protected:
     instance(ddwaf_handle handle, std::chrono::microseconds timeout,
         std::string version);
 
+    // Rules of the ruleset, or of a subset of it, by section
+    struct rule_count {
+        std::size_t rules{0};
+        std::size_t custom_rules{0};
+
+        [[nodiscard]] std::size_t total() const
+        {
+            return rules + custom_rules;
+        }
+        // The counts of the sections of the ruleset, the others are kept
+        void update(const parameter_view &ruleset);
+    };
+
+    // The rules which can match on some routes only
+    struct scope {
+        // null when no rule is left out, the whole ruleset is used then
+        ddwaf_handle handle{nullptr};
+        rule_count count;
+    };
+
+    // Compiles a subset of the ruleset for each route to which some rules
+    // are restricted, and one for all the other routes
+    void scope_routes(const parameter_view &ruleset,
+        const ddwaf_config &config,
+        std::map<std::string_view, double> &metrics);
+    // Applies the update to the scopes of the previous instance, if the
+    // routes it restricts rules to are all known
+    void update_scopes(const instance &previous, const parameter_view &update,
+        std::map<std::string_view, double> &metrics);
+    void clear_scopes() noexcept;
+    // The compiled rulesets held besides the whole one
+    [[nodiscard]] std::size_t scope_count() const noexcept;
+
+    // A context with the rules which can match on the route of the data,
+    // all of them if it doesn't have the route
+    ddwaf_context init_context(
+        const parameter_view &data, std::size_t &count) const;
+
+    // More than this many requests at once is unlikely for a single helper
+    static constexpr std::size_t max_pooled_listeners = 64;
+    // Each route costs a compiled ruleset, beyond this many the requests
+    // are evaluated against the whole ruleset
+    static constexpr std::size_t max_scoped_routes = 16;
+
     ddwaf_handle handle_{nullptr};
     std::chrono::microseconds waf_timeout_;
     std::string ruleset_version_;
     std::unordered_set<std::string> addresses_;
+    rule_count rule_count_;
+
+    // By raw URI, empty unless the rules are scoped
+    std::map<std::string, scope, std::less<>> route_scopes_;
+    scope other_routes_;
+
+    // Listeners of past requests, without their WAF context. As the rules
+    // of an instance never change, neither do its listeners, so they can be
+    // shared by all the requests using the instance.
+    std::mutex pool_mtx_;
+    std::vector<std::shared_ptr<listener>> pool_;
 };
 
 parameter parse_file(std::string_view filename);
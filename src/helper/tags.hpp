@@ -19,5 +19,33 @@ constexpr std::string_view event_rules_version =
 
 constexpr std::string_view waf_version = "_dd.appsec.waf.version";
 constexpr std::string_view waf_duration = "_dd.appsec.waf.duration";
+// set when the WAF used up the time budget of the request
+constexpr std::string_view waf_request_budget_exhausted =
+    "_dd.appsec.waf.request_budget_exhausted";
+constexpr std::string_view waf_skipped_runs = "_dd.appsec.waf.skipped_runs";
+// publishes whose verdict was found on the verdict cache
+constexpr std::string_view waf_cache_hits = "_dd.appsec.waf.cache_hits";
+// rules the request was evaluated against when some of them are restricted to
+// routes, fewer than all of them unless the request is to one of those
+constexpr std::string_view waf_rules_evaluated =
+    "_dd.appsec.waf.rules_evaluated";
+// rulesets compiled for subsets of the rules restricted to routes, on top of
+// the whole one, only reported when the rules are scoped
+constexpr std::string_view waf_rule_scopes = "_dd.appsec.waf.rule_scopes";
+// values of the request cut short to the limits of the WAF while decoding
+constexpr std::string_view waf_truncated_values =
+    "_dd.appsec.waf.truncated_values";
+
+// time spent by the helper on each stage of the commands of a request
+constexpr std::string_view helper_recv_duration =
+    "_dd.appsec.helper.recv_duration";
+constexpr std::string_view helper_decode_duration =
+    "_dd.appsec.helper.decode_duration";
+constexpr std::string_view helper_publish_duration =
+    "_dd.appsec.helper.publish_duration";
+constexpr std::string_view helper_format_duration =
+    "_dd.appsec.helper.format_duration";
+constexpr std::string_view helper_send_duration =
+    "_dd.appsec.helper.send_duration";
 
 } // namespace dds::tag
@@ -0,0 +1,29 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+// USDT probes for SystemTap, bpftrace and the like, under the ddappsec
+// provider. With DD_APPSEC_ENABLE_USDT they are a nop until a tracer attaches
+// to them; otherwise they're compiled out and their arguments not evaluated.
+//
+//   conn_accept(clients)                  a connection was accepted
+//   msg_recv(size)                        a message body was read
+//   msg_decoded(request_id)               the message was unpacked
+//   waf_run_begin(addresses)              before running the WAF
+//   waf_run_end(code, timeout, runtime_ns)
+//   msg_sent(size, ok)                    a response was written
+//
+// e.g. bpftrace -e 'usdt:./ddappsec-helper:ddappsec:waf_run_end
+//                   { @[arg1] = hist(arg2); }'
+
+#ifdef DD_APPSEC_USDT
+#    include <sys/sdt.h>
+#    define DD_TRACEPOINT(name, ...) STAP_PROBEV(ddappsec, name, __VA_ARGS__)
+#else
+#    define DD_TRACEPOINT(name, ...)                                           \
+        do {                                                                   \
+        } while (0)
+#endif
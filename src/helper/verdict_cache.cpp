@@ -0,0 +1,181 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "verdict_cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace dds {
+
+namespace {
+
+constexpr uint64_t rotl(uint64_t x, unsigned b) noexcept
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+    return (x << b) | (x >> (64 - b));
+}
+
+template <typename T> void update(siphash &h, T value) noexcept
+{
+    h.update(&value, sizeof(value));
+}
+
+// Hashes the type, key and value of every node, so that e.g. the same
+// strings in different containers don't hash the same
+// NOLINTNEXTLINE(misc-no-recursion)
+void hash_node(siphash &h, const parameter_view &pv) noexcept
+{
+    update(h, static_cast<unsigned>(pv.type()));
+    auto key = pv.key();
+    update(h, key.size());
+    h.update(key.data(), key.size());
+
+    switch (pv.type()) {
+    case parameter_type::string:
+        update(h, pv.length());
+        h.update(pv.stringValue, pv.length());
+        break;
+    case parameter_type::int64:
+        update(h, pv.intValue);
+        break;
+    case parameter_type::uint64:
+        update(h, pv.uintValue);
+        break;
+    case parameter_type::boolean:
+        update(h, pv.boolean);
+        break;
+    case parameter_type::map:
+    case parameter_type::array:
+        update(h, pv.size());
+        for (const auto &child : pv) { hash_node(h, child); }
+        break;
+    default:
+        break;
+    }
+}
+
+} // namespace
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+siphash::siphash(uint64_t k0, uint64_t k1) noexcept
+    : v_{0x736f6d6570736575ULL ^ k0, 0x646f72616e646f6dULL ^ k1,
+          0x6c7967656e657261ULL ^ k0, 0x7465646279746573ULL ^ k1}
+{}
+
+void siphash::round() noexcept
+{
+    v_[0] += v_[1];
+    v_[1] = rotl(v_[1], 13);
+    v_[1] ^= v_[0];
+    v_[0] = rotl(v_[0], 32);
+    v_[2] += v_[3];
+    v_[3] = rotl(v_[3], 16);
+    v_[3] ^= v_[2];
+    v_[0] += v_[3];
+    v_[3] = rotl(v_[3], 21);
+    v_[3] ^= v_[0];
+    v_[2] += v_[1];
+    v_[1] = rotl(v_[1], 17);
+    v_[1] ^= v_[2];
+    v_[2] = rotl(v_[2], 32);
+}
+
+void siphash::compress(uint64_t m) noexcept
+{
+    v_[3] ^= m;
+    round();
+    round();
+    v_[0] ^= m;
+}
+
+void siphash::update(const void *data, std::size_t size) noexcept
+{
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    total_size_ += size;
+
+    // Complete the word started by the previous update
+    while (tail_size_ > 0 && size > 0) {
+        tail_ |= static_cast<uint64_t>(*bytes++) << (8 * tail_size_);
+        size--;
+        if (++tail_size_ == sizeof(uint64_t)) {
+            compress(tail_);
+            tail_ = 0;
+            tail_size_ = 0;
+        }
+    }
+
+    // Little-endian platforms only, as the rest of the helper
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+        uint64_t m;
+        memcpy(&m, bytes, sizeof(m));
+        compress(m);
+        bytes += sizeof(m);
+    }
+
+    for (; size > 0; size--) {
+        tail_ |= static_cast<uint64_t>(*bytes++) << (8 * tail_size_++);
+    }
+}
+
+uint64_t siphash::finish() noexcept
+{
+    compress(tail_ | (total_size_ << 56));
+    v_[2] ^= 0xff;
+    round();
+    round();
+    round();
+    round();
+    return v_[0] ^ v_[1] ^ v_[2] ^ v_[3];
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+
+verdict_cache::verdict_cache(std::size_t capacity, std::chrono::seconds ttl)
+    : ttl_(ttl)
+{
+    auto entries_per_shard = std::max<std::size_t>(capacity / shard_count, 1);
+    for (auto &s : shards_) { s.entries.resize(entries_per_shard); }
+
+    // A key of its own for each cache, so hashes can't be predicted
+    std::random_device rd;
+    std::uniform_int_distribution<uint64_t> dist;
+    k0_ = dist(rd);
+    k1_ = dist(rd);
+}
+
+uint64_t verdict_cache::key(uint64_t previous, uint64_t generation,
+    const parameter_view &data) const noexcept
+{
+    siphash h{k0_, k1_};
+    update(h, previous);
+    update(h, generation);
+    hash_node(h, data);
+    return h.finish();
+}
+
+bool verdict_cache::contains(uint64_t key)
+{
+    auto &s = shards_[key % shard_count];
+    bool found;
+    {
+        const std::lock_guard<std::mutex> lock{s.mtx};
+        const auto &e = slot(s, key);
+        found = e.key == key && e.expires > std::chrono::steady_clock::now();
+    }
+
+    (found ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    return found;
+}
+
+void verdict_cache::insert(uint64_t key)
+{
+    auto &s = shards_[key % shard_count];
+    const std::lock_guard<std::mutex> lock{s.mtx};
+    auto &e = slot(s, key);
+    e.key = key;
+    e.expires = std::chrono::steady_clock::now() + ttl_;
+}
+
+} // namespace dds
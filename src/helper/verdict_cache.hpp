@@ -0,0 +1,97 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include "parameter_view.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dds {
+
+// SipHash-2-4, fed incrementally. Being keyed, collisions can't be crafted
+// without knowing the key.
+class siphash {
+public:
+    siphash(uint64_t k0, uint64_t k1) noexcept;
+
+    void update(const void *data, std::size_t size) noexcept;
+    [[nodiscard]] uint64_t finish() noexcept;
+
+protected:
+    void compress(uint64_t m) noexcept;
+    void round() noexcept;
+
+    std::array<uint64_t, 4> v_;
+    uint64_t tail_{0};
+    std::size_t tail_size_{0};
+    uint64_t total_size_{0};
+};
+
+// Remembers the requests on which running the subscribers found nothing, so
+// that byte-identical requests (health checks, static assets, polling...) can
+// skip the WAF. Entries are keyed by a hash of all the data published on the
+// request so far, expire after a TTL and the cache never grows beyond its
+// capacity: each key maps to a single slot, so a new entry replaces the one
+// it collides with.
+class verdict_cache {
+public:
+    using ptr = std::shared_ptr<verdict_cache>;
+
+    struct stats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+    };
+
+    verdict_cache(std::size_t capacity, std::chrono::seconds ttl);
+
+    // Key of the data published on a request, from the key of what was
+    // published before on it (0 if nothing) and the generation of the rules
+    [[nodiscard]] uint64_t key(uint64_t previous, uint64_t generation,
+        const parameter_view &data) const noexcept;
+
+    // Whether nothing was found on the data with this key, within the TTL
+    bool contains(uint64_t key);
+    void insert(uint64_t key);
+
+    [[nodiscard]] stats get_stats() const noexcept
+    {
+        return {hits_.load(std::memory_order_relaxed),
+            misses_.load(std::memory_order_relaxed)};
+    }
+
+protected:
+    struct entry {
+        uint64_t key{0};
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    // Locking a shard rather than the whole cache keeps contention low
+    struct shard {
+        std::mutex mtx;
+        std::vector<entry> entries;
+    };
+
+    static constexpr std::size_t shard_count = 16;
+
+    entry &slot(shard &s, uint64_t key) const noexcept
+    {
+        return s.entries[(key / shard_count) % s.entries.size()];
+    }
+
+    std::array<shard, shard_count> shards_;
+    std::chrono::seconds ttl_;
+    uint64_t k0_;
+    uint64_t k1_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+} // namespace dds
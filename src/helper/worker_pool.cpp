@@ -59,4 +59,25 @@ bool pool::launch(runnable &&f)
     return true;
 }
 
+bool pool::launch(runnable &&f, unsigned max_workers)
+{
+    if (!q_.running()) {
+        return false;
+    }
+
+    if (q_.push(f)) {
+        return true;
+    }
+
+    // Checked and reserved at once, so that concurrent launches can't go
+    // beyond max_workers
+    auto consumer = queue_consumer::acquire(q_, max_workers);
+    if (!consumer) {
+        return false;
+    }
+
+    std::thread(work_handler, std::move(*consumer), std::move(f)).detach();
+    return true;
+}
+
 } // namespace dds::worker
@@ -37,7 +37,11 @@ public:
         return running_.load(std::memory_order_relaxed);
     }
 
-    [[nodiscard]] unsigned ref_count() const { return rc_.count; }
+    [[nodiscard]] unsigned ref_count() const
+    {
+        std::lock_guard<std::mutex> const lock(rc_.mtx);
+        return rc_.count;
+    }
 
     // NOLINTNEXTLINE(google-runtime-references)
     bool push(runnable &data);
@@ -51,7 +55,8 @@ public:
 
 protected:
     struct refcount {
-        std::mutex mtx;
+        // Mutable so that the count can be read from const members
+        mutable std::mutex mtx;
         std::condition_variable cv;
         unsigned count{0};
     } rc_;
@@ -101,6 +106,20 @@ public:
 
     queue_consumer &operator=(queue_consumer &&) = delete;
 
+    // Only registers a new consumer if there are fewer than max_count, the
+    // check and the registration are done under the same lock
+    // NOLINTNEXTLINE(google-runtime-references)
+    static std::optional<queue_consumer> acquire(
+        queue_producer &pq, unsigned max_count)
+    {
+        std::unique_lock<std::mutex> const lock(pq.rc_.mtx);
+        if (pq.rc_.count >= max_count) {
+            return std::nullopt;
+        }
+        ++pq.rc_.count;
+        return queue_consumer(pq, adopt_count{});
+    }
+
     [[nodiscard]] bool running()
     {
         return running_.load(std::memory_order_relaxed);
@@ -129,6 +148,12 @@ public:
     }
 
 protected:
+    // The consumer was already counted by whoever constructs it
+    struct adopt_count {};
+    queue_consumer(queue_producer &pq, adopt_count /*unused*/)
+        : rc_(pq.rc_), running_(pq.running_), q_(pq.q_)
+    {}
+
     bool was_moved_from_{false};
     queue_producer::refcount &rc_;
     std::atomic<bool> &running_;
@@ -149,6 +174,9 @@ public:
     pool &operator=(pool &&) = delete;
 
     bool launch(runnable &&f);
+    // Only starts a new worker if there are fewer than max_workers, returns
+    // false if there are as many and none of them is idle
+    bool launch(runnable &&f, unsigned max_workers);
 
     void wait() { q_.wait(); }
     void stop() { q_.stop(); }
@@ -0,0 +1,221 @@
+<?php
+// Measures the time and memory the extension adds to each request on the
+// RINIT, request_exec and RSHUTDOWN paths, against the mock helper, for
+// requests with varying numbers of headers and cookies and body sizes.
+//
+// Run it with the extension loaded (it's only used to find the socket the
+// extension will connect to), e.g. through the xbench target:
+//
+//   php -d extension=ddappsec.so bench_extension.php \
+//       --php-cgi=/usr/bin/php-cgi --extension=/path/to/ddappsec.so \
+//       --mock-helper=/path/to/mock_helper [--iterations=1000] \
+//       [--warmup=50] [--filter=cookies]
+//
+// The lifecycle runs through the testing functions, in a loop within a
+// single request. The testing rshutdown does the same per-request cleanup as
+// the real RSHUTDOWN, so the headers are collected again on every iteration.
+//
+// Memory is measured with memory_get_usage(), i.e. it only covers the Zend
+// memory manager. Allocations made with the system malloc (e.g. by mpack
+// while encoding messages) aren't included.
+
+require __DIR__ . '/../extension/inc/mock_helper.php';
+
+const RUNTIME_PATH = '/tmp/appsec-ext-bench';
+
+$opts = getopt('', ['php-cgi:', 'extension:', 'mock-helper:', 'iterations:',
+    'warmup:', 'filter:']);
+foreach (['php-cgi', 'extension', 'mock-helper'] as $required) {
+    if (!isset($opts[$required])) {
+        fwrite(STDERR, "Missing --$required\n");
+        exit(1);
+    }
+}
+if (!extension_loaded('ddappsec')) {
+    fwrite(STDERR, "The ddappsec extension must be loaded\n");
+    exit(1);
+}
+$iterations = (int)($opts['iterations'] ?? 1000);
+$warmup = (int)($opts['warmup'] ?? 50);
+
+// Each scenario changes one dimension of the base request
+$base = ['headers' => 10, 'cookies' => 2, 'body' => 0];
+$scenarios = [
+    'base' => [],
+    'headers=50' => ['headers' => 50],
+    'headers=200' => ['headers' => 200],
+    'cookies=20' => ['cookies' => 20],
+    'cookies=100' => ['cookies' => 100],
+    'body=4KiB' => ['body' => 4096],
+    'body=64KiB' => ['body' => 65536],
+];
+
+function request_env(array $scenario, $body_len) {
+    $env = [
+        'PATH' => getenv('PATH'),
+        'REQUEST_METHOD' => 'POST',
+        'REQUEST_URI' => '/bench/request?id=1234',
+        'QUERY_STRING' => 'id=1234',
+        'REMOTE_ADDR' => '203.0.113.7',
+        'CONTENT_TYPE' => 'application/x-www-form-urlencoded',
+        'CONTENT_LENGTH' => (string)$body_len,
+        'HTTP_HOST' => 'bench.example.com',
+        'HTTP_USER_AGENT' => 'bench_extension/1.0',
+        'HTTP_ACCEPT' => 'text/html,application/json',
+    ];
+    // Host, User-Agent and Accept count towards the headers
+    for ($i = 0; $i < $scenario['headers'] - 3; $i++) {
+        $env["HTTP_X_BENCH_HEADER_$i"] = str_repeat(chr(ord('a') + $i % 26), 32);
+    }
+    $cookies = [];
+    for ($i = 0; $i < $scenario['cookies']; $i++) {
+        $cookies[] = "cookie$i=" . str_repeat('c', 24);
+    }
+    if ($cookies) {
+        $env['HTTP_COOKIE'] = implode('; ', $cookies);
+    }
+    return $env;
+}
+
+function request_body($size) {
+    $fields = [];
+    $len = 0;
+    for ($i = 0; $len < $size; $i++) {
+        $field = "field$i=" . str_repeat('v', 58);
+        $fields[] = $field;
+        $len += strlen($field) + 1;
+    }
+    return substr(implode('&', $fields), 0, $size);
+}
+
+function start_mock_helper($mock_helper) {
+    @mkdir(RUNTIME_PATH, 0777, true);
+    $sock_path = RUNTIME_PATH . '/ddappsec_' . phpversion('ddappsec') . '_' .
+        getmyuid() . '.' . getmygid() . '.sock';
+
+    $empty_obj = new ArrayObject();
+    $responses = [
+        response_list(response_client_init(
+            ['ok', phpversion('ddappsec'), [], $empty_obj, $empty_obj])),
+        response_list(response_request_init(['ok', []])),
+        response_list(response_request_exec(['ok', []])),
+        response_list(response_request_shutdown(
+            ['ok', [], $empty_obj, $empty_obj])),
+    ];
+    $cmd = escapeshellarg($mock_helper) . ' --quiet --cycle 3';
+    foreach ($responses as $response) {
+        $cmd .= ' ' . escapeshellarg(json_encode($response));
+    }
+
+    $descriptors = [
+        0 => ['pipe', 'r'],
+        1 => ['file', '/dev/null', 'w'],
+        2 => ['file', STDERR_PATH, 'w+'],
+        3 => Helper::listen($sock_path),
+        4 => ['pipe', 'w'], // echo of the messages received
+    ];
+    $proc = proc_open($cmd, $descriptors, $pipes);
+    if (!is_resource($proc)) {
+        fwrite(STDERR, "Failed to start the mock helper\n");
+        exit(1);
+    }
+    return [$proc, $pipes];
+}
+
+function run_scenario(array $opts, array $scenario, $iterations, $warmup) {
+    [$helper, $helper_pipes] = start_mock_helper($opts['mock-helper']);
+
+    $body = request_body($scenario['body']);
+    $env = request_env($scenario, strlen($body));
+    $env['BENCH_ITERATIONS'] = (string)$iterations;
+    $env['BENCH_WARMUP'] = (string)$warmup;
+
+    $cmd = implode(' ', array_map('escapeshellarg', [
+        $opts['php-cgi'], '-n', '-q',
+        '-d', 'extension=' . $opts['extension'],
+        '-d', 'datadog.appsec.enabled=1',
+        '-d', 'datadog.appsec.testing=1',
+        '-d', 'datadog.appsec.helper_launch=0',
+        '-d', 'datadog.appsec.helper_runtime_path=' . RUNTIME_PATH,
+        '-d', 'datadog.appsec.rules=/dev/null',
+        '-d', 'datadog.appsec.log_level=off',
+        '-d', 'post_max_size=16M',
+        '-d', 'max_input_vars=100000',
+        __DIR__ . '/request_loop.php',
+    ]));
+    $php = proc_open($cmd,
+        [0 => ['pipe', 'r'], 1 => ['pipe', 'w'], 2 => ['pipe', 'w']],
+        $php_pipes, null, $env);
+    fwrite($php_pipes[0], $body);
+    fclose($php_pipes[0]);
+
+    // The mock helper blocks if what it echoes isn't read
+    $output = '';
+    $errors = '';
+    $open = [$php_pipes[1], $php_pipes[2], $helper_pipes[4]];
+    while (in_array($php_pipes[1], $open, true) ||
+        in_array($php_pipes[2], $open, true)) {
+        $read = $open;
+        $write = $except = null;
+        if (stream_select($read, $write, $except, 1) === false) {
+            break;
+        }
+        foreach ($read as $stream) {
+            $data = fread($stream, 65536);
+            if ($data === '' || $data === false) {
+                if (feof($stream)) {
+                    $open = array_values(array_filter($open,
+                        function ($s) use ($stream) { return $s !== $stream; }));
+                }
+                continue;
+            }
+            if ($stream === $php_pipes[1]) {
+                $output .= $data;
+            } else if ($stream === $php_pipes[2]) {
+                $errors .= $data;
+            }
+        }
+    }
+    proc_close($php);
+
+    // closing the echo pipe makes the mock helper exit
+    fclose($helper_pipes[4]);
+    fclose($helper_pipes[0]);
+    proc_close($helper);
+
+    $result = json_decode($output, true);
+    if (!is_array($result)) {
+        fwrite(STDERR, "Unexpected output from php-cgi:\n$output\n$errors\n");
+        exit(1);
+    }
+    return $result;
+}
+
+function percentile(array $values, $p) {
+    sort($values);
+    $rank = max(1, (int)ceil($p / 100 * count($values)));
+    return $values[$rank - 1];
+}
+
+echo "Memory figures only cover the Zend memory manager (emalloc)\n\n";
+printf("%-12s %-13s %9s %9s %12s %12s\n", 'scenario', 'phase', 'p50 us',
+    'p99 us', 'retained B', 'peak B');
+foreach ($scenarios as $name => $overrides) {
+    if (isset($opts['filter']) && strpos($name, $opts['filter']) === false) {
+        continue;
+    }
+    $result = run_scenario($opts, array_merge($base, $overrides),
+        $iterations, $warmup);
+    foreach ($result['phases'] as $phase => $samples) {
+        $ns = array_column($samples, 0);
+        $retained = array_column($samples, 1);
+        $peak = array_filter(array_column($samples, 2), 'is_int');
+        printf("%-12s %-13s %9.1f %9.1f %12d %12s\n", $name, $phase,
+            percentile($ns, 50) / 1000, percentile($ns, 99) / 1000,
+            percentile($retained, 50),
+            $peak ? (string)percentile($peak, 50) : 'n/a');
+    }
+    if ($result['failures'] > 0) {
+        printf("%-12s %d calls failed\n", $name, $result['failures']);
+    }
+}
@@ -0,0 +1,50 @@
+<?php
+// Runs the extension's request lifecycle in a loop within a single php-cgi
+// request, so that the headers, cookies and body php-cgi parsed are the ones
+// the extension reads on every iteration. Prints the measurements as JSON.
+
+use function datadog\appsec\testing\{rinit,request_exec,rshutdown};
+
+$iterations = (int)getenv('BENCH_ITERATIONS');
+$warmup = (int)getenv('BENCH_WARMUP');
+$can_reset_peak = function_exists('memory_reset_peak_usage');
+
+$exec_data = [
+    'server.request.path_params' => ['id' => '1234', 'slug' => 'bench'],
+    'usr.id' => 'bench-user',
+];
+
+$phases = ['rinit' => [], 'request_exec' => [], 'rshutdown' => []];
+$failures = 0;
+
+$measure = function (callable $f, array &$samples, $record) use (
+    $can_reset_peak, &$failures) {
+    if ($can_reset_peak) {
+        memory_reset_peak_usage();
+    }
+    $mem = memory_get_usage();
+    $start = hrtime(true);
+    $res = $f();
+    $ns = hrtime(true) - $start;
+    if ($res === false) {
+        $failures++;
+    }
+    if ($record) {
+        $samples[] = [
+            $ns,
+            memory_get_usage() - $mem,
+            $can_reset_peak ? memory_get_peak_usage() - $mem : null,
+        ];
+    }
+};
+
+for ($i = 0; $i < $warmup + $iterations; $i++) {
+    $record = $i >= $warmup;
+    $measure(function () { return rinit(); }, $phases['rinit'], $record);
+    $measure(function () use ($exec_data) { return request_exec($exec_data); },
+        $phases['request_exec'], $record);
+    $measure(function () { return rshutdown(); }, $phases['rshutdown'],
+        $record);
+}
+
+echo json_encode(['phases' => $phases, 'failures' => $failures]);
@@ -1,3 +1,4 @@
+#include "hdr_histogram.hpp"
 #include "mpack-common.h"
 #include "mpack-reader.h"
 #include "mpack-writer.h"
@@ -20,16 +21,21 @@
 #include <boost/system/detail/errc.hpp>
 #include <boost/system/detail/error_code.hpp>
 #include <chrono>
+#include <deque>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <mpack.h>
 #include <random>
 #include <regex>
 #include <spdlog/sinks/stdout_sinks.h>
 #include <spdlog/spdlog.h>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <tuple>
 #include <utility>
 
 namespace po = boost::program_options;
@@ -107,6 +113,7 @@ static constexpr int default_concurrent_clients = 20;
 static constexpr int default_req_per_client = 50;
 static constexpr ::CmdlineDuration<std::milli> default_delay{200};   // NOLINT
 static constexpr ::CmdlineDuration<> default_duration{60};           // NOLINT
+static constexpr ::CmdlineDuration<std::milli> default_interval{5000}; // NOLINT
 static const std::string default_socket{"/tmp/ddappsec.sock"};       // NOLINT
 static const std::string default_output{"bench_timings.bin"};        // NOLINT
 static const std::string default_payload{"payload.msgpack"};         // NOLINT
@@ -116,6 +123,10 @@ static constexpr std::uint64_t waf_timeout_us = 10000;
 static constexpr std::uint32_t trace_rate_limit = 0; // disabled
 static constexpr int max_simultaneous_connects = 5;
 
+// latencies are recorded in microseconds, from 1 us to 1 min
+static constexpr std::uint64_t histogram_max_us = 60000000;
+static constexpr int histogram_significant_digits = 3;
+
 namespace mpack {
 std::string read_string(mpack_reader_t *r, mpack_tag_t tag)
 {
@@ -152,6 +163,81 @@ private:
     asio::deadline_timer timer_;
 };
 
+using time_point = std::chrono::steady_clock::time_point;
+
+// request is request_init + request_shutdown, measured from the time the
+// request was supposed to start. The other names match the helper messages
+enum class Command {
+    client_init,
+    request_init,
+    request_exec,
+    request_shutdown,
+    config_sync,
+    request
+};
+static constexpr std::array<const char *, 6> command_names{"client_init",
+    "request_init", "request_exec", "request_shutdown", "config_sync",
+    "request"};
+
+// The layout of the capture files written by the helper when started with
+// --capture_path (see src/helper/network/capture.hpp)
+static constexpr std::string_view capture_file_magic{"DDCAPT1\n"};
+struct CaptureRecordHeader {
+    uint64_t time_us;
+    uint32_t connection_id;
+    uint32_t size;
+} __attribute__((packed));
+
+// A captured message, with the time it was received relative to the start
+// of the capture. The body is the msgpack message ([method, [args...]])
+struct ReplayMessage {
+    std::chrono::microseconds offset;
+    Command command;
+    std::string body;
+};
+
+// The messages captured for a connection
+struct ReplaySession {
+    std::vector<ReplayMessage> messages;
+};
+
+std::vector<ReplaySession> load_capture(const std::string &path);
+
+class LatencyStats {
+public:
+    LatencyStats();
+
+    void record(Command cmd, std::chrono::microseconds latency);
+    // prints the percentiles of the latencies recorded since the last call
+    void report_interval(std::chrono::duration<double> elapsed);
+    // prints the percentiles of all the recorded latencies
+    void report_final() const;
+
+private:
+    static void print_histogram(const char *name, const hdr_histogram &hist);
+
+    std::vector<hdr_histogram> interval_;
+    std::vector<hdr_histogram> total_;
+};
+
+// The requests that are due in open-loop mode, along with the time at which
+// they should have started. Idle clients pick them up in FIFO order
+class RequestQueue {
+public:
+    explicit RequestQueue(asio::io_context &context) : timer_{context}
+    {
+        timer_.expires_at(time_point::max());
+    }
+
+    void push(time_point scheduled);
+    time_point pop(const asio::yield_context &yield);
+    [[nodiscard]] std::size_t size() const { return pending_.size(); }
+
+private:
+    std::deque<time_point> pending_;
+    asio::steady_timer timer_;
+};
+
 class Benchmark {
 public:
     explicit Benchmark(const po::variables_map &opt_vm);
@@ -162,41 +248,62 @@ private:
     using yc = asio::yield_context;
     void wait_for_finish();
     void spawn_run(const yc &yield);
-    void client_notify(std::chrono::microseconds req_duration);
+    void spawn_dispatcher(const yc &yield);
+    void spawn_reporter(const yc &yield);
+    void spawn_replay(const yc &yield);
+    void replay_session(const yc &yield, const ReplaySession &session,
+        time_point origin);
+    asio::local::stream_protocol::socket connect(const yc &yield);
+    time_point next_request(const yc &yield, bool &first);
+    void client_notify(Command cmd, std::chrono::microseconds duration);
 
     const std::string rules_file_;
     const int concurrent_clients_;
     const int req_per_client_;
     const std::chrono::milliseconds delay_;
     const std::chrono::seconds duration_;
+    const double rate_;
+    const std::chrono::milliseconds interval_;
+    const double replay_speed_;
     const asio::local::stream_protocol::endpoint sock_endpoint_;
     std::string payload_;
     std::string payload_shutdown_;
+    std::vector<ReplaySession> replay_sessions_;
     std::ofstream os_;
 
     asio::io_context iocontext_;
     ConnectionLimiter limiter_;
+    RequestQueue queue_;
+    LatencyStats stats_;
 
     std::chrono::time_point<std::chrono::steady_clock> start;
 
     uint64_t total_requests_{};
+    uint64_t replay_errors_{};
 };
 
 class Client {
 public:
-    template <typename C>
-    Client(C &&notify, std::string rules_file, int num_requests,
-        std::chrono::milliseconds delay, const std::string &payload, // NOLINT
+    // next_request waits until the client should start a new request and
+    // returns the time at which that request was due
+    template <typename C, typename N>
+    Client(C &&notify, N &&next_request, std::string rules_file,
+        int num_requests, const std::string &payload, // NOLINT
         const std::string &payload_shutdown,
-        asio::local::stream_protocol::socket &&sock,
-        asio::io_context &iocontext, asio::yield_context yc)
+        asio::local::stream_protocol::socket &&sock, asio::yield_context yc)
         : id_{++next_client_id}, notify_{std::forward<C>(notify)},
+          next_request_{std::forward<N>(next_request)},
           rules_file_{std::move(rules_file)}, requests_left_{num_requests},
-          delay_{delay}, payload_{payload}, payload_shutdown_{payload_shutdown},
-          sock_{std::move(sock)}, iocontext_{iocontext}, yc_{std::move(yc)}
+          payload_{payload}, payload_shutdown_{payload_shutdown},
+          sock_{std::move(sock)}, yc_{std::move(yc)}
     {}
 
     void run();
+    // Sends the messages of a capture session in order, each no earlier
+    // than the time given by schedule(offset). Returns the number of error
+    // responses
+    template <typename S>
+    uint64_t replay(const std::vector<ReplayMessage> &messages, S &&schedule);
 
 private:
     struct Header {
@@ -219,16 +326,15 @@ private:
     template <typename Function> std::string read_helper_response(Function &&f);
 
     uint64_t id_;
-    std::function<void(std::chrono::microseconds)> notify_;
+    std::function<void(Command, std::chrono::microseconds)> notify_;
+    std::function<time_point()> next_request_;
     const std::string rules_file_;
     int requests_left_;
-    const std::chrono::milliseconds delay_;
     const std::string &payload_;
     const std::string &payload_shutdown_;
 
     boost::beast::basic_stream<asio::local::stream_protocol> sock_;
 
-    asio::io_context &iocontext_;
     asio::yield_context yc_;
 };
 
@@ -249,13 +355,25 @@ int main(int argc, char **argv)
         ("output,o",             po::value<std::string>()->default_value(default_output),
                                  "Where to write the timings for each request")
         ("concurrent-clients,c", po::value<int>()->default_value(default_concurrent_clients),
-                                 "The number of concurrent clients")
+                                 "The number of concurrent clients (in open-loop mode, the "
+                                 "maximum number of requests in flight)")
         ("req-per-client,r",     po::value<int>()->default_value(default_req_per_client),
                                  "The number of requests each client simulates")
         ("wait,w",               po::value<::CmdlineDuration<std::milli>>()->default_value(default_delay),
-                                 "How much to wait between each client's request")
+                                 "How much to wait between each client's request (closed-loop mode)")
+        ("rate,R",               po::value<double>()->default_value(0),
+                                 "Run in open-loop mode, starting this many requests per "
+                                 "second regardless of response times (0: closed-loop mode)")
         ("duration,d",           po::value<::CmdlineDuration<>>()->default_value(default_duration),
                                  "How long to run the benchmark")
+        ("interval,i",           po::value<::CmdlineDuration<std::milli>>()->default_value(default_interval),
+                                 "How often to report latency percentiles (0 s: only at the end)")
+        ("replay,P",             po::value<std::string>()->default_value(""),
+                                 "Replay the sessions in a capture file written by the helper "
+                                 "(--capture_path) instead of sending the payloads. Captured "
+                                 "client_init messages are replaced by one using --rules")
+        ("replay-speed,S",       po::value<double>()->default_value(1.0),
+                                 "Replay the capture this many times faster than it was recorded")
         ("verbose,v",            po::bool_switch()->default_value(false),
                                  "Enable verbose logging");
     // clang-format on
@@ -293,14 +411,31 @@ Benchmark::Benchmark(const po::variables_map &opt_vm)
       req_per_client_{opt_vm["req-per-client"].as<int>()},
       delay_{opt_vm["wait"].as<CmdlineDuration<std::milli>>()},
       duration_{opt_vm["duration"].as<CmdlineDuration<>>()},
+      rate_{opt_vm["rate"].as<double>()},
+      interval_{opt_vm["interval"].as<CmdlineDuration<std::milli>>()},
+      replay_speed_{opt_vm["replay-speed"].as<double>()},
       sock_endpoint_{opt_vm["socket"].as<std::string>()},
       os_{opt_vm["output"].as<std::string>(),
           std::ios_base::out | std::ios_base::binary | std::ios_base::trunc},
-      limiter_{iocontext_, max_simultaneous_connects}
+      limiter_{iocontext_, max_simultaneous_connects}, queue_{iocontext_}
 {
     if (!os_.is_open()) {
         throw std::runtime_error{"Could not open output file"};
     }
+    if (rate_ < 0) {
+        throw std::runtime_error{"The request rate cannot be negative"};
+    }
+    if (replay_speed_ <= 0) {
+        throw std::runtime_error{"The replay speed must be positive"};
+    }
+
+    auto replay_file = opt_vm["replay"].as<std::string>();
+    if (!replay_file.empty()) {
+        replay_sessions_ = load_capture(replay_file);
+        SPDLOG_INFO("Loaded {} sessions from {}", // NOLINT
+            replay_sessions_.size(), replay_file);
+        return;
+    }
 
     auto read_payload_file = [&](const std::string &opt) -> std::string {
         auto payload_f = opt_vm[opt].as<std::string>();
@@ -319,9 +454,22 @@ Benchmark::Benchmark(const po::variables_map &opt_vm)
 
 int Benchmark::run()
 {
-    for (int i = 0; i < concurrent_clients_; i++) {
+    if (!replay_sessions_.empty()) {
+        boost::asio::spawn(
+            iocontext_, [this](const yc &yield) { spawn_replay(yield); });
+    } else {
+        for (int i = 0; i < concurrent_clients_; i++) {
+            boost::asio::spawn(
+                iocontext_, [this](const yc &yield) { spawn_run(yield); });
+        }
+    }
+    if (rate_ > 0 && replay_sessions_.empty()) {
         boost::asio::spawn(
-            iocontext_, [this](const yc &yield) { spawn_run(yield); });
+            iocontext_, [this](const yc &yield) { spawn_dispatcher(yield); });
+    }
+    if (interval_.count() > 0) {
+        boost::asio::spawn(
+            iocontext_, [this](const yc &yield) { spawn_reporter(yield); });
     }
 
     start = std::chrono::steady_clock::now();
@@ -343,63 +491,382 @@ int Benchmark::run()
     std::cout << "Average of "
               << (static_cast<double>(total_requests_) / duration_secs)
               << " req/s\n";
+    if (replay_errors_ > 0) {
+        std::cout << replay_errors_ << " replayed messages got an error\n";
+    }
+    if (rate_ > 0 && replay_sessions_.empty()) {
+        std::cout << "Target rate was " << rate_ << " req/s; "
+                  << queue_.size() << " requests were still queued\n";
+    }
+    stats_.report_final();
 
     return 0;
 }
 
+asio::local::stream_protocol::socket Benchmark::connect(const yc &yield)
+{
+    asio::local::stream_protocol::socket sock{iocontext_};
+    sock.open();
+    SPDLOG_DEBUG("Connecting to socket {}", sock_endpoint_.path());
+    error_code ec = limiter_.connect(sock, sock_endpoint_, yield);
+    if (ec.failed()) {
+        throw std::runtime_error{
+            "Connection to endpoint failed: " + ec.message()};
+    }
+    return sock;
+}
+
 void Benchmark::spawn_run(const yc &yield)
 {
     for (;;) {
-        asio::local::stream_protocol::socket sock_{iocontext_};
-        sock_.open();
-        SPDLOG_DEBUG("Connecting to socket {}", sock_endpoint_.path());
-        error_code ec = limiter_.connect(sock_, sock_endpoint_, yield);
-        if (ec.failed()) {
-            throw std::runtime_error{
-                "Connection to endpoint failed: " + ec.message()};
+        bool first = true;
+        Client c{[this](auto cmd, auto dur) { client_notify(cmd, dur); },
+            [this, &yield, &first]() { return next_request(yield, first); },
+            rules_file_, req_per_client_, payload_, payload_shutdown_,
+            connect(yield), yield};
+        c.run();
+    }
+}
+
+// Starts each captured session at its original time (scaled by the replay
+// speed); the messages in a session are then sent no earlier than their
+// original time, but never before the response to the previous one
+void Benchmark::spawn_replay(const yc &yield)
+{
+    auto origin = std::chrono::steady_clock::now();
+    asio::steady_timer timer{iocontext_};
+    for (const auto &session : replay_sessions_) {
+        auto offset = session.messages.front().offset;
+        timer.expires_at(origin + std::chrono::duration_cast<
+                                      std::chrono::steady_clock::duration>(
+                                      offset / replay_speed_));
+        timer.async_wait(yield);
+
+        boost::asio::spawn(iocontext_,
+            [this, &session, origin](const yc &yield) {
+                replay_session(yield, session, origin);
+            });
+    }
+}
+
+void Benchmark::replay_session(
+    const yc &yield, const ReplaySession &session, time_point origin)
+{
+    Client c{[this](auto cmd, auto dur) { client_notify(cmd, dur); },
+        []() { return std::chrono::steady_clock::now(); }, rules_file_, 0,
+        payload_, payload_shutdown_, connect(yield), yield};
+    replay_errors_ +=
+        c.replay(session.messages, [this, origin](auto offset) {
+            return origin +
+                   std::chrono::duration_cast<
+                       std::chrono::steady_clock::duration>(
+                       offset / replay_speed_);
+        });
+}
+
+// Open-loop mode: requests become due at a constant rate, whether or not
+// there are clients available to run them. Latencies are then measured from
+// the time each request became due, so that a stalled helper shows up in the
+// percentiles instead of just lowering the request rate (coordinated
+// omission)
+void Benchmark::spawn_dispatcher(const yc &yield)
+{
+    using clock_duration = std::chrono::steady_clock::duration;
+    auto period = std::chrono::duration_cast<clock_duration>(
+        std::chrono::duration<double>{1.0 / rate_});
+    period = std::max(period, clock_duration{1});
+
+    asio::steady_timer timer{iocontext_};
+    auto next = std::chrono::steady_clock::now();
+    for (;;) {
+        timer.expires_at(next);
+        timer.async_wait(yield);
+
+        // if we woke up late, enqueue everything that is overdue with its
+        // original schedule
+        auto now = std::chrono::steady_clock::now();
+        while (next <= now) {
+            queue_.push(next);
+            next += period;
         }
+    }
+}
 
-        Client c{[this](auto arg) { client_notify(arg); }, rules_file_,
-            req_per_client_, delay_, payload_, payload_shutdown_,
-            std::move(sock_), iocontext_, yield};
-        c.run();
+void Benchmark::spawn_reporter(const yc &yield)
+{
+    asio::steady_timer timer{iocontext_};
+    auto next = std::chrono::steady_clock::now();
+    for (;;) {
+        next += interval_;
+        timer.expires_at(next);
+        timer.async_wait(yield);
+
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        stats_.report_interval(elapsed);
+        if (rate_ > 0) {
+            std::cout << "  queued requests: " << queue_.size() << "\n";
+        }
+    }
+}
+
+time_point Benchmark::next_request(const yc &yield, bool &first)
+{
+    if (rate_ > 0) {
+        return queue_.pop(yield);
     }
+
+    if (!first) {
+        asio::steady_timer timer{iocontext_};
+        timer.expires_after(delay_);
+        timer.async_wait(yield);
+    }
+    first = false;
+    return std::chrono::steady_clock::now();
 }
 
-void Benchmark::client_notify(std::chrono::microseconds req_duration)
+void Benchmark::client_notify(Command cmd, std::chrono::microseconds duration)
 {
+    stats_.record(cmd, duration);
+    if (cmd != Command::request) {
+        return;
+    }
+
     // NOLINTNEXTLINE
-    os_.write(reinterpret_cast<char *>(&req_duration), sizeof(req_duration));
+    os_.write(reinterpret_cast<char *>(&duration), sizeof(duration));
     total_requests_ += 1;
 }
 
+std::vector<ReplaySession> load_capture(const std::string &path)
+{
+    std::ifstream is{path, std::ios::binary};
+    if (!is.is_open()) {
+        throw std::runtime_error{"Could not open capture file " + path};
+    }
+
+    std::string magic(capture_file_magic.size(), '\0');
+    is.read(&magic[0], static_cast<std::streamsize>(magic.size()));
+    if (!is || magic != capture_file_magic) {
+        throw std::runtime_error{path + " is not a capture file"};
+    }
+
+    std::vector<ReplaySession> sessions;
+    // connection id -> index in sessions
+    std::map<uint32_t, std::size_t> index;
+    for (;;) {
+        CaptureRecordHeader header{};
+        // NOLINTNEXTLINE
+        is.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (is.gcount() == 0 && is.eof()) {
+            break;
+        }
+        if (!is) {
+            throw std::runtime_error{"Truncated record header in " + path};
+        }
+
+        std::string body(header.size, '\0');
+        is.read(&body[0], header.size);
+        if (!is) {
+            // the helper was probably killed while writing
+            SPDLOG_WARN("Ignoring truncated record at the end of {}", path);
+            break;
+        }
+
+        mpack_reader_t r;
+        mpack_reader_init_data(&r, body.data(), body.size());
+        mpack_tag_t root = mpack_read_tag(&r);
+        std::string method;
+        if (root.type == mpack_type_array) {
+            method = mpack::read_string(&r, mpack_read_tag(&r));
+        }
+        mpack_reader_destroy(&r);
+
+        // we always send our own client_init
+        auto it = std::find(command_names.begin(), command_names.end(),
+            std::string_view{method});
+        if (method == "client_init" || method == "request" ||
+            it == command_names.end()) {
+            continue;
+        }
+
+        auto [session_it, inserted] =
+            index.emplace(header.connection_id, sessions.size());
+        if (inserted) {
+            sessions.emplace_back();
+        }
+        sessions[session_it->second].messages.push_back(
+            {std::chrono::microseconds{header.time_us},
+                static_cast<Command>(it - command_names.begin()),
+                std::move(body)});
+    }
+
+    return sessions;
+}
+
+void RequestQueue::push(time_point scheduled)
+{
+    pending_.push_back(scheduled);
+    timer_.cancel_one();
+}
+
+time_point RequestQueue::pop(const asio::yield_context &yield)
+{
+    while (pending_.empty()) {
+        error_code ec;
+        timer_.async_wait(yield[ec]);
+        if (ec != boost::system::errc::operation_canceled) {
+            throw std::runtime_error{"async_wait failed: " + ec.message()};
+        }
+    }
+
+    auto scheduled = pending_.front();
+    pending_.pop_front();
+    return scheduled;
+}
+
+LatencyStats::LatencyStats()
+{
+    for (std::size_t i = 0; i < command_names.size(); i++) {
+        interval_.emplace_back(
+            1, histogram_max_us, histogram_significant_digits);
+        total_.emplace_back(1, histogram_max_us, histogram_significant_digits);
+    }
+}
+
+void LatencyStats::record(Command cmd, std::chrono::microseconds latency)
+{
+    using rep = std::chrono::microseconds::rep;
+    auto value = static_cast<std::uint64_t>(std::max<rep>(latency.count(), 1));
+    interval_[static_cast<std::size_t>(cmd)].record(value);
+}
+
+void LatencyStats::report_interval(std::chrono::duration<double> elapsed)
+{
+    std::cout << "Latencies (us) at " << std::fixed << std::setprecision(1)
+              << elapsed.count() << " s:\n";
+    for (std::size_t i = 0; i < command_names.size(); i++) {
+        if (interval_[i].count() > 0) {
+            print_histogram(command_names[i], interval_[i]);
+        }
+        total_[i].merge(interval_[i]);
+        interval_[i].reset();
+    }
+    std::cout << std::defaultfloat;
+}
+
+void LatencyStats::report_final() const
+{
+    std::cout << "Latencies (us) for the whole run:\n";
+    for (std::size_t i = 0; i < command_names.size(); i++) {
+        hdr_histogram hist{total_[i]};
+        hist.merge(interval_[i]);
+        if (hist.count() > 0) {
+            print_histogram(command_names[i], hist);
+        }
+    }
+}
+
+void LatencyStats::print_histogram(const char *name, const hdr_histogram &hist)
+{
+    static constexpr double p50 = 50.0;
+    static constexpr double p99 = 99.0;
+    static constexpr double p999 = 99.9;
+    static constexpr int name_width = 18;
+    static constexpr int count_width = 9;
+    static constexpr int value_width = 8;
+    std::cout << "  " << std::left << std::setw(name_width) << name
+              << std::right << " count " << std::setw(count_width)
+              << hist.count() << "  p50 " << std::setw(value_width)
+              << hist.value_at_percentile(p50) << "  p99 "
+              << std::setw(value_width) << hist.value_at_percentile(p99)
+              << "  p99.9 " << std::setw(value_width)
+              << hist.value_at_percentile(p999) << "  max "
+              << std::setw(value_width) << hist.max() << "\n";
+}
+
 void Client::run()
 {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::steady_clock;
+
     SPDLOG_DEBUG("C#{} Doing client_init", id_);
+    auto init_start{steady_clock::now()};
     try {
         do_client_init();
     } catch (const std::exception &e) {
         SPDLOG_ERROR("C#{} Error during client_init: {}", id_, e.what());
         throw;
     }
+    notify_(Command::client_init,
+        duration_cast<microseconds>(steady_clock::now() - init_start));
     SPDLOG_DEBUG("C#{} client_init done", id_);
     while (requests_left_-- > 0) {
-        auto start{std::chrono::steady_clock::now()};
+        auto scheduled{next_request_()};
         do_request_init();
+        auto req_init_end{steady_clock::now()};
         do_request_shutdown();
-        auto duration = std::chrono::steady_clock::now() - start;
-        notify_(
-            std::chrono::duration_cast<std::chrono::microseconds>(duration));
+        auto end{steady_clock::now()};
 
-        asio::steady_timer timer{iocontext_};
-        timer.expires_after(delay_);
-        timer.async_wait(yc_);
+        notify_(Command::request_init,
+            duration_cast<microseconds>(req_init_end - scheduled));
+        notify_(Command::request_shutdown,
+            duration_cast<microseconds>(end - req_init_end));
+        notify_(Command::request, duration_cast<microseconds>(end - scheduled));
     }
     sock_.socket().shutdown(
         boost::asio::local::stream_protocol::socket::shutdown_both);
     sock_.release_socket().close();
     SPDLOG_DEBUG("C#{} finished requests", id_);
 }
+template <typename S>
+uint64_t Client::replay(
+    const std::vector<ReplayMessage> &messages, S &&schedule)
+{
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::steady_clock;
+    static constexpr char replayed_id[] = "replayed"; // NOLINT
+
+    auto init_start{steady_clock::now()};
+    do_client_init();
+    notify_(Command::client_init,
+        duration_cast<microseconds>(steady_clock::now() - init_start));
+
+    uint64_t errors = 0;
+    asio::steady_timer timer{sock_.get_executor()};
+    std::optional<time_point> request_start;
+    for (const auto &msg : messages) {
+        auto scheduled{schedule(msg.offset)};
+        if (scheduled > steady_clock::now()) {
+            timer.expires_at(scheduled);
+            timer.async_wait(yc_);
+        }
+
+        send_helper_payload<replayed_id>({}, msg.body);
+        std::string resp{read_helper_response([](auto...) {})};
+        auto end{steady_clock::now()};
+        if (resp == "error") {
+            SPDLOG_DEBUG("C#{} Error response to replayed {}", id_,
+                command_names[static_cast<std::size_t>(msg.command)]);
+            errors++;
+        }
+
+        notify_(msg.command, duration_cast<microseconds>(end - scheduled));
+        if (msg.command == Command::request_init) {
+            request_start = scheduled;
+        } else if (msg.command == Command::request_shutdown && request_start) {
+            notify_(Command::request,
+                duration_cast<microseconds>(end - *request_start));
+            request_start.reset();
+        }
+    }
+
+    sock_.socket().shutdown(
+        boost::asio::local::stream_protocol::socket::shutdown_both);
+    sock_.release_socket().close();
+    return errors;
+}
+
 void Client::do_client_init()
 {
     // write
@@ -593,7 +1060,7 @@ std::string Client::read_helper_response(Function &&f)
             spdlog::default_logger_raw()->log(
                 spdlog::source_loc{__FILE__, __LINE__, "read_helper_response"},
                 spdlog::level::debug,
-                "C#{} Read {} bytes, {} left in helper response", thiz->id,
+                "C#{} Read {} bytes, {} left in helper response", thiz->id_,
                 read, left);
 
             if (ec.failed()) {
@@ -0,0 +1,170 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// A minimal HDR histogram (same bucket layout as HdrHistogram_c): values are
+// recorded with a fixed relative precision, given as a number of significant
+// decimal digits, across the whole [lowest, highest] range.
+class hdr_histogram {
+public:
+    hdr_histogram(
+        std::uint64_t lowest, std::uint64_t highest, int significant_digits)
+        : highest_{highest}
+    {
+        if (lowest < 1 || highest < 2 * lowest || significant_digits < 1 ||
+            significant_digits > 5) { // NOLINT
+            throw std::invalid_argument{"invalid hdr_histogram parameters"};
+        }
+
+        auto largest_single_unit =
+            2 * static_cast<std::uint64_t>(
+                    std::pow(10, significant_digits)); // NOLINT
+        auto sub_bucket_count_magnitude = static_cast<int>(
+            std::ceil(std::log2(static_cast<double>(largest_single_unit))));
+        sub_bucket_half_count_magnitude_ =
+            std::max(sub_bucket_count_magnitude, 1) - 1;
+        unit_magnitude_ = static_cast<int>(
+            std::floor(std::log2(static_cast<double>(lowest))));
+        sub_bucket_count_ = std::int64_t{1}
+                            << (sub_bucket_half_count_magnitude_ + 1);
+        sub_bucket_half_count_ = sub_bucket_count_ / 2;
+        sub_bucket_mask_ = (static_cast<std::uint64_t>(sub_bucket_count_) - 1)
+                           << unit_magnitude_;
+
+        auto smallest_untrackable =
+            static_cast<std::uint64_t>(sub_bucket_count_) << unit_magnitude_;
+        int bucket_count = 1;
+        while (smallest_untrackable <= highest) {
+            if (smallest_untrackable > (UINT64_MAX >> 1)) {
+                bucket_count++;
+                break;
+            }
+            smallest_untrackable <<= 1;
+            bucket_count++;
+        }
+        counts_.resize((bucket_count + 1) * sub_bucket_half_count_);
+    }
+
+    void record(std::uint64_t value)
+    {
+        value = std::min(value, highest_);
+        counts_[counts_index_for(value)]++;
+        total_count_++;
+        max_ = std::max(max_, value);
+    }
+
+    [[nodiscard]] std::uint64_t count() const { return total_count_; }
+    [[nodiscard]] std::uint64_t max() const { return max_; }
+
+    // the highest value equivalent to the one at the given percentile
+    [[nodiscard]] std::uint64_t value_at_percentile(double percentile) const
+    {
+        if (total_count_ == 0) {
+            return 0;
+        }
+        percentile = std::min(std::max(percentile, 0.0), 100.0); // NOLINT
+        auto count_at_percentile = static_cast<std::uint64_t>(
+            (percentile / 100.0) * static_cast<double>(total_count_) + 0.5);
+        count_at_percentile = std::max(count_at_percentile, std::uint64_t{1});
+
+        std::uint64_t total = 0;
+        for (std::size_t i = 0; i < counts_.size(); i++) {
+            total += counts_[i];
+            if (total >= count_at_percentile) {
+                return std::min(highest_equivalent_value(value_at_index(i)),
+                    max_);
+            }
+        }
+        return max_;
+    }
+
+    void merge(const hdr_histogram &other)
+    {
+        if (other.counts_.size() != counts_.size()) {
+            throw std::invalid_argument{"incompatible hdr_histograms"};
+        }
+        for (std::size_t i = 0; i < counts_.size(); i++) {
+            counts_[i] += other.counts_[i];
+        }
+        total_count_ += other.total_count_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset()
+    {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_count_ = 0;
+        max_ = 0;
+    }
+
+private:
+    [[nodiscard]] int bucket_index(std::uint64_t value) const
+    {
+        // smallest power of 2 containing value
+        int pow2ceiling = 64 - __builtin_clzll(value | sub_bucket_mask_);
+        return pow2ceiling - unit_magnitude_ -
+               (sub_bucket_half_count_magnitude_ + 1);
+    }
+
+    [[nodiscard]] std::size_t counts_index_for(std::uint64_t value) const
+    {
+        int bucket_idx = bucket_index(value);
+        auto sub_bucket_idx =
+            static_cast<std::int64_t>(value >> (bucket_idx + unit_magnitude_));
+        auto bucket_base_idx = static_cast<std::int64_t>(bucket_idx + 1)
+                               << sub_bucket_half_count_magnitude_;
+        return static_cast<std::size_t>(
+            bucket_base_idx + (sub_bucket_idx - sub_bucket_half_count_));
+    }
+
+    [[nodiscard]] std::uint64_t value_at_index(std::size_t index) const
+    {
+        auto idx = static_cast<std::int64_t>(index);
+        int bucket_idx =
+            static_cast<int>(idx >> sub_bucket_half_count_magnitude_) - 1;
+        std::int64_t sub_bucket_idx =
+            (idx & (sub_bucket_half_count_ - 1)) + sub_bucket_half_count_;
+        if (bucket_idx < 0) {
+            sub_bucket_idx -= sub_bucket_half_count_;
+            bucket_idx = 0;
+        }
+        return static_cast<std::uint64_t>(sub_bucket_idx)
+               << (bucket_idx + unit_magnitude_);
+    }
+
+    [[nodiscard]] std::uint64_t highest_equivalent_value(
+        std::uint64_t value) const
+    {
+        int bucket_idx = bucket_index(value);
+        auto sub_bucket_idx = value >> (bucket_idx + unit_magnitude_);
+        int adjusted_bucket =
+            sub_bucket_idx >= static_cast<std::uint64_t>(sub_bucket_count_)
+                ? bucket_idx + 1
+                : bucket_idx;
+        std::uint64_t range = std::uint64_t{1}
+                              << (unit_magnitude_ + adjusted_bucket);
+        std::uint64_t lowest_equivalent = sub_bucket_idx
+                                          << (bucket_idx + unit_magnitude_);
+        return lowest_equivalent + range - 1;
+    }
+
+    std::uint64_t highest_;
+    int unit_magnitude_{};
+    int sub_bucket_half_count_magnitude_{};
+    std::int64_t sub_bucket_count_{};
+    std::int64_t sub_bucket_half_count_{};
+    std::uint64_t sub_bucket_mask_{};
+
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t total_count_{};
+    std::uint64_t max_{};
+};
@@ -0,0 +1,237 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2022 Datadog, Inc.
+
+// Microbenchmark for the client ip extraction primitives (ip_addr.c). It
+// first checks the parser against inet_pton and then times:
+//  - walking a X-Forwarded-For chain with inet_pton (the previous approach)
+//    and with dd_list_iter/dd_ip_parse;
+//  - matching addresses against a set of networks with a linear scan and
+//    with dd_cidr_set.
+//
+// Usage: bench_ip_extraction [iterations]
+
+#include "ip_addr.h"
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_ITERATIONS 1000000
+
+static const char *const parse_cases[] = {"1.2.3.4", "255.255.255.255",
+    "0.0.0.0", "01.2.3.4", "1.2.3", "1.2.3.4.5", "256.1.1.1", "1..2.3",
+    "1.2.3.4 ", "::", "::1", "1::", "fe80::1", "2001:db8::8a2e:370:7334",
+    "2001:0db8:0000:0000:0000:ff00:0042:8329", "::ffff:1.2.3.4",
+    "::ffff:10.0.0.1", "1:2:3:4:5:6:7:8", "1:2:3:4:5:6:7:8:9",
+    "1:2:3:4:5:6:7::", "1::2::3", ":1::2", "1:2:", "12345::", "::1.2.3.4",
+    "1:2:3:4:5:6:1.2.3.4", "1:2:3:4:5:6:7:1.2.3.4", "g::1", "", "abc"};
+
+static const char xff_chain[] =
+    "10.0.0.1, 10.1.2.3, 172.16.4.5, 192.168.10.11, 10.20.30.40, "
+    "172.31.255.1, 127.0.0.1, 169.254.1.1, 203.0.113.195, 198.51.100.17";
+
+static const char *const networks[] = {"173.245.48.0/20", "103.21.244.0/22",
+    "103.22.200.0/22", "103.31.4.0/22", "141.101.64.0/18", "108.162.192.0/18",
+    "190.93.240.0/20", "188.114.96.0/20", "197.234.240.0/22",
+    "198.41.128.0/17", "162.158.0.0/15", "104.16.0.0/13", "104.24.0.0/14",
+    "172.64.0.0/13", "131.0.72.0/22", "10.0.0.0/8", "172.16.0.0/12",
+    "192.168.0.0/16", "127.0.0.0/8", "169.254.0.0/16", "2400:cb00::/32",
+    "2606:4700::/32", "2803:f800::/32", "2405:b500::/32", "2405:8100::/32",
+    "2a06:98c0::/29", "2c0f:f248::/32", "fe80::/10", "fc00::/7", "::1/128"};
+
+typedef struct {
+    int af;
+    uint8_t base[16];
+    uint8_t mask[16];
+} linear_net;
+
+static double _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int _check_parser(void)
+{
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(parse_cases) / sizeof(parse_cases[0]); i++) {
+        const char *s = parse_cases[i];
+        uint8_t ref[16];
+        bool ref_ok = inet_pton(AF_INET, s, ref) == 1 ||
+                      inet_pton(AF_INET6, s, ref) == 1;
+        dd_ipaddr addr;
+        bool ok = dd_ip_parse(s, strlen(s), &addr);
+        if (ok != ref_ok) {
+            fprintf(stderr, "mismatch for \"%s\": inet_pton %d, ours %d\n", s,
+                ref_ok, ok);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+static bool _linear_contains(
+    const linear_net *nets, size_t count, const dd_ipaddr *addr)
+{
+    size_t len = addr->af == AF_INET ? 4 : 16;
+    const uint8_t *a = addr->af == AF_INET ? (const uint8_t *)&addr->v4
+                                           : addr->v6.s6_addr;
+    for (size_t i = 0; i < count; i++) {
+        if (nets[i].af != addr->af) {
+            continue;
+        }
+        size_t j = 0;
+        for (; j < len && (a[j] & nets[i].mask[j]) == nets[i].base[j]; j++) {}
+        if (j == len) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// previous approach: copy each element to NUL-terminate it for inet_pton
+static size_t _xff_inet_pton(const linear_net *nets, size_t count)
+{
+    const char *value = xff_chain;
+    const char *end = value + sizeof(xff_chain) - 1;
+    size_t found = 0;
+    while (value) {
+        for (; value < end && *value == ' '; value++) {}
+        const char *comma = memchr(value, ',', end - value);
+        const char *end_cur = comma ? comma : end;
+        size_t len = end_cur - value;
+        char *copy = malloc(len + 1);
+        memcpy(copy, value, len);
+        copy[len] = '\0';
+        dd_ipaddr addr;
+        if (inet_pton(AF_INET, copy, &addr.v4) == 1) {
+            addr.af = AF_INET;
+        } else if (inet_pton(AF_INET6, copy, &addr.v6) == 1) {
+            addr.af = AF_INET6;
+        } else {
+            addr.af = 0;
+        }
+        free(copy);
+        if (addr.af && !_linear_contains(nets, count, &addr)) {
+            found++;
+            break;
+        }
+        value = (comma && comma + 1 < end) ? (comma + 1) : NULL;
+    }
+    return found;
+}
+
+static size_t _xff_dd(const dd_cidr_set *set)
+{
+    dd_list_iter it;
+    dd_list_iter_init(&it, xff_chain, sizeof(xff_chain) - 1);
+    const char *elem;
+    size_t elem_len;
+    while (dd_list_iter_next(&it, &elem, &elem_len)) {
+        dd_ipaddr addr;
+        if (dd_ip_parse_maybe_port(elem, elem_len, &addr) &&
+            !dd_cidr_set_contains(set, &addr)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? strtol(argv[1], NULL, 10) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    int failures = _check_parser();
+    if (failures) {
+        return 1;
+    }
+
+    size_t num_nets = sizeof(networks) / sizeof(networks[0]);
+    linear_net *nets = calloc(num_nets, sizeof(*nets));
+    dd_cidr_set set = {0};
+    for (size_t i = 0; i < num_nets; i++) {
+        const char *cidr = networks[i];
+        if (!dd_cidr_set_add(&set, cidr, strlen(cidr))) {
+            fprintf(stderr, "failed adding %s\n", cidr);
+            return 1;
+        }
+        const char *slash = strchr(cidr, '/');
+        char addr_str[64];
+        memcpy(addr_str, cidr, slash - cidr);
+        addr_str[slash - cidr] = '\0';
+        unsigned bits = (unsigned)atoi(slash + 1);
+        nets[i].af = strchr(addr_str, ':') ? AF_INET6 : AF_INET;
+        inet_pton(nets[i].af, addr_str, nets[i].base);
+        for (unsigned b = 0; b < bits; b++) {
+            nets[i].mask[b / 8] |= (uint8_t)(0x80 >> (b % 8));
+        }
+    }
+
+    volatile size_t sink = 0;
+    double start = _now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += _xff_inet_pton(nets, num_nets);
+    }
+    double t_old = (_now_ns() - start) / (double)iterations;
+
+    start = _now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += _xff_dd(&set);
+    }
+    double t_new = (_now_ns() - start) / (double)iterations;
+
+    if (sink != 2 * (size_t)iterations) {
+        fprintf(stderr, "unexpected results\n");
+        return 1;
+    }
+
+    printf("xff chain (10 hops, %zu networks):\n", num_nets);
+    printf("  inet_pton + linear scan: %8.1f ns/op\n", t_old);
+    printf("  dd_ip_parse + cidr trie: %8.1f ns/op\n", t_new);
+
+    static const char *const probes[] = {"203.0.113.195", "104.18.2.3",
+        "10.9.8.7", "2606:4700:10::6816:1", "2001:db8::1", "fd00::1"};
+    enum { num_probes = sizeof(probes) / sizeof(probes[0]) };
+    dd_ipaddr probe_addrs[num_probes];
+    for (size_t i = 0; i < num_probes; i++) {
+        dd_ip_parse(probes[i], strlen(probes[i]), &probe_addrs[i]);
+    }
+
+    sink = 0;
+    start = _now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += _linear_contains(nets, num_nets, &probe_addrs[i % num_probes]);
+    }
+    t_old = (_now_ns() - start) / (double)iterations;
+    size_t sink_old = sink;
+
+    sink = 0;
+    start = _now_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += dd_cidr_set_contains(&set, &probe_addrs[i % num_probes]);
+    }
+    t_new = (_now_ns() - start) / (double)iterations;
+
+    if (sink != sink_old) {
+        fprintf(stderr, "trie and linear scan disagree\n");
+        return 1;
+    }
+
+    printf("network lookup (%zu networks):\n", num_nets);
+    printf("  linear scan:             %8.1f ns/op\n", t_old);
+    printf("  cidr trie:               %8.1f ns/op\n", t_new);
+
+    dd_cidr_set_destroy(&set);
+    free(nets);
+    return 0;
+}
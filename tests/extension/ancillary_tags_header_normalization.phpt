@@ -0,0 +1,42 @@
+--TEST--
+Request header tags are found regardless of the form of the $_SERVER key
+--INI--
+datadog.appsec.extra_headers=my-header,user-agent
+--ENV--
+HTTP_X_Forwarded_For=7.7.7.6
+HTTP_MY_HEADER=my header value
+HTTP_USER_AGENT=my user agent
+HTTP_COOKIE=a=b
+HTTP_IGNORED_HEADER=ignored header
+--FILE--
+<?php
+
+use function datadog\appsec\testing\add_all_ancillary_tags;
+use function datadog\appsec\testing\add_basic_ancillary_tags;
+
+$all = array();
+add_all_ancillary_tags($all);
+ksort($all);
+print_r(array_filter($all, function ($k) {
+    return strpos($k, 'http.request.headers.') === 0;
+}, ARRAY_FILTER_USE_KEY));
+
+$basic = array();
+add_basic_ancillary_tags($basic);
+ksort($basic);
+print_r(array_filter($basic, function ($k) {
+    return strpos($k, 'http.request.headers.') === 0;
+}, ARRAY_FILTER_USE_KEY));
+
+?>
+--EXPECTF--
+Array
+(
+    [http.request.headers.my-header] => my header value
+    [http.request.headers.user-agent] => my user agent
+    [http.request.headers.x-forwarded-for] => 7.7.7.6
+)
+Array
+(
+    [http.request.headers.x-forwarded-for] => 7.7.7.6
+)
@@ -0,0 +1,37 @@
+--TEST--
+Extract client IP address skipping trusted proxies
+--INI--
+datadog.appsec.trusted_proxies=203.0.113.0/24, 198.51.100.7,2001:db8::/32
+--FILE--
+<?php
+use function datadog\appsec\testing\extract_ip_addr;
+
+function test($header, $value) {
+    echo "$header: $value\n";
+    $res = extract_ip_addr(['HTTP_' . strtoupper($header) => $value]);
+    var_dump($res);
+    echo "\n";
+}
+test('x_forwarded_for', '203.0.113.10, 198.51.100.7, 10.0.0.1, 8.8.8.8');
+test('x_forwarded_for', '198.51.100.8, 8.8.8.8');
+test('x_forwarded_for', '2001:db8::1, 2001::1');
+test('x_real_ip', '203.0.113.1');
+test('x_forwarded', 'for=203.0.113.1;proto=http, for="[2001:db8::2]", for=4.4.4.4');
+
+?>
+--EXPECT--
+x_forwarded_for: 203.0.113.10, 198.51.100.7, 10.0.0.1, 8.8.8.8
+string(7) "8.8.8.8"
+
+x_forwarded_for: 198.51.100.8, 8.8.8.8
+string(12) "198.51.100.8"
+
+x_forwarded_for: 2001:db8::1, 2001::1
+string(7) "2001::1"
+
+x_real_ip: 203.0.113.1
+NULL
+
+x_forwarded: for=203.0.113.1;proto=http, for="[2001:db8::2]", for=4.4.4.4
+string(7) "4.4.4.4"
+
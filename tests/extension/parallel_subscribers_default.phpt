@@ -0,0 +1,7 @@
+--TEST--
+datadog.appsec.parallel_subscribers_min_size default value
+--FILE--
+<?php
+var_dump(ini_get('datadog.appsec.parallel_subscribers_min_size'));
+--EXPECT--
+string(1) "0"
@@ -0,0 +1,87 @@
+--TEST--
+Pushed addresses are sent with the next request_exec or before request_shutdown
+--INI--
+extension=ddtrace.so
+datadog.appsec.enabled=1
+datadog.appsec.log_level=trace
+datadog.appsec.log_file=/tmp/php_appsec_test.log
+
+--FILE--
+<?php
+use function datadog\appsec\push_address;
+use function datadog\appsec\testing\{rinit,rshutdown,request_exec};
+
+include __DIR__ . '/inc/mock_helper.php';
+
+$helper = Helper::createInitedRun([
+    response_list(response_request_init(['ok', []])),
+    response_list(response_request_exec(['ok', []])),
+    response_list(response_request_exec(['ok', []])),
+    response_list(response_request_shutdown(['ok', [], new ArrayObject(), new ArrayObject()]))
+]);
+
+rinit();
+
+var_dump(push_address('server.request.path_params', ['id' => '1']));
+var_dump(push_address('server.request.path_params', ['id' => '2']));
+var_dump(request_exec(['usr.id' => 'admin']));
+var_dump(push_address('graphql.server.resolver', ['name' => 'value']));
+
+rshutdown();
+
+$commands = $helper->get_commands();
+
+var_dump($commands[2]);
+var_dump($commands[3][0]);
+var_dump($commands[3][1][0]);
+var_dump($commands[4][0]);
+
+?>
+--EXPECTF--
+bool(true)
+bool(true)
+bool(true)
+bool(true)
+array(2) {
+  [0]=>
+  string(12) "request_exec"
+  [1]=>
+  array(1) {
+    [0]=>
+    array(3) {
+      [0]=>
+      array(1) {
+        ["server.request.path_params"]=>
+        array(1) {
+          ["id"]=>
+          string(1) "1"
+        }
+      }
+      [1]=>
+      array(1) {
+        ["server.request.path_params"]=>
+        array(1) {
+          ["id"]=>
+          string(1) "2"
+        }
+      }
+      [2]=>
+      array(1) {
+        ["usr.id"]=>
+        string(5) "admin"
+      }
+    }
+  }
+}
+string(12) "request_exec"
+array(1) {
+  [0]=>
+  array(1) {
+    ["graphql.server.resolver"]=>
+    array(1) {
+      ["name"]=>
+      string(5) "value"
+    }
+  }
+}
+string(16) "request_shutdown"
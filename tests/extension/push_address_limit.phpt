@@ -0,0 +1,42 @@
+--TEST--
+Pushed addresses are sent on their own once too many are pending
+--INI--
+extension=ddtrace.so
+datadog.appsec.enabled=1
+datadog.appsec.log_level=trace
+datadog.appsec.log_file=/tmp/php_appsec_test.log
+
+--FILE--
+<?php
+use function datadog\appsec\push_address;
+use function datadog\appsec\testing\{rinit,rshutdown};
+
+include __DIR__ . '/inc/mock_helper.php';
+
+$helper = Helper::createInitedRun([
+    response_list(response_request_init(['ok', []])),
+    response_list(response_request_exec(['ok', []])),
+    response_list(response_request_shutdown(['ok', [], new ArrayObject(), new ArrayObject()]))
+]);
+
+rinit();
+
+for ($i = 0; $i < 16; $i++) {
+    push_address('server.request.path_params', ['id' => (string)$i]);
+}
+
+// Nothing is left to send before request_shutdown
+rshutdown();
+
+$commands = $helper->get_commands();
+var_dump(count($commands));
+var_dump($commands[2][0]);
+var_dump(count($commands[2][1][0]));
+var_dump($commands[3][0]);
+
+?>
+--EXPECTF--
+int(4)
+string(12) "request_exec"
+int(16)
+string(16) "request_shutdown"
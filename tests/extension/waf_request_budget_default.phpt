@@ -0,0 +1,7 @@
+--TEST--
+datadog.appsec.waf_request_budget default value
+--FILE--
+<?php
+var_dump(ini_get('datadog.appsec.waf_request_budget'));
+--EXPECT--
+string(1) "0"
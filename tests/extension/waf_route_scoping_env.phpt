@@ -0,0 +1,10 @@
+--TEST--
+Enable datadog.appsec.waf_route_scoping through the environment
+--ENV--
+DD_APPSEC_WAF_ROUTE_SCOPING=1
+--FILE--
+<?php
+var_dump(ini_get('datadog.appsec.waf_route_scoping'));
+?>
+--EXPECT--
+string(1) "1"
@@ -0,0 +1,9 @@
+--TEST--
+datadog.appsec.waf_verdict_cache_size and waf_verdict_cache_ttl default values
+--FILE--
+<?php
+var_dump(ini_get('datadog.appsec.waf_verdict_cache_size'));
+var_dump(ini_get('datadog.appsec.waf_verdict_cache_ttl'));
+--EXPECT--
+string(1) "0"
+string(2) "60"
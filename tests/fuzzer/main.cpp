@@ -9,10 +9,14 @@
 #include <spdlog/spdlog.h>
 #include "mutators.hpp"
 #include "network.hpp"
+#include "objective.hpp"
+#include <engine_settings.hpp>
+#include <future>
 #include <iostream>
 
 dds::fuzzer::acceptor *acceptor;
 std::function<decltype(RawMutator)> mutator;
+std::unique_ptr<dds::fuzzer::slow_inputs> slow_inputs;
 
 extern "C" int LLVMFuzzerRunDriver(int *argc, char ***argv,
                   int (*UserCb)(const uint8_t *Data, size_t Size));
@@ -24,7 +28,21 @@ extern "C" int LLVMFuzzerInitialize(int *argc, char ***argv)
 
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t* bytes, size_t size)
 {
-    acceptor->push_socket(std::make_unique<dds::fuzzer::raw_socket>(bytes, size));
+    if (!slow_inputs) {
+        acceptor->push_socket(std::make_unique<dds::fuzzer::raw_socket>(bytes, size));
+        return 0;
+    }
+
+    // The cost can only be attributed to the input once the helper is done
+    // with it, so wait for the connection to be closed.
+    std::promise<void> closed;
+    auto closed_future = closed.get_future();
+    auto before = dds::fuzzer::current_cost();
+    acceptor->push_socket(std::make_unique<dds::fuzzer::raw_socket>(
+        bytes, size, [&closed] { closed.set_value(); }));
+    closed_future.wait();
+
+    slow_inputs->report(bytes, size, dds::fuzzer::current_cost() - before);
     return 0;
 }
 
@@ -60,6 +78,25 @@ int main(int argc, char **argv)
         mutator = RawMutator;
     } else if (fuzz_mode == "off") {
         mutator = NopMutator;
+    } else if (fuzz_mode == "slow") {
+        // Looks for the inputs that take the longest to decode and run
+        // through the WAF or that allocate the most, rather than for crashes.
+        mutator = MessageBodyMutator;
+
+        std::string directory;
+        uint64_t threshold_us = dds::engine_settings::default_waf_timeout_us;
+        try {
+            directory = config.get<std::string>("slow-corpus");
+        } catch (...) {
+            directory = "tests/fuzzer/slow";
+        }
+        try {
+            threshold_us = std::stoull(config.get<std::string>("slow-threshold-us"));
+        } catch (...) {}
+
+        dds::fuzzer::install_allocation_hooks();
+        slow_inputs = std::make_unique<dds::fuzzer::slow_inputs>(
+            directory, threshold_us);
     }else {
         std::cerr << "Unsupported fuzzing mode, using raw mutator" << std::endl;
     }
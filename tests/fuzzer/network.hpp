@@ -7,6 +7,7 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <iostream>
 #include <mutex>
 #include <network/acceptor.hpp>
@@ -19,12 +20,17 @@ namespace dds::fuzzer {
 
 class raw_socket : public network::base_socket {
 public:
-    raw_socket(const uint8_t *bytes, size_t size) : start(new uint8_t[size]) {
+    raw_socket(const uint8_t *bytes, size_t size,
+        std::function<void()> on_close = {})
+        : start(new uint8_t[size]), on_close(std::move(on_close)) {
         memcpy(start, bytes, size);
         r = reader(start, size);
     }
 
-    ~raw_socket() override { delete[] start; }
+    ~raw_socket() override {
+        delete[] start;
+        if (on_close) { on_close(); }
+    }
 
     std::size_t recv(char *buffer, std::size_t size) override
     {
@@ -46,6 +52,8 @@ public:
 protected:
     uint8_t *start{nullptr};
     reader r;
+    // Called once the helper is done with the connection
+    std::function<void()> on_close;
 };
 
 class acceptor : public network::base_acceptor {
@@ -67,10 +75,10 @@ public:
     {
         while (true) {
             std::unique_lock<std::mutex> lk(mtx);
-            cv.wait(lk);
+            // A socket pushed before waiting would otherwise be missed
+            cv.wait(lk, [this] { return exit_flag || socket; });
 
             if (exit_flag) { break; }
-            if (!socket) { continue; }
 
             return std::move(socket);
         }
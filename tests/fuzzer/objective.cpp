@@ -0,0 +1,125 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog (https://www.datadoghq.com/).
+// Copyright 2021 Datadog, Inc.
+#include "objective.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <metrics.hpp>
+#include <sanitizer/allocator_interface.h>
+
+namespace dds::fuzzer {
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<uint64_t> allocated_bytes{0};
+
+void malloc_hook(const volatile void * /*ptr*/, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void free_hook(const volatile void * /*ptr*/) {}
+
+uint64_t stage_total_us(metrics::stage s)
+{
+    auto &stats = metrics::command_stats::instance();
+    uint64_t total = 0;
+    for (std::size_t i = 0; i < metrics::command_count; i++) {
+        total += stats.get(static_cast<network::request_id>(i), s).get().sum_us;
+    }
+    return total;
+}
+
+// Buckets of a quarter of a power of two, so that inputs which are only
+// somewhat worse are still considered new.
+constexpr std::size_t buckets_per_objective = 128;
+constexpr std::size_t objective_count = 4;
+
+// libFuzzer treats every counter in this section as coverage
+__attribute__((section("__libfuzzer_extra_counters")))
+uint8_t cost_counters[objective_count * buckets_per_objective];
+
+void set_counter(std::size_t objective, uint64_t value)
+{
+    auto bucket = static_cast<std::size_t>(
+        4 * std::log2(static_cast<double>(value) + 1));
+    bucket = std::min(bucket, buckets_per_objective - 1);
+    cost_counters[objective * buckets_per_objective + bucket] = 1;
+}
+
+} // namespace
+
+void install_allocation_hooks()
+{
+    __sanitizer_install_malloc_and_free_hooks(malloc_hook, free_hook);
+}
+
+input_cost current_cost()
+{
+    return {stage_total_us(metrics::stage::decode),
+        stage_total_us(metrics::stage::publish),
+        allocations.load(std::memory_order_relaxed),
+        allocated_bytes.load(std::memory_order_relaxed)};
+}
+
+slow_inputs::slow_inputs(std::string directory, uint64_t threshold_us)
+    : directory_(std::move(directory)), threshold_us_(threshold_us)
+{}
+
+void slow_inputs::report(
+    const uint8_t *bytes, size_t size, const input_cost &cost)
+{
+    set_counter(0, cost.decode_us);
+    set_counter(1, cost.publish_us);
+    set_counter(2, cost.allocations);
+    set_counter(3, cost.allocated_bytes);
+
+    if (cost.decode_us > worst_.decode_us) {
+        worst_.decode_us = cost.decode_us;
+        save(bytes, size, "decode_us", cost.decode_us);
+    }
+    if (cost.publish_us > worst_.publish_us) {
+        worst_.publish_us = cost.publish_us;
+        save(bytes, size, "publish_us", cost.publish_us);
+    }
+    if (cost.allocations > worst_.allocations) {
+        worst_.allocations = cost.allocations;
+        save(bytes, size, "allocations", cost.allocations);
+    }
+    if (cost.allocated_bytes > worst_.allocated_bytes) {
+        worst_.allocated_bytes = cost.allocated_bytes;
+        save(bytes, size, "allocated_bytes", cost.allocated_bytes);
+    }
+
+    if (cost.decode_us + cost.publish_us >= threshold_us_) {
+        std::cerr << "Slow input: decode=" << cost.decode_us
+                  << "us publish=" << cost.publish_us << "us" << std::endl;
+        save(bytes, size, "threshold_us", cost.decode_us + cost.publish_us);
+    }
+}
+
+void slow_inputs::save(const uint8_t *bytes, size_t size,
+    std::string_view objective, uint64_t value)
+{
+    std::string_view data{reinterpret_cast<const char *>(bytes), size};
+
+    std::string path = directory_;
+    if (!path.empty() && path.back() != '/') {
+        path += '/';
+    }
+    path += std::string(objective) + '-' + std::to_string(value) + '-' +
+        std::to_string(std::hash<std::string_view>{}(data));
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(data.data(), data.size());
+}
+
+} // namespace dds::fuzzer
@@ -0,0 +1,56 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog (https://www.datadoghq.com/).
+// Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace dds::fuzzer {
+
+// What it cost the helper to process an input, the objective of the slow
+// fuzzing mode.
+struct input_cost {
+    uint64_t decode_us{0};
+    uint64_t publish_us{0};
+    uint64_t allocations{0};
+    uint64_t allocated_bytes{0};
+
+    input_cost operator-(const input_cost &other) const {
+        return {decode_us - other.decode_us, publish_us - other.publish_us,
+            allocations - other.allocations,
+            allocated_bytes - other.allocated_bytes};
+    }
+};
+
+// Starts counting the allocations done by every thread
+void install_allocation_hooks();
+
+// The totals since the start, the cost of an input is the difference between
+// the totals after and before it's processed.
+input_cost current_cost();
+
+// Turns the cost of each input into libFuzzer features, so that the inputs
+// which are slower or allocate more than any seen before are kept in the
+// corpus and mutated further. Each new worst input is also saved on its own
+// directory, named after the cost, for later analysis.
+class slow_inputs {
+public:
+    slow_inputs(std::string directory, uint64_t threshold_us);
+
+    void report(const uint8_t *bytes, size_t size, const input_cost &cost);
+
+protected:
+    void save(const uint8_t *bytes, size_t size, std::string_view objective,
+        uint64_t value);
+
+    std::string directory_;
+    uint64_t threshold_us_;
+    input_cost worst_;
+};
+
+} // namespace dds::fuzzer
@@ -7,6 +7,7 @@
 #include "version.hpp"
 #include <exception.hpp>
 #include <msgpack.hpp>
+#include <network/addresses.hpp>
 #include <network/broker.hpp>
 #include <network/socket.hpp>
 #include <parameter_view.hpp>
@@ -80,7 +81,7 @@ TEST(BrokerTest, SendClientInit)
     packer.pack_array(1);            // Array of messages
     packer.pack_array(2);            // First message
     pack_str(packer, "client_init"); // Type
-    packer.pack_array(5);
+    packer.pack_array(6);
     pack_str(packer, "ok");
     pack_str(packer, dds::php_ddappsec_version);
     packer.pack_array(2);
@@ -88,6 +89,7 @@ TEST(BrokerTest, SendClientInit)
     pack_str(packer, "two");
     packer.pack_map(0);
     packer.pack_map(0);
+    packer.pack_array(0);
     const auto &expected_data = ss.str();
 
     network::header_t h;
@@ -362,6 +364,9 @@ TEST(BrokerTest, RecvClientInit)
     EXPECT_STREQ(command.rc_settings.host.c_str(), "datadog.host");
     EXPECT_EQ(command.rc_settings.port, 1025);
     EXPECT_EQ(command.rc_settings.poll_interval, 2222);
+
+    // Not sent by this client
+    EXPECT_TRUE(command.capabilities.empty());
 }
 
 TEST(BrokerTest, RecvRequestInit)
@@ -422,7 +427,7 @@ TEST(BrokerTest, RecvRequestInit)
     EXPECT_EQ(ddwaf_object_type(pv[2][5]), DDWAF_OBJ_NULL);
 }
 
-TEST(BrokerTest, RecvRequestInitOverLimits)
+TEST(BrokerTest, RecvRequestInitWithAddressIds)
 {
     mock::socket *socket = new mock::socket();
     network::broker broker{std::unique_ptr<mock::socket>(socket)};
@@ -432,13 +437,121 @@ TEST(BrokerTest, RecvRequestInitOverLimits)
     packer.pack_array(2);
     pack_str(packer, "request_init");
     packer.pack_array(1);
+    packer.pack_map(4);
+    packer.pack_unsigned_int(0); // server.request.query
+    pack_str(packer, "Arachni");
+    packer.pack_unsigned_int(4); // server.request.headers.no_cookies
+    packer.pack_map(1);
+    pack_str(packer, "user-agent");
+    pack_str(packer, "Arachni");
+    packer.pack_unsigned_int(network::known_addresses.size()); // unknown
+    pack_str(packer, "ignored");
+    pack_str(packer, "server.request.uri.raw");
+    pack_str(packer, "arachni.com");
+    const std::string &expected_data = ss.str();
+
+    network::header_t h{"dds", (uint32_t)expected_data.size()};
+    EXPECT_CALL(*socket, recv(_, _))
+        .WillOnce(DoAll(CopyHeader(&h), Return(sizeof(network::header_t))))
+        .WillOnce(
+            DoAll(CopyString(&expected_data), Return(expected_data.size())));
+
+    network::request request = broker.recv(std::chrono::milliseconds(100));
+    EXPECT_EQ(request.id, network::request_init::request::id);
+
+    auto &command = request.as<network::request_init>();
+    parameter_view pv(command.data);
+    EXPECT_TRUE(pv.is_map());
+    EXPECT_EQ(pv.size(), 3);
+    EXPECT_STREQ(pv[0].key().data(), "server.request.query");
+    EXPECT_STREQ(std::string_view(pv[0]).data(), "Arachni");
+    EXPECT_STREQ(pv[1].key().data(), "server.request.headers.no_cookies");
+    EXPECT_STREQ(pv[1][0].key().data(), "user-agent");
+    EXPECT_STREQ(pv[2].key().data(), "server.request.uri.raw");
+    EXPECT_STREQ(std::string_view(pv[2]).data(), "arachni.com");
+}
+
+TEST(BrokerTest, RecvRequestInitTruncated)
+{
+    mock::socket *socket = new mock::socket();
+    network::broker broker{std::unique_ptr<mock::socket>(socket)};
+
+    std::stringstream ss;
+    msgpack::packer<std::stringstream> packer(ss);
+    packer.pack_array(2);
+    pack_str(packer, "request_init");
+    packer.pack_array(1);
+    packer.pack_map(2);
+    pack_str(packer, "server.request.query");
+    pack_str(packer, "Arachni");
+    // Within the msgpack limits, beyond the depth the WAF looks into
+    pack_str(packer, "server.request.body");
+    for (std::size_t i = 0; i < 24; i++) { packer.pack_array(1); }
+    pack_str(packer, "too deep");
+    const std::string &expected_data = ss.str();
+
+    network::header_t h{"dds", (uint32_t)expected_data.size()};
+    EXPECT_CALL(*socket, recv(_, _))
+        .WillOnce(DoAll(CopyHeader(&h), Return(sizeof(network::header_t))))
+        .WillOnce(
+            DoAll(CopyString(&expected_data), Return(expected_data.size())));
+
+    network::request request = broker.recv(std::chrono::milliseconds(100));
+    EXPECT_EQ(request.id, network::request_init::request::id);
+
+    auto &command = request.as<network::request_init>();
+    EXPECT_EQ(command.truncated_values, 1);
+
+    parameter_view pv(command.data);
+    EXPECT_EQ(pv.size(), 2);
+    EXPECT_STREQ(std::string_view(pv[0]).data(), "Arachni");
+}
+
+TEST(BrokerTest, ParameterTruncatedToWafLimits)
+{
+    std::stringstream ss;
+    msgpack::packer<std::stringstream> packer(ss);
+    packer.pack_map(2);
+    pack_str(packer, "string");
+    pack_str(packer, std::string(5000, 'a'));
+    pack_str(packer, "array");
+    packer.pack_array(300);
+    for (std::size_t i = 0; i < 300; i++) { packer.pack_unsigned_int(i); }
+
+    auto truncated_before = network::truncated_values();
+    const std::string &data = ss.str();
+    auto oh = msgpack::unpack(data.data(), data.size());
+    auto p = oh.get().as<parameter>();
+    EXPECT_EQ(network::truncated_values() - truncated_before, 2);
+
+    parameter_view pv(p);
+    EXPECT_EQ(pv[0].length(), 4096);
+    EXPECT_EQ(pv[1].size(), 256);
+    EXPECT_EQ(uint64_t(pv[1][255]), 255);
+}
+
+TEST(BrokerTest, RecvRequestInitOverLimits)
+{
+    mock::socket *socket = new mock::socket();
+    network::broker broker{std::unique_ptr<mock::socket>(socket)};
 
-    auto map_size = network::broker::max_map_size + 1;
-    packer.pack_map(map_size);
-    for (unsigned i = 0; i < map_size; i++) {
+    std::stringstream ss;
+    msgpack::packer<std::stringstream> packer(ss);
+    packer.pack_array(2);
+    pack_str(packer, "request_init");
+    packer.pack_array(1);
+    packer.pack_map(3);
+    pack_str(packer, "server.request.query");
+    pack_str(packer, std::string(5000, 'a'));
+    pack_str(packer, "server.request.headers.no_cookies");
+    packer.pack_map(300);
+    for (unsigned i = 0; i < 300; i++) {
         pack_str(packer, std::to_string(i));
         pack_str(packer, std::to_string(i));
     }
+    pack_str(packer, "server.request.body");
+    packer.pack_array(300);
+    for (unsigned i = 0; i < 300; i++) { packer.pack_unsigned_int(i); }
     const std::string &expected_data = ss.str();
 
     network::header_t h{"dds", (uint32_t)expected_data.size()};
@@ -447,9 +560,18 @@ TEST(BrokerTest, RecvRequestInitOverLimits)
         .WillOnce(
             DoAll(CopyString(&expected_data), Return(expected_data.size())));
 
-    EXPECT_THROW(
-        network::request request = broker.recv(std::chrono::milliseconds(100)),
-        msgpack::unpack_error);
+    network::request request = broker.recv(std::chrono::milliseconds(100));
+    EXPECT_EQ(request.id, network::request_init::request::id);
+
+    auto &command = request.as<network::request_init>();
+    EXPECT_EQ(command.truncated_values, 3);
+
+    parameter_view pv(command.data);
+    EXPECT_EQ(pv.size(), 3);
+    EXPECT_EQ(pv[0].length(), 4096);
+    EXPECT_EQ(pv[1].size(), 256);
+    EXPECT_EQ(pv[2].size(), 256);
+    EXPECT_EQ(uint64_t(pv[2][255]), 255);
 }
 
 TEST(BrokerTest, RecvRequestShutdown)
@@ -560,12 +682,12 @@ TEST(BrokerTest, ParsingStringLimit)
 
     std::stringstream ss;
     msgpack::packer<std::stringstream> packer(ss);
-    packer.pack_array(1);
+    packer.pack_array(2);
     pack_str(packer, "request_shutdown");
     packer.pack_array(1);
     packer.pack_map(1);
-    pack_str(packer, "server.response.code");
-    pack_str(packer, std::string(network::broker::max_string_length + 1, 'a'));
+    pack_str(packer, "server.response.headers.no_cookies");
+    pack_str(packer, std::string(5000, 'a'));
 
     const std::string &expected_data = ss.str();
 
@@ -575,9 +697,14 @@ TEST(BrokerTest, ParsingStringLimit)
         .WillOnce(
             DoAll(CopyString(&expected_data), Return(expected_data.size())));
 
-    network::request request;
-    EXPECT_THROW(request = broker.recv(std::chrono::milliseconds(100)),
-        msgpack::type_error);
+    network::request request = broker.recv(std::chrono::milliseconds(100));
+    EXPECT_EQ(request.id, network::request_shutdown::request::id);
+
+    auto &command = request.as<network::request_shutdown>();
+    EXPECT_EQ(command.truncated_values, 1);
+
+    parameter_view pv(command.data);
+    EXPECT_EQ(pv[0].length(), 4096);
 }
 
 TEST(BrokerTest, ParsingMapLimit)
@@ -587,12 +714,14 @@ TEST(BrokerTest, ParsingMapLimit)
 
     std::stringstream ss;
     msgpack::packer<std::stringstream> packer(ss);
-    packer.pack_array(1);
+    packer.pack_array(2);
     pack_str(packer, "request_shutdown");
     packer.pack_array(1);
-    packer.pack_map(network::broker::max_map_size + 1);
-    for (std::size_t i = 0; i < network::broker::max_map_size + 1; i++) {
-        pack_str(packer, "server.response.code");
+    packer.pack_map(1);
+    pack_str(packer, "server.response.headers.no_cookies");
+    packer.pack_map(1000);
+    for (std::size_t i = 0; i < 1000; i++) {
+        pack_str(packer, std::to_string(i));
         pack_str(packer, "1729");
     }
 
@@ -604,9 +733,15 @@ TEST(BrokerTest, ParsingMapLimit)
         .WillOnce(
             DoAll(CopyString(&expected_data), Return(expected_data.size())));
 
-    network::request request;
-    EXPECT_THROW(request = broker.recv(std::chrono::milliseconds(100)),
-        msgpack::type_error);
+    network::request request = broker.recv(std::chrono::milliseconds(100));
+    EXPECT_EQ(request.id, network::request_shutdown::request::id);
+
+    auto &command = request.as<network::request_shutdown>();
+    EXPECT_EQ(command.truncated_values, 1);
+
+    parameter_view pv(command.data);
+    EXPECT_EQ(pv[0].size(), 256);
+    EXPECT_STREQ(pv[0][255].key().data(), "255");
 }
 
 TEST(BrokerTest, ParsingArrayLimit)
@@ -616,15 +751,13 @@ TEST(BrokerTest, ParsingArrayLimit)
 
     std::stringstream ss;
     msgpack::packer<std::stringstream> packer(ss);
-    packer.pack_array(1);
+    packer.pack_array(2);
     pack_str(packer, "request_shutdown");
     packer.pack_array(1);
     packer.pack_map(1);
-    pack_str(packer, "server.response.code");
-    packer.pack_array(network::broker::max_array_size + 1);
-    for (std::size_t i = 0; i < network::broker::max_array_size + 1; i++) {
-        pack_str(packer, "1729");
-    }
+    pack_str(packer, "server.response.headers.no_cookies");
+    packer.pack_array(1000);
+    for (std::size_t i = 0; i < 1000; i++) { pack_str(packer, "1729"); }
 
     const std::string &expected_data = ss.str();
 
@@ -634,9 +767,14 @@ TEST(BrokerTest, ParsingArrayLimit)
         .WillOnce(
             DoAll(CopyString(&expected_data), Return(expected_data.size())));
 
-    network::request request;
-    EXPECT_THROW(request = broker.recv(std::chrono::milliseconds(100)),
-        msgpack::type_error);
+    network::request request = broker.recv(std::chrono::milliseconds(100));
+    EXPECT_EQ(request.id, network::request_shutdown::request::id);
+
+    auto &command = request.as<network::request_shutdown>();
+    EXPECT_EQ(command.truncated_values, 1);
+
+    parameter_view pv(command.data);
+    EXPECT_EQ(pv[0].size(), 256);
 }
 
 TEST(BrokerTest, ParsingDepthLimit)
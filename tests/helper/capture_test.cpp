@@ -0,0 +1,201 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "common.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <msgpack.hpp>
+#include <network/capture.hpp>
+#include <unistd.h>
+
+namespace dds {
+
+namespace {
+void pack_str(msgpack::packer<msgpack::sbuffer> &p, std::string_view str)
+{
+    p.pack_str(str.size());
+    p.pack_str_body(str.data(), str.size());
+}
+
+msgpack::sbuffer request_init_message()
+{
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    packer.pack_array(2);
+    pack_str(packer, "request_init");
+    packer.pack_array(1);
+    packer.pack_map(4);
+    packer.pack_unsigned_int(0); // server.request.query
+    pack_str(packer, "<script>");
+    packer.pack_unsigned_int(4); // server.request.headers.no_cookies
+    packer.pack_map(2);
+    pack_str(packer, "user-agent");
+    pack_str(packer, "Arachni");
+    pack_str(packer, "authorization");
+    pack_str(packer, "Bearer abc");
+    pack_str(packer, "server.request.cookies");
+    packer.pack_map(1);
+    pack_str(packer, "session");
+    packer.pack_array(1);
+    pack_str(packer, "secret");
+    pack_str(packer, "http.client_ip");
+    pack_str(packer, "1.2.3.4");
+    return buffer;
+}
+
+std::string_view str(const msgpack::object &o)
+{
+    if (o.type != msgpack::type::STR) {
+        return {};
+    }
+    return {o.via.str.ptr, o.via.str.size};
+}
+} // namespace
+
+TEST(CaptureTest, SanitizeRequestInit)
+{
+    auto original = request_init_message();
+    auto oh = msgpack::unpack(original.data(), original.size());
+
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    network::capture::sanitize(packer, oh.get());
+
+    auto sanitized_oh = msgpack::unpack(buffer.data(), buffer.size());
+    const msgpack::object &msg = sanitized_oh.get();
+    ASSERT_EQ(msg.type, msgpack::type::ARRAY);
+    ASSERT_EQ(msg.via.array.size, 2);
+    EXPECT_EQ(str(msg.via.array.ptr[0]), "request_init");
+
+    const msgpack::object &data = msg.via.array.ptr[1].via.array.ptr[0];
+    ASSERT_EQ(data.type, msgpack::type::MAP);
+    ASSERT_EQ(data.via.map.size, 4);
+
+    const msgpack::object_kv *kv = data.via.map.ptr;
+    EXPECT_EQ(str(kv[0].key), "server.request.query");
+    EXPECT_EQ(str(kv[0].val), "<script>");
+
+    EXPECT_EQ(str(kv[1].key), "server.request.headers.no_cookies");
+    const msgpack::object_kv *headers = kv[1].val.via.map.ptr;
+    EXPECT_EQ(str(headers[0].key), "user-agent");
+    EXPECT_EQ(str(headers[0].val), "Arachni");
+    EXPECT_EQ(str(headers[1].key), "authorization");
+    EXPECT_EQ(str(headers[1].val), "xxxxxxxxxx");
+
+    EXPECT_EQ(str(kv[2].key), "server.request.cookies");
+    const msgpack::object_kv *cookies = kv[2].val.via.map.ptr;
+    EXPECT_EQ(str(cookies[0].key), "session");
+    EXPECT_EQ(str(cookies[0].val.via.array.ptr[0]), "xxxxxx");
+
+    EXPECT_EQ(str(kv[3].key), "http.client_ip");
+    EXPECT_EQ(str(kv[3].val), "192.0.2.1");
+}
+
+TEST(CaptureTest, SanitizeSensitiveKeys)
+{
+    msgpack::sbuffer original;
+    msgpack::packer<msgpack::sbuffer> p(original);
+    p.pack_array(2);
+    pack_str(p, "request_init");
+    p.pack_array(1);
+    p.pack_map(3);
+    pack_str(p, "server.request.query");
+    p.pack_map(2);
+    pack_str(p, "user");
+    pack_str(p, "bob");
+    pack_str(p, "Password");
+    p.pack_array(1);
+    pack_str(p, "hunter2");
+    pack_str(p, "server.request.body");
+    p.pack_map(1);
+    pack_str(p, "nested");
+    p.pack_map(2);
+    pack_str(p, "api_key");
+    pack_str(p, "abc");
+    pack_str(p, "ok");
+    pack_str(p, "1");
+    pack_str(p, "server.request.uri.raw");
+    pack_str(p, "/login?user=bob&access_token=abc&q=1");
+
+    auto oh = msgpack::unpack(original.data(), original.size());
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> packer(buffer);
+    network::capture::sanitize(packer, oh.get());
+
+    auto sanitized_oh = msgpack::unpack(buffer.data(), buffer.size());
+    const msgpack::object &data =
+        sanitized_oh.get().via.array.ptr[1].via.array.ptr[0];
+    ASSERT_EQ(data.type, msgpack::type::MAP);
+    const msgpack::object_kv *kv = data.via.map.ptr;
+
+    const msgpack::object_kv *query = kv[0].val.via.map.ptr;
+    EXPECT_EQ(str(query[0].val), "bob");
+    EXPECT_EQ(str(query[1].val.via.array.ptr[0]), "xxxxxxx");
+
+    const msgpack::object_kv *nested = kv[1].val.via.map.ptr[0].val.via.map.ptr;
+    EXPECT_EQ(str(nested[0].key), "api_key");
+    EXPECT_EQ(str(nested[0].val), "xxx");
+    EXPECT_EQ(str(nested[1].val), "1");
+
+    EXPECT_EQ(str(kv[2].val), "/login?user=bob&access_token=xxx&q=1");
+}
+
+TEST(CaptureTest, RecordToFile)
+{
+    char tmpl[] = "/tmp/test_ddappsec_capture_XXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT_NE(fd, -1);
+    close(fd);
+    std::string path{tmpl};
+    auto message = request_init_message();
+    auto oh = msgpack::unpack(message.data(), message.size());
+
+    msgpack::sbuffer expected;
+    msgpack::packer<msgpack::sbuffer> packer(expected);
+    network::capture::sanitize(packer, oh.get());
+
+    auto magic = network::capture::file_magic;
+    auto record_size =
+        sizeof(network::capture_record_header_t) + expected.size();
+    {
+        // room for two records
+        network::capture capture{path, magic.size() + 2 * record_size};
+        auto conn_a = capture.new_connection();
+        auto conn_b = capture.new_connection();
+        EXPECT_NE(conn_a, conn_b);
+        capture.record(conn_a, oh.get());
+        capture.record(conn_b, oh.get());
+        // over the maximum size, ignored
+        capture.record(conn_a, oh.get());
+        capture.record(conn_b, oh.get());
+    }
+
+    std::ifstream is{path, std::ios::binary};
+    std::string contents{
+        std::istreambuf_iterator<char>{is}, std::istreambuf_iterator<char>{}};
+    std::remove(path.c_str());
+
+    ASSERT_EQ(contents.size(), magic.size() + 2 * record_size);
+    EXPECT_EQ(contents.substr(0, magic.size()), magic);
+
+    network::capture_record_header_t header;
+    const char *record = contents.data() + magic.size();
+    memcpy(&header, record, sizeof(header));
+    EXPECT_EQ(header.size, expected.size());
+    EXPECT_EQ(std::string_view(record + sizeof(header), header.size),
+        std::string_view(expected.data(), expected.size()));
+
+    auto first_conn = header.connection_id;
+    auto first_time = header.time_us;
+    record += record_size;
+    memcpy(&header, record, sizeof(header));
+    EXPECT_NE(header.connection_id, first_conn);
+    EXPECT_GE(header.time_us, first_time);
+}
+
+} // namespace dds
@@ -170,6 +170,31 @@ TEST(ClientTest, ClientInit)
     EXPECT_EQ(msg_res->metrics[tag::event_rules_failed], 0.0);
 }
 
+TEST(ClientTest, ClientInitCapabilities)
+{
+    auto smanager = std::make_shared<service_manager>();
+    auto broker = new mock::broker();
+
+    client c(smanager, std::unique_ptr<mock::broker>(broker));
+
+    network::client_init::request msg = get_default_client_init_msg();
+    msg.capabilities = {"unknown_capability", "address_ids"};
+
+    network::request req(std::move(msg));
+
+    std::shared_ptr<network::base_response> res;
+    EXPECT_CALL(*broker, recv(_)).WillOnce(Return(req));
+    EXPECT_CALL(*broker,
+        send(testing::An<const std::shared_ptr<network::base_response> &>()))
+        .WillOnce(DoAll(testing::SaveArg<0>(&res), Return(true)));
+
+    EXPECT_TRUE(c.run_client_init());
+    auto msg_res = dynamic_cast<network::client_init::response *>(res.get());
+    EXPECT_STREQ(msg_res->status.c_str(), "ok");
+    ASSERT_EQ(msg_res->capabilities.size(), 1);
+    EXPECT_EQ(msg_res->capabilities[0], "address_ids");
+}
+
 TEST(ClientTest, ClientInitRegisterRuntimeId)
 {
     std::shared_ptr<engine> engine{engine::create()};
@@ -774,8 +799,10 @@ TEST(ClientTest, RequestShutdown)
         EXPECT_STREQ(msg_res->verdict.c_str(), "record");
         EXPECT_EQ(msg_res->triggers.size(), 1);
 
-        EXPECT_EQ(msg_res->metrics.size(), 1);
+        EXPECT_EQ(msg_res->metrics.size(), 6);
         EXPECT_GT(msg_res->metrics[tag::waf_duration], 0.0);
+        EXPECT_GT(msg_res->metrics[tag::helper_publish_duration], 0.0);
+        EXPECT_GT(msg_res->metrics[tag::helper_format_duration], 0.0);
         EXPECT_EQ(msg_res->meta.size(), 1);
         EXPECT_STREQ(
             msg_res->meta[std::string(tag::event_rules_version)].c_str(),
@@ -817,8 +844,10 @@ TEST(ClientTest, RequestShutdownBlock)
         EXPECT_STREQ(msg_res->parameters["status_code"].c_str(), "403");
         EXPECT_EQ(msg_res->triggers.size(), 1);
 
-        EXPECT_EQ(msg_res->metrics.size(), 1);
+        EXPECT_EQ(msg_res->metrics.size(), 6);
         EXPECT_GT(msg_res->metrics[tag::waf_duration], 0.0);
+        EXPECT_GT(msg_res->metrics[tag::helper_publish_duration], 0.0);
+        EXPECT_GT(msg_res->metrics[tag::helper_format_duration], 0.0);
         EXPECT_EQ(msg_res->meta.size(), 1);
         EXPECT_STREQ(
             msg_res->meta[std::string(tag::event_rules_version)].c_str(),
@@ -1732,6 +1761,64 @@ TEST(ClientTest, RequestExecWithAttack)
     }
 }
 
+TEST(ClientTest, RequestExecBatch)
+{
+    auto smanager = std::make_shared<service_manager>();
+    auto broker = new mock::broker();
+
+    client c(smanager, std::unique_ptr<mock::broker>(broker));
+
+    set_extension_configuration_to(broker, c, EXTENSION_CONFIGURATION_ENABLED);
+
+    request_init(broker, c);
+
+    // Maps of addresses gathered by the extension, the same address may be
+    // in several of them and each of its values is evaluated
+    {
+        network::request_exec::request msg;
+        msg.data = parameter::array();
+        for (const auto ip : {"127.0.0.1"sv, "192.168.1.1"sv}) {
+            auto addresses = parameter::map();
+            addresses.add("http.client_ip", parameter::string(ip));
+            msg.data.add(std::move(addresses));
+        }
+
+        network::request req(std::move(msg));
+
+        std::shared_ptr<network::base_response> res;
+        EXPECT_CALL(*broker, recv(_)).WillOnce(Return(req));
+        EXPECT_CALL(*broker,
+            send(
+                testing::An<const std::shared_ptr<network::base_response> &>()))
+            .WillOnce(DoAll(testing::SaveArg<0>(&res), Return(true)));
+
+        EXPECT_TRUE(c.run_request());
+        auto msg_res =
+            dynamic_cast<network::request_exec::response *>(res.get());
+        EXPECT_STREQ(msg_res->verdict.c_str(), "block");
+        EXPECT_EQ(msg_res->triggers.size(), 1);
+    }
+
+    // A batch may only hold maps
+    {
+        network::request_exec::request msg;
+        msg.data = parameter::array();
+        msg.data.add(parameter::string("192.168.1.1"sv));
+
+        network::request req(std::move(msg));
+
+        std::shared_ptr<network::base_response> res;
+        EXPECT_CALL(*broker, recv(_)).WillOnce(Return(req));
+        EXPECT_CALL(*broker,
+            send(
+                testing::An<const std::shared_ptr<network::base_response> &>()))
+            .WillOnce(DoAll(testing::SaveArg<0>(&res), Return(true)));
+
+        EXPECT_FALSE(c.run_request());
+        EXPECT_EQ(std::string("error"), res->get_type());
+    }
+}
+
 TEST(ClientTest, RequestExecWithoutClientInit)
 {
     auto smanager = std::make_shared<service_manager>();
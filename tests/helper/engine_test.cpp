@@ -6,8 +6,12 @@
 #include "common.hpp"
 #include "json_helper.hpp"
 #include <engine.hpp>
+#include <metrics.hpp>
+#include <mutex>
 #include <rapidjson/document.h>
 #include <subscriber/waf.hpp>
+#include <tags.hpp>
+#include <thread>
 
 const std::string waf_rule =
     R"({"version":"2.1","rules":[{"id":"1","name":"rule1","tags":{"type":"flow1","category":"category1"},"conditions":[{"operator":"match_regex","parameters":{"inputs":[{"address":"arg1","key_path":[]}],"regex":"^string.*"}},{"operator":"match_regex","parameters":{"inputs":[{"address":"arg2","key_path":[]}],"regex":".*"}}]}]})";
@@ -39,6 +43,46 @@ public:
                              std::map<std::string, std::string> &meta,
                              std::map<std::string_view, double> &metrics));
 };
+
+// Uses up some of the time budget on each call, recording how much was left
+class budget_listener : public dds::subscriber::listener {
+public:
+    typedef std::shared_ptr<dds::mock::budget_listener> ptr;
+
+    budget_listener(
+        std::chrono::microseconds used, unsigned skipped, bool exhausted)
+        : used_(used), skipped_(skipped), exhausted_(exhausted)
+    {}
+
+    std::optional<dds::subscriber::event> call(
+        dds::parameter_view &data) override
+    {
+        return call(data, nullptr);
+    }
+
+    std::optional<dds::subscriber::event> call(dds::parameter_view & /*data*/,
+        dds::subscriber::time_budget *budget) override
+    {
+        if (budget != nullptr) {
+            remaining.push_back(budget->remaining);
+            budget->remaining -= used_;
+            budget->skipped += skipped_;
+            budget->exhausted = budget->exhausted || exhausted_;
+        }
+        return std::nullopt;
+    }
+
+    void get_meta_and_metrics(std::map<std::string, std::string> & /*meta*/,
+        std::map<std::string_view, double> & /*metrics*/) override
+    {}
+
+    std::vector<std::chrono::microseconds> remaining;
+
+protected:
+    std::chrono::microseconds used_;
+    unsigned skipped_;
+    bool exhausted_;
+};
 } // namespace mock
 
 TEST(EngineTest, NoSubscriptors)
@@ -188,6 +232,51 @@ TEST(EngineTest, MultipleSubscriptors)
     EXPECT_EQ(res->type, engine::action_type::record);
 }
 
+TEST(EngineTest, ActionPriority)
+{
+    auto e{engine::create(engine_settings::default_trace_rate_limit,
+        {{"redirect",
+             {engine::action_type::redirect, {{"url", "datadoghq.com"}}}},
+            {"block", {engine::action_type::block, {{"status_code", "403"}}}},
+            {"block2",
+                {engine::action_type::block, {{"status_code", "404"}}}}})};
+
+    mock::listener::ptr redirector = mock::listener::ptr(new mock::listener());
+    EXPECT_CALL(*redirector, call(_))
+        .WillRepeatedly(Return(subscriber::event{{"one"}, {"redirect"}}));
+
+    mock::listener::ptr blocker = mock::listener::ptr(new mock::listener());
+    EXPECT_CALL(*blocker, call(_))
+        .WillRepeatedly(
+            Return(subscriber::event{{"two"}, {"block2", "block"}}));
+
+    mock::subscriber::ptr sub1 = mock::subscriber::ptr(new mock::subscriber());
+    EXPECT_CALL(*sub1, get_listener()).WillRepeatedly(Return(redirector));
+
+    mock::subscriber::ptr sub2 = mock::subscriber::ptr(new mock::subscriber());
+    EXPECT_CALL(*sub2, get_listener()).WillRepeatedly(Return(blocker));
+
+    // Nothing can override the block, so the last subscriber isn't run
+    mock::subscriber::ptr sub3 = mock::subscriber::ptr(new mock::subscriber());
+    EXPECT_CALL(*sub3, get_listener()).Times(0);
+    EXPECT_CALL(*sub3, get_name()).WillRepeatedly(Return("sub3"sv));
+
+    e->subscribe(sub1);
+    e->subscribe(sub2);
+    e->subscribe(sub3);
+
+    auto ctx = e->get_context();
+
+    parameter p = parameter::map();
+    p.add("a", parameter::string("value"sv));
+    auto res = ctx.publish(std::move(p));
+    ASSERT_TRUE(res);
+    // Block wins over redirect, and of the blocks, the first by id
+    EXPECT_EQ(res->type, engine::action_type::block);
+    EXPECT_EQ(res->parameters["status_code"], "403");
+    EXPECT_EQ(res->events.size(), 2);
+}
+
 TEST(EngineTest, StatefulSubscriptor)
 {
     auto e{engine::create()};
@@ -337,6 +426,84 @@ TEST(EngineTest, WafSubscriptorTimeout)
     EXPECT_FALSE(res);
 }
 
+TEST(EngineTest, WafSubscriptorRequestBudget)
+{
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+
+    // Any run uses up the whole budget, so the next ones are skipped
+    auto e{engine::create(engine_settings::default_trace_rate_limit,
+        engine::action_map{}, std::chrono::microseconds{1})};
+    e->subscribe(waf::instance::from_string(waf_rule, meta, metrics));
+
+    auto ctx = e->get_context();
+
+    auto p = parameter::map();
+    p.add("arg1", parameter::string("string 1"sv));
+    EXPECT_FALSE(ctx.publish(std::move(p)));
+
+    p = parameter::map();
+    p.add("arg2", parameter::string("string 3"sv));
+    EXPECT_FALSE(ctx.publish(std::move(p)));
+
+    ctx.get_meta_and_metrics(meta, metrics);
+    EXPECT_EQ(metrics[tag::waf_request_budget_exhausted], 1.0);
+    EXPECT_EQ(metrics[tag::waf_skipped_runs], 1.0);
+}
+
+TEST(EngineTest, WafSubscriptorVerdictCache)
+{
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+
+    auto cache = std::make_shared<verdict_cache>(64, std::chrono::seconds{60});
+    auto e{engine::create(engine_settings::default_trace_rate_limit,
+        engine::action_map{}, {}, cache)};
+    e->subscribe(waf::instance::from_string(waf_rule, meta, metrics));
+
+    auto benign = [] {
+        auto p = parameter::map();
+        p.add("arg1", parameter::string("string 1"sv));
+        return p;
+    };
+    auto attack = [] {
+        auto p = parameter::map();
+        p.add("arg2", parameter::string("string 3"sv));
+        return p;
+    };
+
+    {
+        auto ctx = e->get_context();
+        EXPECT_FALSE(ctx.publish(benign()));
+        EXPECT_TRUE(ctx.publish(attack()));
+    }
+    EXPECT_EQ(cache->get_stats().hits, 0);
+
+    {
+        // The benign data is found on the cache, but the WAF still gets it
+        // once the rest of the request isn't
+        auto ctx = e->get_context();
+        EXPECT_FALSE(ctx.publish(benign()));
+        EXPECT_EQ(cache->get_stats().hits, 1);
+        EXPECT_TRUE(ctx.publish(attack()));
+
+        ctx.get_meta_and_metrics(meta, metrics);
+        EXPECT_EQ(metrics[tag::waf_cache_hits], 1.0);
+    }
+
+    {
+        auto ctx = e->get_context();
+        EXPECT_FALSE(ctx.publish(benign()));
+
+        metrics.clear();
+        meta.clear();
+        ctx.get_meta_and_metrics(meta, metrics);
+        EXPECT_EQ(metrics[tag::waf_cache_hits], 1.0);
+        // The listeners still report their tags
+        EXPECT_EQ(meta.count(std::string(tag::event_rules_version)), 1);
+    }
+}
+
 TEST(EngineTest, ActionsParserBlockRequest)
 {
     const std::string action_ruleset =
@@ -980,6 +1147,169 @@ TEST(EngineTest, WafSubscriptorCustomRules)
     }
 }
 
+TEST(EngineTest, TruncatedValuesMetric)
+{
+    auto e{engine::create()};
+
+    mock::listener::ptr listener = mock::listener::ptr(new mock::listener());
+    EXPECT_CALL(*listener, call(_)).WillRepeatedly(Return(std::nullopt));
+    EXPECT_CALL(*listener, get_meta_and_metrics(_, _)).Times(2);
+
+    mock::subscriber::ptr sub = mock::subscriber::ptr(new mock::subscriber());
+    EXPECT_CALL(*sub, get_listener()).WillRepeatedly(Return(listener));
+
+    e->subscribe(sub);
+
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+    auto ctx = e->get_context();
+
+    parameter p = parameter::map();
+    p.add("a", parameter::string("value"sv));
+    EXPECT_FALSE(ctx.publish(std::move(p)));
+    ctx.get_meta_and_metrics(meta, metrics);
+    EXPECT_EQ(metrics.count(tag::waf_truncated_values), 0);
+
+    ctx.add_truncated_values(2);
+    ctx.add_truncated_values(1);
+    ctx.get_meta_and_metrics(meta, metrics);
+    EXPECT_EQ(metrics[tag::waf_truncated_values], 3.0);
+}
+
+TEST(EngineTest, ParallelSubscribers)
+{
+    // Subscribers run in parallel from 16 bytes of data
+    auto e{engine::create(engine_settings::default_trace_rate_limit,
+        engine::action_map{}, {}, {}, 16)};
+
+    std::mutex mtx;
+    std::map<std::string, std::thread::id> threads;
+    for (const auto *name : {"one", "two", "three"}) {
+        mock::listener::ptr listener =
+            mock::listener::ptr(new mock::listener());
+        EXPECT_CALL(*listener, call(_))
+            .Times(2)
+            .WillRepeatedly(Invoke([&, name](dds::parameter_view &) {
+                metrics::record(metrics::stage::format, 1ms);
+                const std::lock_guard<std::mutex> lock{mtx};
+                threads[name] = std::this_thread::get_id();
+                return subscriber::event{{name}, {}};
+            }));
+
+        mock::subscriber::ptr sub =
+            mock::subscriber::ptr(new mock::subscriber());
+        EXPECT_CALL(*sub, get_listener()).WillRepeatedly(Return(listener));
+        e->subscribe(sub);
+    }
+
+    {
+        const metrics::command_timings timings;
+        auto ctx = e->get_context();
+        parameter p = parameter::map();
+        p.add("arg", parameter::string("a long enough value"sv));
+        auto res = ctx.publish(std::move(p));
+        ASSERT_TRUE(res);
+        // Merged in the order of the subscribers
+        EXPECT_THAT(res->events, ElementsAre("one", "two", "three"));
+
+        // The stages measured on the workers are the request's too
+        EXPECT_EQ(timings.durations()[static_cast<std::size_t>(
+                      metrics::stage::format)],
+            3ms);
+
+        // The first one runs on this thread, the others on workers
+        const std::lock_guard<std::mutex> lock{mtx};
+        EXPECT_EQ(threads["one"], std::this_thread::get_id());
+        EXPECT_NE(threads["two"], std::this_thread::get_id());
+        EXPECT_NE(threads["three"], std::this_thread::get_id());
+    }
+
+    // The same, one after the other
+    {
+        auto ctx = e->get_context();
+        parameter p = parameter::map();
+        p.add("arg", parameter::string("short"sv));
+        auto res = ctx.publish(std::move(p));
+        ASSERT_TRUE(res);
+        EXPECT_THAT(res->events, ElementsAre("one", "two", "three"));
+
+        const std::lock_guard<std::mutex> lock{mtx};
+        for (const auto &[name, id] : threads) {
+            EXPECT_EQ(id, std::this_thread::get_id());
+        }
+    }
+}
+
+TEST(EngineTest, ParallelSubscribersBudget)
+{
+    auto e{engine::create(engine_settings::default_trace_rate_limit,
+        engine::action_map{}, 1000us, {}, 16)};
+
+    mock::budget_listener::ptr listeners[] = {
+        std::make_shared<mock::budget_listener>(100us, 0, false),
+        std::make_shared<mock::budget_listener>(300us, 1, true),
+        std::make_shared<mock::budget_listener>(200us, 2, false)};
+    for (const auto &listener : listeners) {
+        mock::subscriber::ptr sub =
+            mock::subscriber::ptr(new mock::subscriber());
+        EXPECT_CALL(*sub, get_listener()).WillRepeatedly(Return(listener));
+        e->subscribe(sub);
+    }
+
+    auto ctx = e->get_context();
+    parameter p = parameter::map();
+    p.add("arg", parameter::string("a long enough value"sv));
+    EXPECT_FALSE(ctx.publish(std::move(p)));
+
+    // Each run started with the whole budget
+    for (const auto &listener : listeners) {
+        EXPECT_THAT(listener->remaining, ElementsAre(1000us));
+    }
+
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+    ctx.get_meta_and_metrics(meta, metrics);
+    EXPECT_EQ(metrics[tag::waf_request_budget_exhausted], 1.0);
+    EXPECT_EQ(metrics[tag::waf_skipped_runs], 3.0);
+
+    // What is left is what the longest run left
+    p = parameter::map();
+    p.add("arg", parameter::string("short"sv));
+    EXPECT_FALSE(ctx.publish(std::move(p)));
+    EXPECT_THAT(listeners[0]->remaining, ElementsAre(1000us, 700us));
+}
+
+TEST(EngineTest, ParallelSubscribersFailure)
+{
+    auto e{engine::create(engine_settings::default_trace_rate_limit,
+        engine::action_map{}, {}, {}, 16)};
+
+    for (const auto *name : {"one", "two", "three"}) {
+        mock::listener::ptr listener =
+            mock::listener::ptr(new mock::listener());
+        if (std::string_view(name) == "two") {
+            EXPECT_CALL(*listener, call(_))
+                .WillOnce(Throw(std::runtime_error("failure")));
+        } else {
+            EXPECT_CALL(*listener, call(_))
+                .WillOnce(Return(subscriber::event{{name}, {}}));
+        }
+
+        mock::subscriber::ptr sub =
+            mock::subscriber::ptr(new mock::subscriber());
+        EXPECT_CALL(*sub, get_listener()).WillRepeatedly(Return(listener));
+        e->subscribe(sub);
+    }
+
+    auto ctx = e->get_context();
+    parameter p = parameter::map();
+    p.add("arg", parameter::string("a long enough value"sv));
+    auto res = ctx.publish(std::move(p));
+    ASSERT_TRUE(res);
+    // The other subscribers still report what they found
+    EXPECT_THAT(res->events, ElementsAre("one", "three"));
+}
+
 TEST(EngineTest, RateLimiterForceKeep)
 {
     // Rate limit 0 allows all calls
@@ -7,6 +7,7 @@
 #include <cinttypes>
 #include <exception.hpp>
 #include <json_helper.hpp>
+#include <parameter.hpp>
 #include <parameter_view.hpp>
 
 #define STR_HELPER(x) #x
@@ -69,4 +70,143 @@ TEST(JsonHelperTest, BoolType)
     }
 }
 
+TEST(JsonHelperTest, ContainersToJson)
+{
+    auto p = parameter::map();
+    auto array = parameter::array();
+    array.add(parameter::string("a\"b\\c\n"sv));
+    array.add(parameter::as_boolean(true));
+    p.add("key \"quoted\"", std::move(array));
+    p.add("empty", parameter::map());
+
+    EXPECT_EQ(R"({"key \"quoted\"":["a\"b\\c\n",true],"empty":{}})",
+        parameter_to_json(parameter_view(p)));
+}
+
+TEST(JsonHelperTest, DepthLimitToJson)
+{
+    auto build = [](std::size_t depth) {
+        auto p = parameter::array();
+        for (std::size_t i = 1; i < depth; i++) {
+            auto parent = parameter::array();
+            parent.add(std::move(p));
+            p = std::move(parent);
+        }
+        return p;
+    };
+
+    auto max = build(max_json_depth);
+    EXPECT_EQ(std::string(max_json_depth, '[') +
+                  std::string(max_json_depth, ']'),
+        parameter_to_json(parameter_view(max)));
+
+    auto too_deep = build(max_json_depth + 1);
+    EXPECT_EQ("", parameter_to_json(parameter_view(too_deep)));
+}
+
+TEST(JsonHelperTest, SchemaAtWafMaxDepthToJson)
+{
+    // The schema of a map is [{"key":schema}], that of an array
+    // [[schema],{"len":n}], so each level of the input takes two levels
+    static constexpr std::size_t waf_max_depth = 20;
+    auto schema = parameter::array();
+    schema.add(parameter::uint64(8));
+    std::string expected = "[8]";
+    for (std::size_t i = 0; i < waf_max_depth; i++) {
+        auto map = parameter::map();
+        map.add("key", std::move(schema));
+        schema = parameter::array();
+        schema.add(std::move(map));
+        expected = R"([{"key":)" + expected + "}]";
+    }
+
+    EXPECT_EQ(expected, parameter_to_json(parameter_view(schema)));
+}
+
+TEST(JsonHelperTest, ReusedBufferToJson)
+{
+    string_buffer buffer;
+
+    auto first = parameter::string("first"sv);
+    EXPECT_TRUE(parameter_to_json(parameter_view(first), buffer));
+    EXPECT_EQ(R"("first")", buffer.get_string_ref());
+
+    // A failure leaves what was already written as it was
+    auto too_deep = parameter::array();
+    for (std::size_t i = 0; i < max_json_depth; i++) {
+        auto parent = parameter::array();
+        parent.add(parameter::string("value"sv));
+        parent.add(std::move(too_deep));
+        too_deep = std::move(parent);
+    }
+    EXPECT_FALSE(parameter_to_json(parameter_view(too_deep), buffer));
+    EXPECT_EQ(R"("first")", buffer.get_string_ref());
+
+    buffer.Clear();
+    auto second = parameter::uint64(2);
+    EXPECT_TRUE(parameter_to_json(parameter_view(second), buffer));
+    EXPECT_EQ("2", buffer.get_string_ref());
+}
+
+TEST(JsonHelperTest, JsonToParameter)
+{
+    auto check = [](const parameter &p) {
+        parameter_view pv(p);
+        ASSERT_TRUE(pv.is_map());
+        ASSERT_EQ(pv.size(), 3);
+
+        EXPECT_EQ(pv[0].key(), "array");
+        ASSERT_TRUE(pv[0].is_container());
+        ASSERT_EQ(pv[0].size(), 4);
+        EXPECT_EQ(std::string_view(pv[0][0]), "true");
+        EXPECT_EQ(std::string_view(pv[0][1]), "-42");
+        EXPECT_EQ(std::string_view(pv[0][2]), "string");
+        EXPECT_EQ(pv[0][3].type(), parameter_type::invalid);
+
+        EXPECT_EQ(pv[1].key(), "map");
+        ASSERT_TRUE(pv[1].is_map());
+        ASSERT_EQ(pv[1].size(), 1);
+        EXPECT_EQ(pv[1][0].key(), "nested");
+        EXPECT_TRUE(pv[1][0].is_map());
+        EXPECT_EQ(pv[1][0].size(), 0);
+
+        EXPECT_EQ(pv[2].key(), "last");
+        EXPECT_EQ(std::string_view(pv[2]), "18446744073709551615");
+    };
+
+    const std::string_view json =
+        R"({"array":[true,-42,"string",null],"map":{"nested":{}},)"
+        R"("last":18446744073709551615})";
+    check(json_to_parameter(json));
+
+    rapidjson::Document doc;
+    doc.Parse(json.data(), json.size());
+    check(json_to_parameter(doc));
+}
+
+TEST(JsonHelperTest, InvalidJsonToParameter)
+{
+    EXPECT_THROW(json_to_parameter(R"({"key":)"), parsing_error);
+    EXPECT_THROW(json_to_parameter(R"({"key":"value"}})"), parsing_error);
+    EXPECT_THROW(json_to_parameter(""), parsing_error);
+}
+
+TEST(JsonHelperTest, ElementsToJson)
+{
+    auto events = parameter::array();
+    auto first = parameter::map();
+    first.add("rule", parameter::string("1"sv));
+    events.add(std::move(first));
+    events.add(parameter::string("two"sv));
+
+    parameter_view pv(events);
+    EXPECT_EQ(R"({"rule":"1"},"two")", parameter_elements_to_json(pv));
+
+    auto empty = parameter::array();
+    EXPECT_EQ("", parameter_elements_to_json(parameter_view(empty)));
+
+    auto scalar = parameter::string("scalar"sv);
+    EXPECT_EQ("", parameter_elements_to_json(parameter_view(scalar)));
+}
+
 } // namespace dds
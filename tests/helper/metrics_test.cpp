@@ -0,0 +1,157 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "common.hpp"
+#include <metrics.hpp>
+#include <memory>
+#include <tags.hpp>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace dds {
+
+TEST(MetricsTest, HistogramPercentiles)
+{
+    metrics::histogram h;
+    EXPECT_EQ(h.get().percentile(50), 0);
+
+    for (unsigned i = 1; i <= 100; i++) { h.record(i * 1us); }
+
+    auto s = h.get();
+    EXPECT_EQ(s.count, 100);
+    EXPECT_EQ(s.sum_us, 5050);
+    EXPECT_EQ(s.max_us, 100);
+    // 50us is in the [32, 64) bucket
+    EXPECT_EQ(s.percentile(50), 64);
+    EXPECT_EQ(s.percentile(99), 100);
+    EXPECT_EQ(s.percentile(100), 100);
+
+    h.record(500ns);
+    EXPECT_EQ(h.get().buckets[0], 1);
+
+    h.reset();
+    EXPECT_EQ(h.get().count, 0);
+    EXPECT_EQ(h.get().max_us, 0);
+}
+
+TEST(MetricsTest, CommandTimingsRecordOnDestruction)
+{
+    auto &stats = metrics::command_stats::instance();
+    stats.reset();
+
+    EXPECT_EQ(metrics::command_timings::current(), nullptr);
+    {
+        metrics::command_timings timings;
+        EXPECT_EQ(metrics::command_timings::current(), &timings);
+
+        metrics::record(metrics::stage::recv, 10us);
+        metrics::record(metrics::stage::publish, 100us);
+        metrics::record(metrics::stage::publish, 50us);
+
+        EXPECT_EQ(timings.durations()[1], 10us);
+        EXPECT_EQ(timings.durations()[3], 150us);
+
+        timings.set_command(network::request_id::request_exec);
+    }
+    EXPECT_EQ(metrics::command_timings::current(), nullptr);
+
+    auto publish = stats
+                       .get(network::request_id::request_exec,
+                           metrics::stage::publish)
+                       .get();
+    EXPECT_EQ(publish.count, 1);
+    EXPECT_EQ(publish.sum_us, 150);
+    EXPECT_EQ(
+        stats.get(network::request_id::request_exec, metrics::stage::send)
+            .get()
+            .count,
+        1);
+    EXPECT_EQ(
+        stats.get(network::request_id::request_init, metrics::stage::publish)
+            .get()
+            .count,
+        0);
+
+    auto summary = stats.summary();
+    EXPECT_NE(summary.find("request_exec.publish: count=1"), std::string::npos);
+    EXPECT_EQ(summary.find("request_init"), std::string::npos);
+}
+
+TEST(MetricsTest, CommandTimingsWithoutCommand)
+{
+    auto &stats = metrics::command_stats::instance();
+    stats.reset();
+
+    {
+        const metrics::command_timings timings;
+        metrics::record(metrics::stage::recv, 10us);
+    }
+
+    EXPECT_TRUE(stats.summary().empty());
+
+    // Nothing to record on without timings
+    metrics::record(metrics::stage::recv, 10us);
+    EXPECT_TRUE(stats.summary().empty());
+}
+
+TEST(MetricsTest, StageTimer)
+{
+    metrics::command_timings timings;
+    {
+        const metrics::stage_timer timer{metrics::stage::format};
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_GE(timings.durations()[4], 1ms);
+}
+
+TEST(MetricsTest, StageAllocations)
+{
+    auto &stats = metrics::command_stats::instance();
+    stats.reset();
+
+    {
+        metrics::command_timings timings;
+        timings.set_command(network::request_id::request_init);
+        {
+            const metrics::stage_timer timer{metrics::stage::decode};
+            auto ptr = std::make_unique<std::array<char, 100>>();
+            EXPECT_NE(ptr, nullptr);
+        }
+
+        const auto &allocs = timings.allocs()[2];
+        if (metrics::alloc_tracking) {
+            EXPECT_EQ(allocs.count, 1);
+            EXPECT_GE(allocs.bytes, 100);
+        } else {
+            EXPECT_EQ(allocs.count, 0);
+            EXPECT_EQ(allocs.bytes, 0);
+        }
+    }
+
+    auto allocs = stats.get_allocations(
+        network::request_id::request_init, metrics::stage::decode);
+    EXPECT_EQ(allocs.count, metrics::alloc_tracking ? 1 : 0);
+    EXPECT_EQ(
+        stats.summary().find("allocs=") != std::string::npos,
+        metrics::alloc_tracking);
+}
+
+TEST(MetricsTest, SpanMetrics)
+{
+    metrics::stage_durations durations{};
+    durations[1] = 1500ns;
+    durations[3] = 2ms;
+
+    std::map<std::string_view, double> metrics;
+    metrics::add_span_metrics(durations, metrics);
+
+    EXPECT_EQ(metrics.size(), 5);
+    EXPECT_DOUBLE_EQ(metrics[tag::helper_recv_duration], 1.5);
+    EXPECT_DOUBLE_EQ(metrics[tag::helper_publish_duration], 2000.0);
+    EXPECT_DOUBLE_EQ(metrics[tag::helper_send_duration], 0.0);
+}
+
+} // namespace dds
@@ -28,7 +28,7 @@ public:
     const std::chrono::milliseconds get_current_interval() { return interval_; }
     void tick() { remote_config::client_handler::tick(); }
 
-    auto get_errors() { return errors_; }
+    auto get_errors() { return errors_.load(); }
 };
 
 } // namespace mock
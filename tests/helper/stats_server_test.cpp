@@ -0,0 +1,63 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "common.hpp"
+#include <cstring>
+#include <stats_server.hpp>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace dds {
+
+namespace {
+std::string read_stats(const std::string &path)
+{
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    EXPECT_NE(fd, -1);
+
+    struct sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    strncpy(static_cast<char *>(addr.sun_path), path.c_str(),
+        sizeof(addr.sun_path) - 1);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto res = ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+        sizeof(addr));
+    EXPECT_EQ(res, 0);
+
+    std::string output;
+    std::array<char, 256> buffer{};
+    ssize_t len;
+    while ((len = ::read(fd, buffer.data(), buffer.size())) > 0) {
+        output.append(buffer.data(), len);
+    }
+    ::close(fd);
+    return output;
+}
+} // namespace
+
+TEST(StatsServerTest, ServesSnapshotPerConnection)
+{
+    std::string path = "/tmp/dd_stats_test_" + std::to_string(::getpid());
+    unsigned calls = 0;
+    {
+        auto acceptor = std::make_unique<network::local::acceptor>(
+            path, stats_server::socket_mode);
+        stats_server server{std::move(acceptor),
+            [&calls] { return "{\"calls\":" + std::to_string(++calls) + "}"; }};
+
+        struct stat st {};
+        ASSERT_EQ(::stat(path.c_str(), &st), 0);
+        EXPECT_EQ(st.st_mode & 0777, 0600);
+
+        EXPECT_STREQ(read_stats(path).c_str(), "{\"calls\":1}");
+        EXPECT_STREQ(read_stats(path).c_str(), "{\"calls\":2}");
+    }
+    EXPECT_EQ(calls, 2);
+    ::unlink(path.c_str());
+}
+
+} // namespace dds
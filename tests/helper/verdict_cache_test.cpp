@@ -0,0 +1,92 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "common.hpp"
+#include <algorithm>
+#include <numeric>
+#include <verdict_cache.hpp>
+
+namespace dds {
+
+TEST(VerdictCacheTest, SiphashReferenceVectors)
+{
+    std::array<uint8_t, 64> message{};
+    std::iota(message.begin(), message.end(), 0);
+
+    // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+    auto hash = [&message](std::size_t size, std::size_t chunk) {
+        siphash h{0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL};
+        for (std::size_t i = 0; i < size; i += chunk) {
+            h.update(&message[i], std::min(chunk, size - i));
+        }
+        return h.finish();
+    };
+
+    EXPECT_EQ(hash(0, 1), 0x726fdb47dd0e0e31ULL);
+    EXPECT_EQ(hash(15, 15), 0xa129ca6149be45e5ULL);
+    EXPECT_EQ(hash(63, 63), 0x958a324ceb064572ULL);
+    // The result doesn't depend on how the input is split
+    EXPECT_EQ(hash(63, 1), 0x958a324ceb064572ULL);
+    EXPECT_EQ(hash(63, 5), 0x958a324ceb064572ULL);
+    // NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+}
+
+TEST(VerdictCacheTest, KeyDependsOnAllInputs)
+{
+    verdict_cache cache{16, std::chrono::seconds{60}};
+
+    auto p = parameter::map();
+    p.add("server.request.query", parameter::string("a=b"sv));
+    auto same = parameter::map();
+    same.add("server.request.query", parameter::string("a=b"sv));
+    auto other = parameter::map();
+    other.add("server.request.query", parameter::string("a=c"sv));
+    auto other_key = parameter::map();
+    other_key.add("server.request.body", parameter::string("a=b"sv));
+
+    auto key = cache.key(0, 0, parameter_view{p});
+    EXPECT_EQ(key, cache.key(0, 0, parameter_view{same}));
+    EXPECT_NE(key, cache.key(0, 0, parameter_view{other}));
+    EXPECT_NE(key, cache.key(0, 0, parameter_view{other_key}));
+    EXPECT_NE(key, cache.key(1, 0, parameter_view{p}));
+    EXPECT_NE(key, cache.key(0, 1, parameter_view{p}));
+
+    // Each cache has its own hash key
+    verdict_cache other_cache{16, std::chrono::seconds{60}};
+    EXPECT_NE(key, other_cache.key(0, 0, parameter_view{p}));
+}
+
+TEST(VerdictCacheTest, InsertAndExpire)
+{
+    verdict_cache cache{16, std::chrono::seconds{60}};
+    EXPECT_FALSE(cache.contains(42));
+    cache.insert(42);
+    EXPECT_TRUE(cache.contains(42));
+    EXPECT_FALSE(cache.contains(43));
+
+    auto stats = cache.get_stats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 2);
+
+    verdict_cache expired{16, std::chrono::seconds{0}};
+    expired.insert(42);
+    EXPECT_FALSE(expired.contains(42));
+}
+
+TEST(VerdictCacheTest, BoundedCapacity)
+{
+    // A single slot per shard: keys mapping to the same slot replace each
+    // other
+    verdict_cache cache{1, std::chrono::seconds{60}};
+    cache.insert(1);
+    cache.insert(1 + 16);
+    EXPECT_FALSE(cache.contains(1));
+    EXPECT_TRUE(cache.contains(1 + 16));
+    cache.insert(2);
+    EXPECT_TRUE(cache.contains(1 + 16));
+    EXPECT_TRUE(cache.contains(2));
+}
+
+} // namespace dds
@@ -19,6 +19,8 @@ const std::string waf_rule =
     R"({"version": "2.1", "metadata": {"rules_version": "1.2.3"}, "rules": [{"id": "1", "name": "rule1", "tags": {"type": "flow1", "category": "category1"}, "conditions": [{"operator": "match_regex", "parameters": {"inputs": [{"address": "arg1", "key_path": [] } ], "regex": "^string.*"} }, {"operator": "match_regex", "parameters": {"inputs": [{"address": "arg2", "key_path": [] } ], "regex": ".*"} } ], "action": "record"} ], "processors": [{"id": "processor-001", "generator": "extract_schema", "parameters": {"mappings": [{"inputs": [{"address": "arg2"} ], "output": "_dd.appsec.s.arg2"} ], "scanners": [{"tags": {"category": "pii"} } ] }, "evaluate": false, "output": true } ], "scanners": [] })";
 const std::string waf_rule_with_data =
     R"({"version":"2.1","rules":[{"id":"blk-001-001","name":"Block IP Addresses","tags":{"type":"block_ip","category":"security_response"},"conditions":[{"parameters":{"inputs":[{"address":"http.client_ip"}],"data":"blocked_ips"},"operator":"ip_match"}],"transformers":[],"on_match":["block"]}]})";
+const std::string waf_rule_with_routes =
+    R"({"version": "2.1", "rules": [{"id": "1", "name": "rule1", "tags": {"type": "flow1", "category": "category1"}, "conditions": [{"operator": "match_regex", "parameters": {"inputs": [{"address": "arg1"} ], "regex": "^string.*"} } ] }, {"id": "2", "name": "rule2", "tags": {"type": "flow2", "category": "category2"}, "conditions": [{"operator": "exact_match", "parameters": {"inputs": [{"address": "server.request.uri.raw"} ], "list": ["/admin"] } }, {"operator": "match_regex", "parameters": {"inputs": [{"address": "arg1"} ], "regex": "^admin.*"} } ] } ] })";
 
 namespace dds {
 
@@ -103,6 +105,131 @@ TEST(WafTest, RunWithTimeout)
     EXPECT_THROW(ctx->call(pv), timeout_error);
 }
 
+TEST(WafTest, RecycledListener)
+{
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+
+    subscriber::ptr wi{waf::instance::from_string(waf_rule, meta, metrics)};
+    auto ctx = wi->get_listener();
+    auto *first = ctx.get();
+
+    {
+        auto p = parameter::map();
+        p.add("arg1", parameter::string("string 1"sv));
+        parameter_view pv(p);
+        EXPECT_FALSE(ctx->call(pv));
+    }
+    wi->recycle(std::move(ctx));
+    EXPECT_FALSE(ctx);
+
+    ctx = wi->get_listener();
+    EXPECT_EQ(ctx.get(), first);
+
+    // The listener starts over with a new context, which hasn't seen arg1
+    {
+        auto p = parameter::map();
+        p.add("arg2", parameter::string("string 3"sv));
+        parameter_view pv(p);
+        EXPECT_FALSE(ctx->call(pv));
+    }
+
+    // Listeners still in use aren't pooled
+    auto other = wi->get_listener();
+    EXPECT_NE(other.get(), first);
+    auto copy = other;
+    wi->recycle(std::move(other));
+    EXPECT_NE(wi->get_listener().get(), copy.get());
+}
+
+TEST(WafTest, MovedListener)
+{
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+
+    subscriber::ptr wi{waf::instance::from_string(waf_rule, meta, metrics)};
+    auto ctx = std::static_pointer_cast<waf::instance::listener>(
+        wi->get_listener());
+    {
+        auto p = parameter::map();
+        p.add("arg1", parameter::string("string 1"sv));
+        parameter_view pv(p);
+        EXPECT_FALSE(ctx->call(pv));
+    }
+
+    // The context, which has seen arg1, and the timeout are moved along
+    waf::instance::listener moved{std::move(*ctx)};
+    {
+        auto p = parameter::map();
+        p.add("arg2", parameter::string("string 3"sv));
+        parameter_view pv(p);
+        EXPECT_TRUE(moved.call(pv));
+    }
+
+    std::map<std::string, std::string> run_meta;
+    std::map<std::string_view, double> run_metrics;
+    moved.get_meta_and_metrics(run_meta, run_metrics);
+    auto runtime = run_metrics[tag::waf_duration];
+    EXPECT_GT(runtime, 0.0);
+
+    // Assigned over a listener with a context of its own, which is released
+    auto other = std::static_pointer_cast<waf::instance::listener>(
+        wi->get_listener());
+    {
+        auto p = parameter::map();
+        p.add("arg1", parameter::string("string 1"sv));
+        parameter_view pv(p);
+        EXPECT_FALSE(other->call(pv));
+    }
+    *other = std::move(moved);
+
+    run_metrics.clear();
+    other->get_meta_and_metrics(run_meta, run_metrics);
+    EXPECT_EQ(run_metrics[tag::waf_duration], runtime);
+}
+
+TEST(WafTest, RunWithRequestBudget)
+{
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+
+    subscriber::ptr wi{waf::instance::from_string(waf_rule, meta, metrics)};
+    auto ctx = wi->get_listener();
+
+    auto p = parameter::map();
+    p.add("arg1", parameter::string("string 1"sv));
+    parameter_view pv(p);
+
+    subscriber::time_budget budget{std::chrono::seconds{1}};
+    EXPECT_FALSE(ctx->call(pv, &budget));
+    EXPECT_LT(budget.remaining, std::chrono::seconds{1});
+    EXPECT_FALSE(budget.exhausted);
+    EXPECT_EQ(budget.skipped, 0);
+}
+
+TEST(WafTest, RunWithExhaustedRequestBudget)
+{
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+
+    subscriber::ptr wi{waf::instance::from_string(waf_rule, meta, metrics)};
+    auto ctx = wi->get_listener();
+
+    auto p = parameter::map();
+    p.add("arg1", parameter::string("string 1"sv));
+    p.add("arg2", parameter::string("string 2"sv));
+    parameter_view pv(p);
+
+    // The run is skipped, so the attack isn't detected
+    subscriber::time_budget budget{std::chrono::microseconds{0}};
+    EXPECT_FALSE(ctx->call(pv, &budget));
+    EXPECT_TRUE(budget.exhausted);
+    EXPECT_EQ(budget.skipped, 1);
+
+    ctx->get_meta_and_metrics(meta, metrics);
+    EXPECT_EQ(metrics[tag::waf_duration], 0.0);
+}
+
 TEST(WafTest, ValidRunGood)
 {
     std::map<std::string, std::string> meta;
@@ -311,6 +438,68 @@ TEST(WafTest, UpdateInvalid)
     ASSERT_THROW(wi->update(param, meta, metrics), invalid_object);
 }
 
+TEST(WafTest, RulesScopedToRoutes)
+{
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+
+    // Off unless enabled in the settings
+    subscriber::ptr wi{
+        waf::instance::from_string(waf_rule_with_routes, meta, metrics)};
+    EXPECT_EQ(metrics.count(tag::waf_rule_scopes), 0);
+
+    wi = waf::instance::from_string(waf_rule_with_routes, meta, metrics,
+        waf::instance::default_waf_timeout_us, {}, {}, true);
+    // Only the other routes need a ruleset of their own, /admin gets them all
+    EXPECT_EQ(metrics[tag::waf_rule_scopes], 1.0);
+
+    // Returns whether a rule matched and the number of rules evaluated
+    auto run = [&](std::optional<std::string_view> uri, std::string_view arg) {
+        auto ctx = wi->get_listener();
+        auto p = parameter::map();
+        if (uri) {
+            p.add("server.request.uri.raw", parameter::string(*uri));
+        }
+        p.add("arg1", parameter::string(arg));
+        parameter_view pv(p);
+        auto res = ctx->call(pv);
+
+        std::map<std::string, std::string> run_meta;
+        std::map<std::string_view, double> run_metrics;
+        ctx->get_meta_and_metrics(run_meta, run_metrics);
+        wi->recycle(std::move(ctx));
+
+        auto it = run_metrics.find(tag::waf_rules_evaluated);
+        return std::make_pair(
+            res.has_value(), it != run_metrics.end() ? it->second : 0.0);
+    };
+
+    // Rule 2 is left out on the other routes
+    EXPECT_EQ(run("/other"sv, "admin"sv), std::make_pair(false, 1.0));
+    EXPECT_EQ(run("/other"sv, "string"sv), std::make_pair(true, 1.0));
+    EXPECT_EQ(run("/admin"sv, "admin"sv), std::make_pair(true, 2.0));
+    // Without the route, all the rules are evaluated
+    EXPECT_EQ(run(std::nullopt, "admin"sv), std::make_pair(false, 2.0));
+
+    // Custom rules restricted to known routes keep the rules scoped
+    auto param = json_to_parameter(
+        R"({"custom_rules": [{"id": "3", "name": "rule3", "tags": {"type": "flow3", "category": "category3"}, "conditions": [{"operator": "exact_match", "parameters": {"inputs": [{"address": "server.request.uri.raw"} ], "list": ["/admin"] } }, {"operator": "match_regex", "parameters": {"inputs": [{"address": "arg1"} ], "regex": "^custom.*"} } ] } ] })");
+    metrics.clear();
+    wi = wi->update(param, meta, metrics);
+    EXPECT_EQ(metrics[tag::waf_rule_scopes], 1.0);
+    EXPECT_EQ(run("/other"sv, "custom"sv), std::make_pair(false, 1.0));
+    EXPECT_EQ(run("/admin"sv, "custom"sv), std::make_pair(true, 3.0));
+
+    // Whereas rules restricted to a new route are evaluated everywhere
+    param = json_to_parameter(
+        R"({"custom_rules": [{"id": "4", "name": "rule4", "tags": {"type": "flow4", "category": "category4"}, "conditions": [{"operator": "exact_match", "parameters": {"inputs": [{"address": "server.request.uri.raw"} ], "list": ["/login"] } }, {"operator": "match_regex", "parameters": {"inputs": [{"address": "arg1"} ], "regex": "^login.*"} } ] } ] })");
+    metrics.clear();
+    wi = wi->update(param, meta, metrics);
+    EXPECT_EQ(metrics.count(tag::waf_rule_scopes), 0);
+    EXPECT_EQ(run("/login"sv, "login"sv), std::make_pair(true, 0.0));
+    EXPECT_EQ(run("/other"sv, "admin"sv), std::make_pair(false, 0.0));
+}
+
 TEST(WafTest, Logging)
 {
     auto d = defer([old_logger = spdlog::default_logger()]() {
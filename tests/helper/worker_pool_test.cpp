@@ -84,4 +84,65 @@ TEST(WorkerPoolTest, LaunchNWorkers)
     EXPECT_EQ(wp.worker_count(), 0);
 }
 
+TEST(WorkerPoolTest, LaunchMaxWorkers)
+{
+    worker::pool wp;
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool running = false;
+
+    for (int i = 0; i < 2; i++) {
+        EXPECT_TRUE(wp.launch(
+            [&](dds::worker::queue_consumer &wm) {
+                thread_handler(wm, running, m, cv);
+            },
+            2));
+
+        {
+            std::unique_lock<std::mutex> lock(m);
+            while (!running) { cv.wait(lock); }
+        }
+        running = false;
+    }
+    EXPECT_EQ(wp.worker_count(), 2);
+
+    // Both workers are busy
+    EXPECT_FALSE(wp.launch([](dds::worker::queue_consumer &) {}, 2));
+    EXPECT_EQ(wp.worker_count(), 2);
+
+    wp.stop();
+    EXPECT_EQ(wp.worker_count(), 0);
+}
+
+TEST(WorkerPoolTest, LaunchMaxWorkersConcurrently)
+{
+    worker::pool wp;
+
+    std::atomic<bool> release{false};
+    std::atomic<unsigned> launched{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 16; i++) {
+        threads.emplace_back([&] {
+            // The workers stay busy, so none of them can take another job
+            auto res = wp.launch(
+                [&](dds::worker::queue_consumer &) {
+                    while (!release) { std::this_thread::sleep_for(100us); }
+                },
+                2);
+            if (res) {
+                launched++;
+            }
+        });
+    }
+    for (auto &t : threads) { t.join(); }
+
+    EXPECT_EQ(launched, 2);
+    EXPECT_EQ(wp.worker_count(), 2);
+
+    release = true;
+    wp.stop();
+    EXPECT_EQ(wp.worker_count(), 0);
+}
+
 } // namespace dds
@@ -0,0 +1,272 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "corpus.hpp"
+#include <array>
+#include <random>
+#include <rapidjson/document.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/writer.h>
+
+namespace dds::microbench {
+
+namespace {
+
+struct corpus_spec {
+    const char *name;
+    unsigned query_params;
+    unsigned headers;
+    unsigned cookies;
+    // the body is a tree of maps with body_fanout keys per level
+    unsigned body_depth;
+    unsigned body_fanout;
+    unsigned max_value_len;
+};
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+constexpr std::array<corpus_spec, 3> specs{{
+    {"small", 3, 8, 2, 0, 0, 16},
+    {"medium", 20, 25, 10, 2, 7, 64},
+    {"huge", 200, 60, 40, 4, 8, 1024},
+}};
+static_assert(specs.size() * 2 == corpus_count);
+
+constexpr std::array<const char *, 10> common_headers{"host", "user-agent",
+    "accept", "accept-language", "accept-encoding", "content-type",
+    "content-length", "referer", "x-forwarded-for", "x-request-id"};
+
+constexpr std::array<const char *, 6> attacks{
+    "<script>alert(document.cookie)</script>", "1' OR '1'='1' -- ",
+    "../../../../etc/passwd", "; cat /etc/passwd", "{{7*7}}${7*7}",
+    "http://169.254.169.254/latest/meta-data/"};
+
+// one in every attack_interval values carries an attack
+constexpr unsigned attack_interval = 50;
+
+class generator {
+public:
+    using allocator_type = rapidjson::Document::AllocatorType;
+
+    generator(const corpus_spec &spec, bool with_attacks,
+        // NOLINTNEXTLINE(google-runtime-references)
+        allocator_type &alloc)
+        // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+        : rng_{with_attacks ? 0xA77ACCU : 0xBE9160U}, spec_{spec},
+          with_attacks_{with_attacks}, alloc_{alloc}
+    {}
+
+    rapidjson::Value request()
+    {
+        rapidjson::Value root{rapidjson::kObjectType};
+
+        rapidjson::Value query{rapidjson::kObjectType};
+        for (unsigned i = 0; i < spec_.query_params; i++) {
+            rapidjson::Value values{rapidjson::kArrayType};
+            values.PushBack(value(), alloc_);
+            query.AddMember(string(word(3, 12)), values, alloc_);
+        }
+        root.AddMember("server.request.query", query, alloc_);
+        root.AddMember("server.request.method", "POST", alloc_);
+        root.AddMember("server.request.uri.raw",
+            string("/" + word(4, 10) + "/" + word(4, 10) + "?" + word(8, 32)),
+            alloc_);
+
+        rapidjson::Value headers{rapidjson::kObjectType};
+        for (unsigned i = 0; i < spec_.headers; i++) {
+            std::string name = i < common_headers.size()
+                                   ? common_headers.at(i)
+                                   : "x-custom-header-" + std::to_string(i);
+            rapidjson::Value val =
+                (with_attacks_ && name == "user-agent")
+                    ? string("Arachni/v1.5")
+                    : value();
+            headers.AddMember(string(name), val, alloc_);
+        }
+        root.AddMember("server.request.headers.no_cookies", headers, alloc_);
+
+        rapidjson::Value cookies{rapidjson::kObjectType};
+        for (unsigned i = 0; i < spec_.cookies; i++) {
+            rapidjson::Value values{rapidjson::kArrayType};
+            values.PushBack(string(word(16, 32)), alloc_);
+            cookies.AddMember(string(word(4, 12)), values, alloc_);
+        }
+        root.AddMember("server.request.cookies", cookies, alloc_);
+        root.AddMember("http.client_ip", "203.0.113.7", alloc_);
+
+        if (spec_.body_depth > 0) {
+            root.AddMember("server.request.body", body(spec_.body_depth),
+                alloc_);
+        }
+
+        return root;
+    }
+
+private:
+    uint32_t next(uint32_t bound) { return rng_() % bound; }
+
+    std::string word(unsigned min_len, unsigned max_len)
+    {
+        static constexpr std::string_view chars{
+            "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"};
+        std::string res(min_len + next(max_len - min_len + 1), '\0');
+        for (auto &c : res) {
+            c = chars[next(chars.size())];
+        }
+        return res;
+    }
+
+    rapidjson::Value string(const std::string &str)
+    {
+        return rapidjson::Value{str.data(),
+            static_cast<rapidjson::SizeType>(str.size()), alloc_};
+    }
+
+    rapidjson::Value value()
+    {
+        if (with_attacks_ && values_++ % attack_interval == 0) {
+            return string(attacks.at(next(attacks.size())));
+        }
+        return string(word(1, spec_.max_value_len));
+    }
+
+    // NOLINTNEXTLINE(misc-no-recursion)
+    rapidjson::Value body(unsigned depth)
+    {
+        rapidjson::Value map{rapidjson::kObjectType};
+        for (unsigned i = 0; i < spec_.body_fanout; i++) {
+            rapidjson::Value child;
+            if (depth > 1) {
+                child = body(depth - 1);
+            } else if (i % 3 == 1) {
+                child.SetUint64(next(UINT32_MAX));
+            } else if (i % 3 == 2) {
+                child.SetArray();
+                child.PushBack(value(), alloc_);
+                child.PushBack(value(), alloc_);
+            } else {
+                child = value();
+            }
+            map.AddMember(string(word(3, 16)), child, alloc_);
+        }
+        return map;
+    }
+
+    std::mt19937 rng_;
+    const corpus_spec &spec_;
+    bool with_attacks_;
+    allocator_type &alloc_;
+    unsigned values_{0};
+};
+
+// NOLINTNEXTLINE(misc-no-recursion)
+void pack_json(msgpack::packer<msgpack::sbuffer> &pk,
+    const rapidjson::Value &v, std::size_t &strings)
+{
+    switch (v.GetType()) {
+    case rapidjson::kObjectType:
+        pk.pack_map(v.MemberCount());
+        for (const auto &m : v.GetObject()) {
+            pk.pack_str(m.name.GetStringLength());
+            pk.pack_str_body(m.name.GetString(), m.name.GetStringLength());
+            strings++;
+            pack_json(pk, m.value, strings);
+        }
+        break;
+    case rapidjson::kArrayType:
+        pk.pack_array(v.Size());
+        for (const auto &item : v.GetArray()) {
+            pack_json(pk, item, strings);
+        }
+        break;
+    case rapidjson::kStringType:
+        pk.pack_str(v.GetStringLength());
+        pk.pack_str_body(v.GetString(), v.GetStringLength());
+        strings++;
+        break;
+    case rapidjson::kNumberType:
+        if (v.IsUint64()) {
+            pk.pack_uint64(v.GetUint64());
+        } else if (v.IsInt64()) {
+            pk.pack_int64(v.GetInt64());
+        } else {
+            pk.pack_double(v.GetDouble());
+        }
+        break;
+    case rapidjson::kTrueType:
+        pk.pack_true();
+        break;
+    case rapidjson::kFalseType:
+        pk.pack_false();
+        break;
+    case rapidjson::kNullType:
+        pk.pack_nil();
+        break;
+    }
+}
+
+corpus make_corpus(const corpus_spec &spec, bool with_attacks)
+{
+    rapidjson::Document doc;
+    generator gen{spec, with_attacks, doc.GetAllocator()};
+    rapidjson::Value request = gen.request();
+
+    corpus c;
+    c.name = std::string{spec.name} + (with_attacks ? "/attacks" : "/clean");
+
+    rapidjson::StringBuffer json;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(json);
+    request.Accept(writer);
+    c.json.assign(json.GetString(), json.GetSize());
+
+    msgpack::sbuffer buffer;
+    msgpack::packer<msgpack::sbuffer> pk(buffer);
+    pack_json(pk, request, c.strings);
+    c.msgpack.assign(buffer.data(), buffer.size());
+
+    return c;
+}
+
+} // namespace
+
+const std::vector<corpus> &corpora()
+{
+    static const std::vector<corpus> all = [] {
+        std::vector<corpus> res;
+        for (const auto &spec : specs) {
+            res.emplace_back(make_corpus(spec, false));
+            res.emplace_back(make_corpus(spec, true));
+        }
+        return res;
+    }();
+    return all;
+}
+
+const corpus &select_corpus(benchmark::State &state)
+{
+    const auto &c = corpora().at(state.range(0));
+    state.SetLabel(c.name);
+    return c;
+}
+
+void report_allocations(benchmark::State &state,
+    const metrics::allocations &allocs,
+    std::optional<uint64_t> max_per_iteration)
+{
+    if (!metrics::alloc_tracking || state.iterations() == 0) {
+        return;
+    }
+
+    state.counters["allocs"] = benchmark::Counter(
+        static_cast<double>(allocs.count), benchmark::Counter::kAvgIterations);
+    state.counters["alloc_bytes"] = benchmark::Counter(
+        static_cast<double>(allocs.bytes), benchmark::Counter::kAvgIterations);
+
+    if (max_per_iteration &&
+        allocs.count > *max_per_iteration * state.iterations()) {
+        state.SkipWithError("more allocations per iteration than expected");
+    }
+}
+
+} // namespace dds::microbench
@@ -0,0 +1,59 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <metrics.hpp>
+#include <network/msgpack_helpers.hpp>
+#include <optional>
+#include <parameter.hpp>
+#include <string>
+#include <vector>
+
+namespace dds::microbench {
+
+// A request_init-like map of addresses, in the encodings the helper deals
+// with. The corpora are generated from fixed seeds, using only the output of
+// std::mt19937 (whose sequence is fixed by the standard), so they are the
+// same on every machine and run.
+struct corpus {
+    std::string name;
+    std::string json;
+    std::string msgpack;
+
+    // number of strings, keys included, as a rough measure of the work
+    std::size_t strings{0};
+
+    [[nodiscard]] msgpack::object_handle unpack() const
+    {
+        return msgpack::unpack(msgpack.data(), msgpack.size());
+    }
+
+    [[nodiscard]] dds::parameter to_parameter() const
+    {
+        return unpack().get().as<dds::parameter>();
+    }
+};
+
+// small, medium and huge requests, each without and with attacks; the index
+// of each corpus is the benchmark argument
+constexpr int corpus_count = 6;
+const std::vector<corpus> &corpora();
+
+// Returns the corpus selected by the benchmark argument and labels the
+// benchmark with its name
+const corpus &select_corpus(benchmark::State &state);
+
+// With DD_APPSEC_ENABLE_ALLOC_TRACKING, adds the given allocations as per
+// iteration counters and fails the benchmark if there were more than
+// max_per_iteration of them, to catch allocation regressions. Does nothing
+// otherwise.
+void report_allocations(benchmark::State &state,
+    const metrics::allocations &allocs,
+    std::optional<uint64_t> max_per_iteration = std::nullopt);
+
+} // namespace dds::microbench
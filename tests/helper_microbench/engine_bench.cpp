@@ -0,0 +1,77 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "corpus.hpp"
+#include <cstdlib>
+#include <engine.hpp>
+#include <engine_settings.hpp>
+
+namespace dds::microbench {
+
+namespace {
+engine::ptr create_engine()
+{
+    engine_settings settings;
+    const char *rules_file = std::getenv("DD_MICROBENCH_RULES_FILE");
+    settings.rules_file =
+        rules_file != nullptr ? rules_file : DD_MICROBENCH_DEFAULT_RULES_FILE;
+    // we want to measure the WAF, not its timeout
+    static constexpr uint64_t waf_timeout_us = 10000000;
+    settings.waf_timeout_us = waf_timeout_us;
+
+    std::map<std::string, std::string> meta;
+    std::map<std::string_view, double> metrics;
+    return engine::from_settings(settings, meta, metrics);
+}
+
+engine &get_engine()
+{
+    static engine::ptr instance = create_engine();
+    return *instance;
+}
+} // namespace
+
+// A request context is created for each iteration, as in request_init
+void BM_EnginePublish(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto &eng = get_engine();
+    metrics::allocations allocs;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto p = c.to_parameter();
+        auto start = metrics::thread_allocations();
+        state.ResumeTiming();
+
+        auto ctx = eng.get_context();
+        auto res = ctx.publish(std::move(p));
+        benchmark::DoNotOptimize(res);
+
+        state.PauseTiming();
+        allocs += metrics::thread_allocations() - start;
+        state.ResumeTiming();
+    }
+    report_allocations(state, allocs);
+}
+BENCHMARK(BM_EnginePublish)
+    ->DenseRange(0, corpus_count - 1)
+    ->Unit(benchmark::kMicrosecond);
+
+// The fixed cost of a request: a context, with its listeners, and a publish
+// with no data. What's left of the allocations is libddwaf's context.
+void BM_EngineContextSetup(benchmark::State &state)
+{
+    auto &eng = get_engine();
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto ctx = eng.get_context();
+        auto res = ctx.publish(parameter::map());
+        benchmark::DoNotOptimize(res);
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+}
+BENCHMARK(BM_EngineContextSetup)->Unit(benchmark::kMicrosecond);
+
+} // namespace dds::microbench
@@ -0,0 +1,56 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "corpus.hpp"
+#include <compression.hpp>
+#include <rate_limit.hpp>
+#include <sampler.hpp>
+
+namespace dds::microbench {
+
+// compress is used on the JSON of the extracted schemas
+void BM_Compress(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto compressed = compress(c.json);
+        benchmark::DoNotOptimize(compressed);
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * c.json.size()));
+}
+BENCHMARK(BM_Compress)->DenseRange(0, corpus_count - 1);
+
+// The limiter and sampler are shared by all the clients of a service, so
+// they're also measured under contention. Neither must allocate.
+void BM_RateLimiterAllow(benchmark::State &state)
+{
+    static constexpr uint32_t max_per_second = 100;
+    static rate_limiter limiter{max_per_second};
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto allowed = limiter.allow();
+        benchmark::DoNotOptimize(allowed);
+    }
+    report_allocations(state, metrics::thread_allocations() - start, 0);
+}
+BENCHMARK(BM_RateLimiterAllow)->Threads(1)->Threads(4)->Threads(16);
+
+void BM_SamplerGet(benchmark::State &state)
+{
+    static constexpr double sample_rate = 0.1;
+    static sampler s{sample_rate};
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto scope = s.get();
+        benchmark::DoNotOptimize(scope);
+    }
+    report_allocations(state, metrics::thread_allocations() - start, 0);
+}
+BENCHMARK(BM_SamplerGet)->Threads(1)->Threads(4)->Threads(16);
+
+} // namespace dds::microbench
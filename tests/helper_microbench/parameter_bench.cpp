@@ -0,0 +1,199 @@
+// Unless explicitly stated otherwise all files in this repository are
+// dual-licensed under the Apache-2.0 License or BSD-3-Clause License.
+//
+// This product includes software developed at Datadog
+// (https://www.datadoghq.com/). Copyright 2021 Datadog, Inc.
+#include "corpus.hpp"
+#include <json_helper.hpp>
+#include <parameter_view.hpp>
+#include <rapidjson/writer.h>
+
+namespace dds::microbench {
+
+namespace {
+// NOLINTNEXTLINE(misc-no-recursion)
+std::size_t walk(const parameter_view &pv)
+{
+    std::size_t total = pv.key().size();
+    if (pv.is_container()) {
+        for (const auto &child : pv) {
+            total += walk(child);
+        }
+    } else {
+        total += pv.length();
+    }
+    return total;
+}
+
+// The former parameter_to_json, which built a DOM before writing it, kept as
+// the reference the streaming writer is measured against
+// NOLINTNEXTLINE(misc-no-recursion, google-runtime-references)
+void to_dom(const parameter_view &pv, rapidjson::Value &output,
+    rapidjson::Document::AllocatorType &alloc)
+{
+    switch (pv.type()) {
+    case parameter_type::int64:
+        output.SetInt64(int64_t(pv));
+        break;
+    case parameter_type::uint64:
+        output.SetUint64(uint64_t(pv));
+        break;
+    case parameter_type::string: {
+        auto sv = std::string_view(pv);
+        output.SetString(sv.data(), sv.size(), alloc);
+    } break;
+    case parameter_type::boolean:
+        output.SetBool(bool(pv));
+        break;
+    case parameter_type::map:
+        output.SetObject();
+        for (const auto &v : pv) {
+            rapidjson::Value key;
+            rapidjson::Value value;
+            to_dom(v, value, alloc);
+            std::string_view const sv = v.key();
+            key.SetString(sv.data(), sv.size(), alloc);
+            output.AddMember(key, value, alloc);
+        }
+        break;
+    case parameter_type::array:
+        output.SetArray();
+        for (const auto &v : pv) {
+            rapidjson::Value value;
+            to_dom(v, value, alloc);
+            output.PushBack(value, alloc);
+        }
+        break;
+    case parameter_type::invalid:
+        throw std::runtime_error("invalid parameter in structure");
+    };
+}
+
+std::string dom_parameter_to_json(const parameter_view &pv)
+{
+    rapidjson::Document document;
+    to_dom(pv, document, document.GetAllocator());
+
+    dds::string_buffer buffer;
+    rapidjson::Writer<decltype(buffer)> writer(buffer);
+    document.Accept(writer);
+    return std::move(buffer.get_string_ref());
+}
+
+} // namespace
+
+// msgpack_to_param, on an already unpacked message
+void BM_MsgpackToParam(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto oh = c.unpack();
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto p = oh.get().as<dds::parameter>();
+        benchmark::DoNotOptimize(p);
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * c.msgpack.size()));
+}
+BENCHMARK(BM_MsgpackToParam)->DenseRange(0, corpus_count - 1);
+
+// what the broker does for every message body
+void BM_MsgpackUnpackToParam(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto oh = c.unpack();
+        auto p = oh.get().as<dds::parameter>();
+        benchmark::DoNotOptimize(p);
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * c.msgpack.size()));
+}
+BENCHMARK(BM_MsgpackUnpackToParam)->DenseRange(0, corpus_count - 1);
+
+void BM_JsonToParameter(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto p = json_to_parameter(c.json);
+        benchmark::DoNotOptimize(p);
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * c.json.size()));
+}
+BENCHMARK(BM_JsonToParameter)->DenseRange(0, corpus_count - 1);
+
+void BM_ParameterToJson(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto p = c.to_parameter();
+    parameter_view pv{p};
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto json = parameter_to_json(pv);
+        benchmark::DoNotOptimize(json);
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * c.json.size()));
+}
+BENCHMARK(BM_ParameterToJson)->DenseRange(0, corpus_count - 1);
+
+// the same, into a buffer reused across calls
+void BM_ParameterToJsonReusedBuffer(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto p = c.to_parameter();
+    parameter_view pv{p};
+    dds::string_buffer buffer;
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        buffer.Clear();
+        parameter_to_json(pv, buffer);
+        benchmark::DoNotOptimize(buffer.GetString());
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * c.json.size()));
+}
+BENCHMARK(BM_ParameterToJsonReusedBuffer)->DenseRange(0, corpus_count - 1);
+
+void BM_ParameterToJsonDom(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto p = c.to_parameter();
+    parameter_view pv{p};
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto json = dom_parameter_to_json(pv);
+        benchmark::DoNotOptimize(json);
+    }
+    report_allocations(state, metrics::thread_allocations() - start);
+    state.SetBytesProcessed(
+        static_cast<int64_t>(state.iterations() * c.json.size()));
+}
+BENCHMARK(BM_ParameterToJsonDom)->DenseRange(0, corpus_count - 1);
+
+// Walking a parameter must not allocate
+void BM_ParameterViewIteration(benchmark::State &state)
+{
+    const auto &c = select_corpus(state);
+    auto p = c.to_parameter();
+    parameter_view pv{p};
+    auto start = metrics::thread_allocations();
+    for (auto _ : state) {
+        auto total = walk(pv);
+        benchmark::DoNotOptimize(total);
+    }
+    report_allocations(state, metrics::thread_allocations() - start, 0);
+    state.SetItemsProcessed(
+        static_cast<int64_t>(state.iterations() * c.strings));
+}
+BENCHMARK(BM_ParameterViewIteration)->DenseRange(0, corpus_count - 1);
+
+} // namespace dds::microbench
@@ -52,6 +52,7 @@ using boost::system::error_code;
 
 asio::io_context iocontext;
 static bool continuous_mode;
+static unsigned cycle_size;
 
 MsgpackToJson::MsgpackToJson(const char *buffer, size_t size)
 {
@@ -362,6 +363,16 @@ class Client {
                     "Will read message #{} (continuous mode)", ++count);
                 exited = run_loop_body(yield);
             }
+        } else if (cycle_size > 0) {
+            auto cycle_start = responses_.end() - cycle_size;
+            next_response_ = cycle_start;
+            while (!exited) {
+                SPDLOG_INFO("Will read message #{} (cycle mode)", ++count);
+                exited = run_loop_body(yield);
+                if (++next_response_ == responses_.end()) {
+                    next_response_ = cycle_start;
+                }
+            }
         }
         SPDLOG_INFO("All responses given; exiting");
     }
@@ -623,6 +634,9 @@ int main(int argc, char *argv[])
                        "The responses to send")
         ("continuous", po::bool_switch(&continuous_mode)->default_value(false),
                        "Keep answering with the last payload")
+        ("cycle",      po::value<unsigned>(&cycle_size)->default_value(0),
+                       "Keep answering with the last N payloads, in order")
+        ("quiet",      "Only log warnings and errors")
         ("lock",       po::value<std::string>(), "Location of the lock file");
     // clang-format on
 
@@ -645,6 +659,9 @@ int main(int argc, char *argv[])
         std::cerr << opt_desc << "\n";
         return 1;
     }
+    if (opt_vm.count("quiet")) {
+        spdlog::set_level(spdlog::level::warn);
+    }
     if (!opt_vm.count("response")) {
         std::cerr << "At least one response is required\n";
         return 1;
@@ -657,6 +674,10 @@ int main(int argc, char *argv[])
         std::cerr << ex.what() << "\n";
         return 1;
     }
+    if (cycle_size > responses.size()) {
+        std::cerr << "The cycle can't be longer than the responses\n";
+        return 1;
+    }
 
     EchoPipe echo_pipe;
     echo_pipe.add_close_cb([]() { iocontext.stop(); });